@@ -0,0 +1,8 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/clean_cotire"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/clean_cotire.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
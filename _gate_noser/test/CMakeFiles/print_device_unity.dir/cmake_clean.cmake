@@ -0,0 +1,12 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/print_device_unity.dir/cotire/print_device_CXX_unity.cxx.o"
+  "CMakeFiles/print_device_unity.dir/cotire/print_device_CXX_unity.cxx.o.d"
+  "cotire/print_device_CXX_unity.cxx"
+  "print_device"
+  "print_device.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/print_device_unity.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
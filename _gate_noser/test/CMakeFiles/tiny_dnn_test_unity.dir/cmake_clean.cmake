@@ -0,0 +1,12 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/tiny_dnn_test_unity.dir/cotire/tiny_dnn_test_CXX_unity.cxx.o"
+  "CMakeFiles/tiny_dnn_test_unity.dir/cotire/tiny_dnn_test_CXX_unity.cxx.o.d"
+  "cotire/tiny_dnn_test_CXX_unity.cxx"
+  "tiny_dnn_test"
+  "tiny_dnn_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tiny_dnn_test_unity.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
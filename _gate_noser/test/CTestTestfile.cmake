@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test
+# Build directory: /root/repo/_gate_noser/test
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(all_tests "tiny_dnn_test")
+set_tests_properties(all_tests PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;16;add_test;/root/repo/test/CMakeLists.txt;0;")
@@ -99,6 +99,7 @@ function(tinydnn_print_configuration_summary)
     tinydnn_status("  Pthread           : " USE_PTHREAD THEN "Yes" ELSE "No")
     tinydnn_status("  TBB               : " USE_TBB AND TBB_FOUND THEN "Yes (ver. ${TBB_INTERFACE_VERSION})" ELSE "No")
     tinydnn_status("  OMP               : " USE_OMP AND OMP_FOUND THEN "Yes" ELSE "No")
+    tinydnn_status("  Work stealing     : " USE_WORK_STEALING THEN "Yes" ELSE "No")
     tinydnn_status("  NNPACK            : " USE_NNPACK AND NNPACK_FOUND THEN "Yes" ELSE "No")
     tinydnn_status("  CBLAS             : " USE_CBLAS AND BLAS_FOUND THEN "Yes" ELSE "No")
     tinydnn_status("  OpenCL            : " USE_OPENCL AND OpenCL_FOUND THEN "Yes (ver. ${OpenCL_VERSION_STRING})" ELSE "No")
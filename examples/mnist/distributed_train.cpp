@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "tiny_dnn/tiny_dnn.h"
+
+// trains an MLP on MNIST with several processes exchanging gradients.
+// to run 2 processes on this host:
+//
+//   ./example_mnist_distributed_train --data_path data --rank 0 \
+//       --addresses 127.0.0.1:5000,127.0.0.1:5001 &
+//   ./example_mnist_distributed_train --data_path data --rank 1 \
+//       --addresses 127.0.0.1:5000,127.0.0.1:5001
+
+static std::vector<std::string> split_addresses(const std::string &list) {
+  std::vector<std::string> addresses;
+  std::stringstream ss(list);
+  std::string address;
+  while (std::getline(ss, address, ',')) addresses.push_back(address);
+  return addresses;
+}
+
+static void train(const std::string &data_path,
+                  size_t rank,
+                  const std::vector<std::string> &addresses,
+                  int epochs,
+                  int minibatch_size) {
+  using fc   = tiny_dnn::layers::fc;
+  using tanh = tiny_dnn::activation::tanh;
+
+  tiny_dnn::network<tiny_dnn::sequential> nn;
+  tiny_dnn::adagrad optimizer;
+  nn << fc(28 * 28, 300) << tanh() << fc(300, 10) << tanh();
+
+  std::vector<tiny_dnn::label_t> train_labels, test_labels;
+  std::vector<tiny_dnn::vec_t> train_images, test_images;
+  tiny_dnn::parse_mnist_labels(data_path + "/train-labels.idx1-ubyte",
+                               &train_labels);
+  tiny_dnn::parse_mnist_images(data_path + "/train-images.idx3-ubyte",
+                               &train_images, -1.0, 1.0, 0, 0);
+  tiny_dnn::parse_mnist_labels(data_path + "/t10k-labels.idx1-ubyte",
+                               &test_labels);
+  tiny_dnn::parse_mnist_images(data_path + "/t10k-images.idx3-ubyte",
+                               &test_images, -1.0, 1.0, 0, 0);
+
+  // every process trains on its own, equally sized, share of the data
+  const size_t ranks = addresses.size();
+  const size_t share = train_images.size() / ranks;
+  std::vector<tiny_dnn::label_t> my_labels(
+    train_labels.begin() + rank * share,
+    train_labels.begin() + (rank + 1) * share);
+  std::vector<tiny_dnn::vec_t> my_images(
+    train_images.begin() + rank * share,
+    train_images.begin() + (rank + 1) * share);
+
+  std::cout << "rank " << rank << " of " << ranks << ": connecting..."
+            << std::endl;
+  nn.set_communicator(
+    std::make_shared<tiny_dnn::tcp_communicator>(rank, addresses));
+
+  tiny_dnn::timer t;
+  int epoch     = 1;
+  auto on_epoch = [&]() {
+    std::cout << "rank " << rank << ": epoch " << epoch++ << "/" << epochs
+              << " finished. " << t.elapsed() << "s elapsed." << std::endl;
+  };
+  nn.train<tiny_dnn::mse>(optimizer, my_images, my_labels, minibatch_size,
+                          epochs, []() {}, on_epoch);
+
+  // the weights are identical on every process
+  if (rank == 0) {
+    nn.test(test_images, test_labels).print_detail(std::cout);
+    nn.save("mnist-distributed-model");
+  }
+}
+
+static void usage(const char *argv0) {
+  std::cout << "Usage: " << argv0 << " --data_path path_to_dataset_folder"
+            << " --rank 0"
+            << " --addresses host0:port0,host1:port1,..."
+            << " --epochs 1"
+            << " --minibatch_size 16" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string data_path = "";
+  std::string addresses = "";
+  int rank              = -1;
+  int epochs            = 1;
+  int minibatch_size    = 16;
+
+  if (argc == 2) {
+    std::string argname(argv[1]);
+    if (argname == "--help" || argname == "-h") {
+      usage(argv[0]);
+      return 0;
+    }
+  }
+  for (int count = 1; count + 1 < argc; count += 2) {
+    std::string argname(argv[count]);
+    if (argname == "--data_path") {
+      data_path = std::string(argv[count + 1]);
+    } else if (argname == "--addresses") {
+      addresses = std::string(argv[count + 1]);
+    } else if (argname == "--rank") {
+      rank = atoi(argv[count + 1]);
+    } else if (argname == "--epochs") {
+      epochs = atoi(argv[count + 1]);
+    } else if (argname == "--minibatch_size") {
+      minibatch_size = atoi(argv[count + 1]);
+    } else {
+      std::cerr << "Invalid parameter specified - \"" << argname << "\""
+                << std::endl;
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  std::vector<std::string> ring = split_addresses(addresses);
+  if (data_path == "" || ring.empty() || rank < 0 ||
+      static_cast<size_t>(rank) >= ring.size() || epochs <= 0 ||
+      minibatch_size <= 0) {
+    std::cerr << "Invalid parameter value." << std::endl;
+    usage(argv[0]);
+    return -1;
+  }
+
+  try {
+    train(data_path, static_cast<size_t>(rank), ring, epochs, minibatch_size);
+  } catch (tiny_dnn::nn_error &err) {
+    std::cerr << "Exception: " << err.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#include <iostream>
+
+#include "tiny_dnn/tiny_dnn.h"
+
+// compares the training throughput of the synchronous and the hogwild modes
+// of network::fit on MNIST
+
+static void construct_net(tiny_dnn::network<tiny_dnn::sequential> &nn,
+                          size_t hidden_units) {
+  using fc   = tiny_dnn::layers::fc;
+  using tanh = tiny_dnn::activation::tanh;
+
+  nn << fc(28 * 28, hidden_units) << tanh() << fc(hidden_units, 10) << tanh();
+}
+
+static void run(const std::string &name,
+                tiny_dnn::training_mode mode,
+                size_t workers,
+                size_t hidden_units,
+                int epochs,
+                int minibatch_size,
+                const std::vector<tiny_dnn::vec_t> &train_images,
+                const std::vector<tiny_dnn::label_t> &train_labels,
+                const std::vector<tiny_dnn::vec_t> &test_images,
+                const std::vector<tiny_dnn::label_t> &test_labels) {
+  tiny_dnn::network<tiny_dnn::sequential> nn;
+  tiny_dnn::adagrad optimizer;
+
+  // both modes start from the same weights
+  tiny_dnn::set_random_seed(0);
+  construct_net(nn, hidden_units);
+  nn.init_weight();
+  nn.set_training_mode(mode, workers);
+
+  tiny_dnn::timer t;
+  nn.train<tiny_dnn::mse>(optimizer, train_images, train_labels,
+                          minibatch_size, epochs);
+  double elapsed = t.elapsed();
+
+  tiny_dnn::result res = nn.test(test_images, test_labels);
+  std::cout << name << ": " << elapsed << "s, "
+            << train_images.size() * epochs / elapsed << " samples/sec, "
+            << "accuracy " << res.accuracy() << "%" << std::endl;
+}
+
+static void usage(const char *argv0) {
+  std::cout << "Usage: " << argv0 << " --data_path path_to_dataset_folder"
+            << " --epochs 1"
+            << " --minibatch_size 16"
+            << " --hidden_units 300"
+            << " --workers 0" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string data_path = "";
+  int epochs            = 1;
+  int minibatch_size    = 16;
+  int hidden_units      = 300;
+  int workers           = 0;
+
+  if (argc == 2) {
+    std::string argname(argv[1]);
+    if (argname == "--help" || argname == "-h") {
+      usage(argv[0]);
+      return 0;
+    }
+  }
+  for (int count = 1; count + 1 < argc; count += 2) {
+    std::string argname(argv[count]);
+    if (argname == "--epochs") {
+      epochs = atoi(argv[count + 1]);
+    } else if (argname == "--minibatch_size") {
+      minibatch_size = atoi(argv[count + 1]);
+    } else if (argname == "--hidden_units") {
+      hidden_units = atoi(argv[count + 1]);
+    } else if (argname == "--workers") {
+      workers = atoi(argv[count + 1]);
+    } else if (argname == "--data_path") {
+      data_path = std::string(argv[count + 1]);
+    } else {
+      std::cerr << "Invalid parameter specified - \"" << argname << "\""
+                << std::endl;
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (data_path == "") {
+    std::cerr << "Data path not specified." << std::endl;
+    usage(argv[0]);
+    return -1;
+  }
+  if (epochs <= 0 || minibatch_size <= 0 || hidden_units <= 0 ||
+      workers < 0) {
+    std::cerr << "Invalid parameter value." << std::endl;
+    usage(argv[0]);
+    return -1;
+  }
+
+  try {
+    std::vector<tiny_dnn::label_t> train_labels, test_labels;
+    std::vector<tiny_dnn::vec_t> train_images, test_images;
+
+    tiny_dnn::parse_mnist_labels(data_path + "/train-labels.idx1-ubyte",
+                                 &train_labels);
+    tiny_dnn::parse_mnist_images(data_path + "/train-images.idx3-ubyte",
+                                 &train_images, -1.0, 1.0, 0, 0);
+    tiny_dnn::parse_mnist_labels(data_path + "/t10k-labels.idx1-ubyte",
+                                 &test_labels);
+    tiny_dnn::parse_mnist_images(data_path + "/t10k-images.idx3-ubyte",
+                                 &test_images, -1.0, 1.0, 0, 0);
+
+    run("synchronous", tiny_dnn::training_mode::synchronous, 0, hidden_units,
+        epochs, minibatch_size, train_images, train_labels, test_images,
+        test_labels);
+    run("hogwild", tiny_dnn::training_mode::hogwild, workers, hidden_units,
+        epochs, minibatch_size, train_images, train_labels, test_images,
+        test_labels);
+  } catch (tiny_dnn::nn_error &err) {
+    std::cerr << "Exception: " << err.what() << std::endl;
+  }
+  return 0;
+}
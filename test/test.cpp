@@ -41,13 +41,19 @@
 using namespace tiny_dnn::activation;
 
 #include "test_activation_layer.h"
+#include "test_async_executor.h"
 #include "test_average_pooling_layer.h"
 // TODO(yida): fix broken test
 // #include "test_average_unpooling_layer.h"
 #include "test_batch_norm_layer.h"
+#include "test_batch_storage.h"
+#include "test_batching_predictor.h"
+#include "test_checkpoint_plan.h"
+#include "test_communicator.h"
 #include "test_concat_layer.h"
 #include "test_convolutional_layer.h"
 #include "test_core.h"
+#include "test_cpu_topology.h"
 #include "test_deconvolutional_layer.h"
 #include "test_dropout_layer.h"
 #include "test_fully_connected_layer.h"
@@ -56,6 +62,7 @@ using namespace tiny_dnn::activation;
 #include "test_large_thread_count.h"
 #include "test_lrn_layer.h"
 #include "test_max_pooling_layer.h"
+#include "test_memory_plan.h"
 #include "test_models.h"
 #include "test_network.h"
 #include "test_node.h"
@@ -65,9 +72,13 @@ using namespace tiny_dnn::activation;
 #include "test_quantization.h"
 #include "test_quantized_convolutional_layer.h"
 #include "test_quantized_deconvolutional_layer.h"
+#include "test_scratch_arena.h"
 #include "test_slice_layer.h"
 #include "test_target_cost.h"
 #include "test_tensor.h"
+#include "test_thread_budget.h"
+#include "test_thread_pool.h"
+#include "test_work_stealing_scheduler.h"
 
 #include "test_gru_cell.h"
 #include "test_lstm_cell.h"
@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "tiny_dnn/util/async_executor.h"
+
+namespace tiny_dnn {
+
+TEST(async_executor, runs_tasks) {
+  async_executor executor(3);
+  EXPECT_EQ(executor.num_threads(), 3u);
+
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; i++) {
+    results.push_back(executor.submit([i] { return i * i; }));
+  }
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(results[i].get(), i * i);
+  }
+}
+
+TEST(async_executor, propagates_exception) {
+  async_executor executor(1);
+  auto f = executor.submit([]() -> int { throw nn_error("failed"); });
+  EXPECT_THROW(f.get(), nn_error);
+  EXPECT_EQ(executor.submit([] { return 1; }).get(), 1);
+}
+
+TEST(async_executor, shares_thread_budget) {
+  async_executor executor(4);
+  auto budget = [] { return thread_budget(); };
+
+  // a task alone may use the threads of the executor, or of its submitter
+  EXPECT_EQ(executor.submit(budget).get(), 4u);
+  {
+    thread_budget_scope scope(2);
+    EXPECT_EQ(executor.submit(budget).get(), 2u);
+  }
+
+  // tasks running together share them
+  std::promise<void> release;
+  std::shared_future<void> gate = release.get_future().share();
+  std::atomic<size_t> started(0);
+  std::vector<std::future<size_t>> results;
+  for (int i = 0; i < 4; i++) {
+    results.push_back(executor.submit([&, gate] {
+      size_t b = thread_budget();
+      started++;
+      gate.wait();
+      return b;
+    }));
+  }
+  while (started.load() != 4) std::this_thread::yield();
+  release.set_value();
+
+  std::vector<size_t> budgets;
+  for (auto &r : results) budgets.push_back(r.get());
+  std::sort(budgets.begin(), budgets.end());
+  // the last task to start shares the threads with three others
+  EXPECT_EQ(budgets[0], 1u);
+  EXPECT_LE(budgets[3], 4u);
+  EXPECT_EQ(thread_budget(), 0u);
+}
+
+TEST(async_executor, bounded_queue_blocks_producer) {
+  async_executor executor(1, 2);
+  EXPECT_EQ(executor.max_queue_depth(), 2u);
+
+  std::promise<void> release;
+  std::shared_future<void> gate = release.get_future().share();
+
+  // occupy the only worker, then fill the queue
+  auto busy = executor.submit([gate] { gate.wait(); });
+  while (executor.pending() != 0) std::this_thread::yield();
+  auto q1 = executor.submit([] {});
+  auto q2 = executor.submit([] {});
+
+  std::atomic<bool> submitted(false);
+  std::thread producer([&] {
+    executor.submit([] {}).wait();
+    submitted = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(submitted.load());
+  EXPECT_LE(executor.pending(), 2u);
+
+  release.set_value();
+  producer.join();
+  EXPECT_TRUE(submitted.load());
+  busy.get();
+  q1.get();
+  q2.get();
+}
+
+TEST(async_executor, nested_submit_on_full_queue) {
+  async_executor executor(1, 1);
+
+  // the worker submits to its own full queue: the inner task runs inline
+  std::future<int> filler;
+  auto outer = executor.submit([&] {
+    filler     = executor.submit([] { return 1; });
+    auto inner = executor.submit([] { return 2; });
+    return inner.get();
+  });
+  EXPECT_EQ(outer.get(), 2);
+  EXPECT_EQ(filler.get(), 1);
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/util/batch_storage.h"
+
+namespace tiny_dnn {
+
+TEST(batch_storage, resize_batch_is_contiguous) {
+  tensor_t t{vec_t{1, 2, 3}};
+  resize_batch(&t, 5, 3);
+  ASSERT_EQ(t.size(), 5u);
+
+  batch_matrix m;
+  ASSERT_TRUE(as_matrix(t, &m));
+  EXPECT_EQ(m.rows, 5u);
+  EXPECT_EQ(m.cols, 3u);
+  EXPECT_EQ(m.stride, batch_stride(3));
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(m.data) % 64, 0u);
+  for (size_t i = 0; i < 5; i++) {
+    EXPECT_EQ(&t[i][0], m.data + i * m.stride);
+    EXPECT_EQ(t[i][2], float_t(3));  // new samples copy the first one
+  }
+
+  // growing keeps the samples, shrinking keeps the layout
+  t[4][0] = float_t(9);
+  resize_batch(&t, 8, 3);
+  ASSERT_TRUE(as_matrix(t, &m));
+  EXPECT_EQ(t[4][0], float_t(9));
+  resize_batch(&t, 2, 3);
+  ASSERT_TRUE(as_matrix(t, &m));
+  EXPECT_EQ(m.rows, 2u);
+
+  // copies are independent heap vectors
+  tensor_t copy = t;
+  copy[0][0]    = float_t(-1);
+  EXPECT_EQ(t[0][0], float_t(1));
+}
+
+TEST(batch_storage, as_matrix_rejects_scattered_samples) {
+  tensor_t t{vec_t(4), vec_t(4), vec_t(5)};
+  batch_matrix m;
+  EXPECT_FALSE(as_matrix(t, &m));
+  tensor_t empty;
+  EXPECT_FALSE(as_matrix(empty, &m));
+}
+
+TEST(batch_storage, merge_grads_of_contiguous_batch) {
+  const size_t size = 9001;  // several column blocks, the last one partial
+  edge contiguous(nullptr, shape3d(size, 1, 1), vector_type::weight);
+  edge scattered(nullptr, shape3d(size, 1, 1), vector_type::weight);
+  resize_batch(contiguous.get_gradient(), 5, size);
+  *scattered.get_gradient() = tensor_t(5, vec_t(size));
+  for (size_t i = 0; i < 5; i++) {
+    uniform_rand((*scattered.get_gradient())[i].begin(),
+                 (*scattered.get_gradient())[i].end(), -1.0, 1.0);
+    (*contiguous.get_gradient())[i] = (*scattered.get_gradient())[i];
+  }
+  batch_matrix m;
+  ASSERT_TRUE(as_matrix(*contiguous.get_gradient(), &m));
+  EXPECT_FALSE(as_matrix(*scattered.get_gradient(), &m));
+
+  vec_t expected, actual;
+  scattered.merge_grads(&expected);
+  contiguous.merge_grads(&actual);
+  ASSERT_EQ(actual.size(), size);
+  for (size_t j = 0; j < size; j++) {
+    EXPECT_EQ(expected[j], actual[j]);
+  }
+}
+
+TEST(batch_storage, network_edges_are_contiguous) {
+  network<sequential> net;
+  net << fully_connected_layer(10, 20) << tanh_layer()
+      << fully_connected_layer(20, 3);
+  net.init_weight();
+
+  std::vector<tensor_t> in(16, tensor_t(1, vec_t(10)));
+  for (auto &sample : in) {
+    uniform_rand(sample[0].begin(), sample[0].end(), -1.0, 1.0);
+  }
+  net.fprop(in);
+
+  for (size_t l = 0; l < net.depth(); l++) {
+    for (auto &e : net[l]->outputs()) {
+      batch_matrix m;
+      EXPECT_TRUE(as_matrix(*e->get_data(), &m));
+      EXPECT_EQ(m.rows, 16u);
+    }
+  }
+}
+
+TEST(batch_storage, training_does_not_depend_on_layout) {
+  std::vector<vec_t> in(12, vec_t(8));
+  std::vector<vec_t> t(12, vec_t(2));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+
+  std::vector<vec_t> weights[2];
+  for (int contiguous = 0; contiguous < 2; contiguous++) {
+    set_contiguous_batches(contiguous != 0);
+    set_random_seed(11);
+    network<sequential> net;
+    net << fully_connected_layer(8, 6) << sigmoid_layer()
+        << fully_connected_layer(6, 2);
+    adagrad opt;
+    net.fit<mse>(opt, in, t, 4, 2);
+    for (size_t l = 0; l < net.depth(); l++) {
+      for (auto w : net[l]->weights()) weights[contiguous].push_back(*w);
+    }
+  }
+  set_contiguous_batches(true);
+
+  ASSERT_EQ(weights[0].size(), weights[1].size());
+  for (size_t i = 0; i < weights[0].size(); i++) {
+    for (size_t j = 0; j < weights[0][i].size(); j++) {
+      EXPECT_FLOAT_EQ(weights[0][i][j], weights[1][i][j]);
+    }
+  }
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace tiny_dnn {
+
+static void make_batching_net(network<sequential> *net) {
+  *net << fully_connected_layer(10, 20) << tanh_layer()
+       << fully_connected_layer(20, 4) << softmax_layer();
+  net->init_weight();
+}
+
+TEST(batching_predictor, coalesces_requests) {
+  network<sequential> net;
+  make_batching_net(&net);
+
+  std::vector<vec_t> in(8, vec_t(10));
+  for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+  std::vector<vec_t> expected;
+  for (auto &sample : in) expected.push_back(net.predict(sample));
+
+  // a long delay: the batch is only run once it is full
+  batching_predictor<sequential> server(net, 8, std::chrono::seconds(10));
+  std::vector<std::future<vec_t>> results;
+  for (auto &sample : in) results.push_back(server.submit(sample));
+
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t actual = results[i].get();
+    for (size_t j = 0; j < actual.size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][j], actual[j]);
+    }
+  }
+
+  auto stats = server.stats();
+  EXPECT_EQ(stats.num_requests, 8u);
+  EXPECT_EQ(stats.num_batches, 1u);
+  EXPECT_EQ(stats.largest_batch, 8u);
+  EXPECT_FLOAT_EQ(stats.average_batch_size(), 8.0);
+}
+
+TEST(batching_predictor, flushes_after_delay) {
+  network<sequential> net;
+  make_batching_net(&net);
+
+  batching_predictor<sequential> server(net, 64,
+                                        std::chrono::milliseconds(5));
+  vec_t in(10, float_t(0.5));
+  vec_t actual = server.predict(in);
+  vec_t expected = net.predict(in);
+  for (size_t j = 0; j < actual.size(); j++) {
+    EXPECT_FLOAT_EQ(expected[j], actual[j]);
+  }
+
+  auto stats = server.stats();
+  EXPECT_EQ(stats.num_batches, 1u);
+  EXPECT_EQ(stats.largest_batch, 1u);
+  EXPECT_GE(stats.max_wait.count(), 4000);
+
+  server.reset_stats();
+  EXPECT_EQ(server.stats().num_requests, 0u);
+}
+
+TEST(batching_predictor, concurrent_callers) {
+  network<sequential> net;
+  make_batching_net(&net);
+
+  const size_t ncallers = 4, nrequests = 50;
+  std::vector<vec_t> in(ncallers * nrequests, vec_t(10));
+  for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+  std::vector<vec_t> expected;
+  for (auto &sample : in) expected.push_back(net.predict(sample));
+
+  std::vector<vec_t> actual(in.size());
+  {
+    batching_predictor<sequential> server(net, 16,
+                                          std::chrono::microseconds(200));
+    std::vector<std::thread> callers;
+    for (size_t c = 0; c < ncallers; c++) {
+      callers.emplace_back([&, c] {
+        for (size_t i = c * nrequests; i < (c + 1) * nrequests; i++) {
+          actual[i] = server.predict(in[i]);
+        }
+      });
+    }
+    for (auto &t : callers) t.join();
+
+    auto stats = server.stats();
+    EXPECT_EQ(stats.num_requests, in.size());
+    EXPECT_LE(stats.largest_batch, 16u);
+  }
+
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t j = 0; j < expected[i].size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][j], actual[i][j]);
+    }
+  }
+}
+
+TEST(batching_predictor, drains_queue_on_destruction) {
+  network<sequential> net;
+  make_batching_net(&net);
+
+  std::future<vec_t> result;
+  {
+    batching_predictor<sequential> server(net, 8, std::chrono::seconds(10));
+    result = server.submit(vec_t(10, float_t(1)));
+  }
+  EXPECT_EQ(result.get().size(), 4u);
+}
+
+TEST(batching_predictor, input_size_mismatch) {
+  network<sequential> net;
+  make_batching_net(&net);
+
+  batching_predictor<sequential> server(net);
+  EXPECT_THROW(server.submit(vec_t(3)), nn_error);
+}
+
+}  // namespace tiny_dnn
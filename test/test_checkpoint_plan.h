@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/checkpoint_plan.h"
+
+namespace tiny_dnn {
+
+template <typename N>
+static void copy_weights(network<N> &src, network<N> &dst) {
+  for (size_t l = 0; l < src.depth(); l++) {
+    auto from = src[l]->weights();
+    auto to   = dst[l]->weights();
+    for (size_t i = 0; i < from.size(); i++) *to[i] = *from[i];
+  }
+}
+
+template <typename N>
+static void expect_same_weights(network<N> &a, network<N> &b) {
+  for (size_t l = 0; l < a.depth(); l++) {
+    auto wa = a[l]->weights();
+    auto wb = b[l]->weights();
+    for (size_t i = 0; i < wa.size(); i++) {
+      for (size_t j = 0; j < wa[i]->size(); j++) {
+        EXPECT_NEAR((*wa[i])[j], (*wb[i])[j], 1e-5);
+      }
+    }
+  }
+}
+
+static void make_checkpoint_chain(network<sequential> &net) {
+  net << fully_connected_layer(8, 12) << tanh_layer()
+      << fully_connected_layer(12, 12) << relu_layer()
+      << fully_connected_layer(12, 12) << sigmoid_layer()
+      << fully_connected_layer(12, 12) << tanh_layer()
+      << fully_connected_layer(12, 3);
+}
+
+TEST(checkpoint_plan, sqrt_selection) {
+  network<sequential> net;
+  make_checkpoint_chain(net);
+  net.init_weight();
+  net.set_checkpointing(true);
+
+  // 9 layers: a checkpoint every 3 layers
+  for (size_t l = 0; l < net.depth(); l++) {
+    EXPECT_EQ(net.is_checkpoint(l), l % 3 == 2);
+  }
+
+  std::vector<vec_t> in(4, vec_t(8)), t(4, vec_t(3));
+  for (auto &x : in) uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  net.fprop(sample_view(in));
+
+  auto released = [&](size_t l) {
+    return net[l]->outputs()[0]->get_data()->empty();
+  };
+  EXPECT_TRUE(released(0));
+  EXPECT_TRUE(released(1));
+  EXPECT_FALSE(released(2));
+  EXPECT_TRUE(released(4));
+  EXPECT_FALSE(released(5));
+  // the last segment is read back first by bprop
+  EXPECT_FALSE(released(6));
+  EXPECT_FALSE(released(8));
+
+  // the test phase keeps everything
+  net.set_netphase(net_phase::test);
+  net.fprop(sample_view(in));
+  EXPECT_FALSE(released(0));
+}
+
+TEST(checkpoint_plan, overrides) {
+  network<sequential> net;
+  net << fully_connected_layer(8, 12) << tanh_layer()
+      << dropout_layer(12, 0.5) << fully_connected_layer(12, 12)
+      << relu_layer() << fully_connected_layer(12, 3);
+  net.set_checkpointing(true);
+
+  net.set_checkpoint(0, true);
+  net.set_checkpoint(1, false);
+  net.set_checkpoint(2, false);
+  EXPECT_TRUE(net.is_checkpoint(0));
+  EXPECT_FALSE(net.is_checkpoint(1));
+  // dropout draws a new mask whenever it runs
+  EXPECT_TRUE(net.is_checkpoint(2));
+  EXPECT_TRUE(net.is_checkpoint(5));
+  EXPECT_THROW(net.set_checkpoint(6, true), nn_error);
+}
+
+TEST(checkpoint_plan, sequential_same_training) {
+  network<sequential> plain, checkpointed;
+  make_checkpoint_chain(plain);
+  make_checkpoint_chain(checkpointed);
+  plain.init_weight();
+  checkpointed.init_weight();
+  copy_weights(plain, checkpointed);
+  checkpointed.set_checkpointing(true);
+  checkpointed.set_checkpoint(4, false);
+
+  std::vector<vec_t> in(10, vec_t(8)), t(10, vec_t(3));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+  gradient_descent opt1, opt2;
+  plain.fit<mse>(opt1, in, t, 4, 3);
+  checkpointed.fit<mse>(opt2, in, t, 4, 3);
+  expect_same_weights(plain, checkpointed);
+}
+
+TEST(checkpoint_plan, graph_same_training) {
+  struct skip_net {
+    skip_net()
+      : in(std::make_shared<input_layer>(shape3d(6, 1, 1))),
+        fc1(std::make_shared<fully_connected_layer>(6, 8)),
+        act1(std::make_shared<tanh_layer>(8)),
+        fc2(std::make_shared<fully_connected_layer>(8, 8)),
+        act2(std::make_shared<relu_layer>(8)),
+        fc3(std::make_shared<fully_connected_layer>(8, 8)),
+        add(std::make_shared<elementwise_add_layer>(2, 8)),
+        out(std::make_shared<fully_connected_layer>(8, 2)) {
+      // act1 is read again after fc2, fc3 (skip connection)
+      in << fc1 << act1 << fc2 << act2 << fc3;
+      (act1, fc3) << add;
+      add << out;
+      construct_graph(net, {in}, {out});
+      net.init_weight();
+    }
+    std::shared_ptr<layer> in, fc1, act1, fc2, act2, fc3, add, out;
+    network<graph> net;
+  };
+  skip_net plain, checkpointed;
+  copy_weights(plain.net, checkpointed.net);
+
+  network<graph> &net = checkpointed.net;
+  net.set_checkpointing(true);
+  for (size_t l = 0; l < net.depth(); l++) {
+    net.set_checkpoint(l, net[l] == checkpointed.fc2.get());
+  }
+  // act1 is read by add, beyond the segment ending with fc2
+  for (size_t l = 0; l < net.depth(); l++) {
+    EXPECT_EQ(net.is_checkpoint(l), net[l] == checkpointed.act1.get() ||
+                                      net[l] == checkpointed.fc2.get() ||
+                                      net[l] == checkpointed.out.get());
+  }
+
+  std::vector<vec_t> in(6, vec_t(6)), t(6, vec_t(2));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+  adagrad opt1, opt2;
+  plain.net.fit<mse>(opt1, in, t, 3, 2);
+  net.fit<mse>(opt2, in, t, 3, 2);
+  expect_same_weights(plain.net, net);
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,116 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tiny_dnn/util/communicator.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace tiny_dnn {
+
+#if !defined(_WIN32)
+
+// loopback addresses of a ring of the given size. the ports depend on the
+// process id so that concurrent test runs do not collide.
+static std::vector<std::string> loopback_ring(size_t size, int offset) {
+  static int base = 20000 + static_cast<int>(::getpid() % 2000) * 20;
+  std::vector<std::string> addresses;
+  for (size_t i = 0; i < size; i++) {
+    addresses.push_back("127.0.0.1:" +
+                        std::to_string(base + offset + static_cast<int>(i)));
+  }
+  return addresses;
+}
+
+// run f(comm) on one thread per rank
+template <typename Func>
+static void run_ring(const std::vector<std::string> &addresses, Func f) {
+  std::vector<std::thread> ranks;
+  for (size_t r = 0; r < addresses.size(); r++) {
+    ranks.emplace_back([&, r] {
+      tcp_communicator comm(r, addresses);
+      f(comm);
+    });
+  }
+  for (auto &t : ranks) t.join();
+}
+
+TEST(communicator, allreduce_sum) {
+  const size_t ranks = 3, n = 1001;  // chunks of unequal size
+  std::vector<std::vector<float_t>> data(ranks, std::vector<float_t>(n));
+  for (size_t r = 0; r < ranks; r++) {
+    for (size_t i = 0; i < n; i++) data[r][i] = float_t(r * n + i);
+  }
+
+  run_ring(loopback_ring(ranks, 0), [&](communicator &comm) {
+    EXPECT_EQ(comm.size(), ranks);
+    comm.allreduce_sum(&data[comm.rank()][0], n);
+  });
+
+  for (size_t r = 0; r < ranks; r++) {
+    for (size_t i = 0; i < n; i++) {
+      EXPECT_EQ(data[r][i], float_t(3 * i + 3 * n));
+    }
+  }
+}
+
+TEST(communicator, allreduce_sum_integers) {
+  // beyond the integers a float_t represents exactly
+  const size_t ranks = 3;
+  const uint64_t big = uint64_t(1) << 40;
+  std::vector<std::vector<uint64_t>> data(ranks);
+  for (size_t r = 0; r < ranks; r++) data[r] = {big + r, r, 1};
+
+  run_ring(loopback_ring(ranks, 10), [&](communicator &comm) {
+    comm.allreduce_sum(&data[comm.rank()][0], 3);
+  });
+
+  for (size_t r = 0; r < ranks; r++) {
+    EXPECT_EQ(data[r][0], 3 * big + 3);
+    EXPECT_EQ(data[r][1], 3u);
+    EXPECT_EQ(data[r][2], 3u);
+  }
+}
+
+TEST(communicator, broadcast) {
+  const size_t ranks = 4;
+  std::vector<std::vector<float_t>> data(ranks, std::vector<float_t>(100));
+  for (size_t r = 0; r < ranks; r++) {
+    uniform_rand(data[r].begin(), data[r].end(), -1.0, 1.0);
+  }
+  std::vector<float_t> expected = data[2];
+
+  run_ring(loopback_ring(ranks, 3), [&](communicator &comm) {
+    comm.broadcast(&data[comm.rank()][0], 100, 2);
+  });
+
+  for (size_t r = 0; r < ranks; r++) {
+    for (size_t i = 0; i < 100; i++) EXPECT_EQ(data[r][i], expected[i]);
+  }
+}
+
+TEST(communicator, single_rank) {
+  tcp_communicator comm(0, {"127.0.0.1:0"});
+  EXPECT_EQ(comm.size(), 1u);
+  float_t x = 1;
+  comm.allreduce_sum(&x, 1);
+  EXPECT_EQ(x, float_t(1));
+  EXPECT_THROW(tcp_communicator(2, {"127.0.0.1:0"}), nn_error);
+}
+
+#endif  // !defined(_WIN32)
+
+}  // namespace tiny_dnn
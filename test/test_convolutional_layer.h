@@ -631,6 +631,378 @@ TEST(convolutional, gradient_check) {
   }
 }
 
+TEST(convolutional, gemm_same_as_direct) {
+  struct shape {
+    size_t width, in_channels, kernel, out_channels, stride;
+    bool same;
+  };
+  // the last one is a 1x1 convolution, which skips im2col
+  const shape shapes[] = {
+    {7, 3, 3, 8, 1, true}, {9, 2, 3, 13, 2, false}, {6, 4, 1, 7, 1, false}};
+
+  for (const shape &s : shapes) {
+    const core::conv_params params = make_conv_params(
+      s.width, s.width, s.in_channels, s.kernel, s.out_channels, s.stride, 1,
+      s.same ? padding::same : padding::valid);
+
+    tensor_t in(2, vec_t(params.in_padded.size()));
+    tensor_t delta(2, vec_t(params.out.size()));
+    vec_t W(params.weight.size()), bias(s.out_channels);
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    for (auto &v : delta) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+    tensor_t out1(2, vec_t(params.out.size())), out2 = out1;
+    kernels::conv2d_op_internal(in, W, bias, out1, params, true);
+    kernels::conv2d_op_gemm(in, W, bias, out2, params, true);
+
+    tensor_t dW1(2, vec_t(W.size())), db1(2, vec_t(bias.size()));
+    tensor_t prev1(2, vec_t(params.in_padded.size()));
+    tensor_t dW2 = dW1, db2 = db1, prev2 = prev1;
+    kernels::conv2d_op_internal(in, W, dW1, db1, delta, prev1, params, true);
+    kernels::conv2d_op_gemm(in, W, dW2, db2, delta, prev2, params, true);
+
+    expect_tensor_near(out1, out2, 1e-4);
+    expect_tensor_near(dW1, dW2, 1e-4);
+    expect_tensor_near(db1, db2, 1e-4);
+    expect_tensor_near(prev1, prev2, 1e-4);
+  }
+}
+
+TEST(convolutional, winograd_same_as_direct) {
+  struct shape {
+    size_t width, in_channels, out_channels, samples;
+    bool same;
+    size_t tile;
+  };
+  // outputs that are not a multiple of the tile size leave partial tiles
+  const shape shapes[] = {
+    {13, 5, 7, 1, true, 2}, {10, 3, 4, 2, false, 2}, {18, 6, 5, 4, true, 4},
+    {19, 2, 3, 4, false, 4}};
+
+  for (const shape &s : shapes) {
+    const core::conv_params params =
+      make_conv_params(s.width, s.width, s.in_channels, 3, s.out_channels, 1,
+                       1, s.same ? padding::same : padding::valid);
+    EXPECT_TRUE(kernels::conv2d_winograd_eligible(params));
+    EXPECT_EQ(kernels::conv2d_winograd_tile_size(params), s.tile);
+
+    tensor_t in(s.samples, vec_t(params.in_padded.size()));
+    vec_t W(params.weight.size()), bias(s.out_channels);
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+    kernels::conv2d_winograd_filter filter;
+    size_t version = 0;
+    auto expect_near = [&]() {
+      tensor_t out1(s.samples, vec_t(params.out.size())), out2 = out1;
+      kernels::conv2d_op_internal(in, W, bias, out1, params, true);
+      kernels::conv2d_op_winograd(in, W, bias, out2, params, filter, version,
+                                  true);
+      // the transforms round more than the direct sums
+      expect_tensor_near(out1, out2, 1e-3);
+    };
+    expect_near();
+    // the cached filters follow the version of the weights
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    version++;
+    expect_near();
+  }
+}
+
+TEST(convolutional, winograd_layer_selection) {
+  struct shape {
+    size_t width, in_channels, out_channels;
+    bool winograd;
+    size_t tile;
+  };
+  // both sides of 16 channels, and of the 16x16 outputs that switch to the
+  // larger tile
+  const shape shapes[] = {{18, 16, 16, true, 4},  {17, 16, 16, true, 2},
+                          {14, 16, 16, true, 2},  {14, 15, 16, false, 0},
+                          {14, 16, 15, false, 0}, {14, 8, 8, false, 0}};
+  const size_t samples = 4;
+
+  for (const shape &s : shapes) {
+    convolutional_layer l(s.width, s.width, 3, s.in_channels, s.out_channels,
+                          padding::valid, true, 1, 1, 1, 1,
+                          core::backend_t::internal);
+    const core::conv_params params =
+      make_conv_params(s.width, s.width, s.in_channels, 3, s.out_channels);
+    EXPECT_EQ(kernels::conv2d_winograd_preferred(params), s.winograd);
+
+    tensor_t in(samples, vec_t(params.in.size()));
+    tensor_t W(1, vec_t(params.weight.size())), bias(1, vec_t(s.out_channels));
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    uniform_rand(W[0].begin(), W[0].end(), -1.0, 1.0);
+    uniform_rand(bias[0].begin(), bias[0].end(), -1.0, 1.0);
+
+    tensor_t out(samples, vec_t(params.out.size()));
+    std::vector<tensor_t *> in_data = {&in, &W, &bias}, out_data = {&out};
+    l.forward_propagation(in_data, out_data);
+
+    // the layer computes exactly what the kernel it selects does
+    tensor_t selected(samples, vec_t(params.out.size()));
+    if (s.winograd) {
+      EXPECT_EQ(kernels::conv2d_winograd_tile_size(params), s.tile);
+      kernels::conv2d_winograd_filter filter;
+      kernels::conv2d_op_winograd(in, W[0], bias[0], selected, params, filter,
+                                  0, l.parallelize());
+    } else {
+      kernels::conv2d_op_gemm(in, W[0], bias[0], selected, params,
+                              l.parallelize());
+    }
+    tensor_t expected(samples, vec_t(params.out.size()));
+    kernels::conv2d_op_internal(in, W[0], bias[0], expected, params, true);
+    for (size_t i = 0; i < out.size(); i++) {
+      for (size_t j = 0; j < out[i].size(); j++) {
+        EXPECT_EQ(out[i][j], selected[i][j]);
+        EXPECT_NEAR(out[i][j], expected[i][j], 1e-3);
+      }
+    }
+  }
+}
+
+TEST(convolutional, winograd_batch_same_as_single_sample) {
+  // both tile sizes, with enough samples to fill the larger tiles
+  network<sequential> net;
+  net << convolutional_layer(18, 18, 3, 16, 16) << relu()
+      << convolutional_layer(16, 16, 3, 16, 16);
+
+  std::vector<tensor_t> in(8, tensor_t(1, vec_t(18 * 18 * 16)));
+  for (auto &t : in) uniform_rand(t[0].begin(), t[0].end(), -1.0, 1.0);
+
+  std::vector<tensor_t> batch = net.predict(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t single = net.predict(in[i][0]);
+    for (size_t j = 0; j < single.size(); j++) {
+      EXPECT_EQ(batch[i][0][j], single[j]);
+    }
+  }
+}
+
+TEST(convolutional, fft_same_as_direct) {
+  struct shape {
+    size_t width, height, in_channels, kernel, out_channels, dilation;
+    bool same;
+  };
+  // several tiles with partial ones at the border, a single tile smaller
+  // than the filter tile, and a dilated filter
+  const shape shapes[] = {{40, 23, 3, 7, 4, 1, true},
+                          {37, 37, 2, 11, 3, 1, false},
+                          {9, 6, 2, 7, 2, 1, true},
+                          {30, 30, 2, 5, 3, 2, false}};
+
+  for (const shape &s : shapes) {
+    const core::conv_params params = make_conv_params(
+      s.width, s.height, s.in_channels, s.kernel, s.out_channels, 1,
+      s.dilation, s.same ? padding::same : padding::valid);
+    EXPECT_TRUE(kernels::conv2d_fft_eligible(params));
+
+    tensor_t in(2, vec_t(params.in_padded.size()));
+    vec_t W(params.weight.size()), bias(s.out_channels);
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+    kernels::conv2d_fft_filter filter;
+    size_t version = 0;
+    auto expect_near = [&]() {
+      tensor_t out1(2, vec_t(params.out.size())), out2 = out1;
+      kernels::conv2d_op_internal(in, W, bias, out1, params, true);
+      kernels::conv2d_op_fft(in, W, bias, out2, params, filter, version, true);
+      expect_tensor_near(out1, out2, 1e-3);
+    };
+    expect_near();
+    // the cached spectra follow the version of the weights
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    version++;
+    expect_near();
+  }
+}
+
+TEST(convolutional, fft_engine) {
+  convolutional_layer l(20, 16, 7, 2, 3, padding::same);
+
+  tensor_buf data(l), grad1(l);
+  tensor_buf out(l), grad2(grad1);
+
+  l.set_backend_type(tiny_dnn::core::backend_t::internal);
+  l.forward_propagation(data.in_buf(), data.out_buf());
+  l.back_propagation(data.in_buf(), data.out_buf(), grad1.out_buf(),
+                     grad1.in_buf());
+
+  l.set_backend_type(tiny_dnn::core::backend_t::fft);
+  l.forward_propagation(data.in_buf(), out.out_buf());
+  l.back_propagation(data.in_buf(), out.out_buf(), grad2.out_buf(),
+                     grad2.in_buf());
+
+  for (size_t i = 0; i < out.out_at(0)[0].size(); i++) {
+    EXPECT_NEAR(out.out_at(0)[0][i], data.out_at(0)[0][i], 1e-4);
+  }
+  for (size_t i = 0; i < grad1.in_at(0)[0].size(); i++) {
+    EXPECT_NEAR(grad1.in_at(0)[0][i], grad2.in_at(0)[0][i], 1e-4);
+  }
+}
+
+TEST(convolutional, transformed_filters_follow_weights) {
+  // 3x3 filters on 16 channels: the internal engine computes them with
+  // winograd, on filters transformed once per version of the weights
+  network<sequential> net, gemm;
+  net << convolutional_layer(8, 8, 3, 16, 16, padding::same);
+  gemm << convolutional_layer(8, 8, 3, 16, 16, padding::same, true, 1, 1, 1,
+                              1, core::backend_t::gemm);
+  gemm[0]->set_parallelize(false);
+
+  vec_t in(8 * 8 * 16);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  auto expect_near = [&]() {
+    *gemm[0]->weights()[0] = *net[0]->weights()[0];
+    *gemm[0]->weights()[1] = *net[0]->weights()[1];
+    const vec_t out      = net.predict(in);
+    const vec_t expected = gemm.predict(in);
+    for (size_t i = 0; i < out.size(); i++) {
+      EXPECT_NEAR(out[i], expected[i], 1e-3);
+    }
+  };
+  net.predict(in);
+  const size_t version = net[0]->weights_version();
+  net.predict(in);
+  EXPECT_EQ(net[0]->weights_version(), version);
+
+  vec_t &W = *net[0]->weights()[0];
+  EXPECT_NE(net[0]->weights_version(), version);
+  uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+  expect_near();
+
+  // written again after being handed out
+  uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+  net[0]->weights_changed();
+  expect_near();
+
+  // and updated by training
+  std::vector<vec_t> x(1, in), t(1, vec_t(8 * 8 * 16, float_t(0)));
+  gradient_descent opt;
+  net.fit<mse>(opt, x, t, 1, 1);
+  expect_near();
+}
+
+TEST(convolutional, blocked_same_as_direct) {
+  const size_t b = kernels::channel_block;
+  if (b == 1) return;  // the channels are not blocked without SIMD
+
+  struct shape {
+    size_t width, height, in_channels, kernel, out_channels, stride, dilation;
+    bool same;
+  };
+  // input channels not filling a block, an odd number of output blocks, a
+  // strided and a dilated filter, and rows narrower than a register block
+  const shape shapes[] = {{13, 11, 3, 3, 2 * b, 1, 1, true},
+                          {9, 9, 2 * b, 5, b, 2, 1, false},
+                          {7, 6, 2 * b, 1, 3 * b, 1, 1, false},
+                          {10, 8, b, 3, 2 * b, 1, 2, true},
+                          {4, 5, b, 3, b, 1, 1, true}};
+
+  for (const shape &s : shapes) {
+    core::conv_params params = make_conv_params(
+      s.width, s.height, s.in_channels, s.kernel, s.out_channels, s.stride,
+      s.dilation, s.same ? padding::same : padding::valid);
+
+    tensor_t in(2, vec_t(params.in_padded.size())), in_blocked(2);
+    vec_t W(params.weight.size()), bias(s.out_channels);
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    const bool blockable = kernels::channel_blockable(params.in);
+    for (size_t i = 0; blockable && i < in.size(); i++) {
+      kernels::to_channel_blocked(in[i], params.in_padded, in_blocked[i]);
+    }
+    uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+    kernels::conv2d_blocked_filter filter;
+    for (size_t version = 0; version < 2; version++) {
+      // the packed filters follow the version of the weights
+      uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+      tensor_t expected(2, vec_t(params.out.size()));
+      kernels::conv2d_op_internal(in, W, bias, expected, params, true);
+
+      for (int layouts = 0; layouts < 4; layouts++) {
+        params.blocked_input  = (layouts & 1) != 0;
+        params.blocked_output = (layouts & 2) != 0;
+        if (params.blocked_input && !blockable) continue;
+
+        tensor_t out(2, vec_t(params.out.size()));
+        kernels::conv2d_op_blocked(params.blocked_input ? in_blocked : in, W,
+                                   bias, out, params, filter, version, true);
+        tensor_t actual = out;
+        for (size_t i = 0; params.blocked_output && i < out.size(); i++) {
+          kernels::from_channel_blocked(out[i], params.out, actual[i]);
+        }
+        expect_tensor_near(expected, actual, 1e-4);
+      }
+    }
+  }
+}
+
+TEST(convolutional, blocked_layout) {
+  const size_t b = kernels::channel_block;
+  if (b == 1) return;
+
+  convolutional_layer l(9, 7, 3, b, 2 * b, padding::same);
+  tensor_buf data(l), blocked(data), planar(data);
+
+  l.forward_propagation(data.in_buf(), data.out_buf());
+
+  // the layer pads the blocked input itself
+  kernels::to_channel_blocked(data.in_at(0)[0], l.in_shape()[0],
+                              blocked.in_at(0)[0]);
+  l.set_channel_blocking(true, true);
+  l.forward_propagation(blocked.in_buf(), blocked.out_buf());
+  vec_t out;
+  kernels::from_channel_blocked(blocked.out_at(0)[0], l.out_shape()[0], out);
+  for (size_t i = 0; i < out.size(); i++) {
+    EXPECT_NEAR(data.out_at(0)[0][i], out[i], 1e-4);
+  }
+
+  l.set_channel_blocking(false, false);
+  l.forward_propagation(planar.in_buf(), planar.out_buf());
+  for (size_t i = 0; i < out.size(); i++) {
+    EXPECT_FLOAT_EQ(data.out_at(0)[0][i], planar.out_at(0)[0][i]);
+  }
+}
+
+TEST(convolutional, pad_blocked_input) {
+  const size_t b = kernels::channel_block;
+  if (b == 1) return;
+
+  const core::conv_params params =
+    make_conv_params(4, 3, 2 * b, 5, b, 1, 1, padding::same);
+
+  tensor_t in(2, vec_t(params.in.size()));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  // the buffer held something else before, the border must be cleared
+  tensor_t out(2, vec_t(params.in_padded.size(), float_t(7)));
+  kernels::conv2d_pad_blocked_input(in, params, out);
+
+  const size_t left = 2, top = 2;
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t blk = 0; blk < 2; blk++) {
+      for (size_t y = 0; y < 7; y++) {
+        for (size_t x = 0; x < 8; x++) {
+          const bool inside = y >= top && y < top + 3 && x >= left &&
+                              x < left + 4;
+          for (size_t c = 0; c < b; c++) {
+            const float_t expected =
+              inside ? in[i][((blk * 3 + y - top) * 4 + x - left) * b + c]
+                     : float_t(0);
+            EXPECT_EQ(out[i][((blk * 7 + y) * 8 + x) * b + c], expected);
+          }
+        }
+      }
+    }
+  }
+}
+
 TEST(convolutional, read_write) {
   convolutional_layer l1(5, 5, 3, 1, 1);
   convolutional_layer l2(5, 5, 3, 1, 1);
@@ -659,14 +1031,8 @@ TEST(convolutional, read_write2) {
 }
 
 TEST(convolutional, copy_and_pad_input_same) {
-  core::conv_params params;
-  params.in        = shape3d(5, 5, 1);
-  params.weight    = shape3d(3, 3, 2);
-  params.in_padded = shape3d(7, 7, 1);
-  params.out       = shape3d(3, 3, 1);
-  params.pad_type  = padding::same;  // test target
-  params.w_stride  = 1;
-  params.h_stride  = 1;
+  const core::conv_params params =
+    make_conv_params(5, 5, 1, 3, 1, 1, 1, padding::same);  // test target
 
   core::Conv2dPadding conv2d_padding(params);
 
@@ -699,14 +1065,8 @@ TEST(convolutional, copy_and_pad_input_same) {
 }
 
 TEST(convolutional, copy_and_unpad_delta_same) {
-  core::conv_params params;
-  params.in        = shape3d(3, 3, 1);
-  params.weight    = shape3d(2, 2, 1);
-  params.in_padded = shape3d(5, 5, 1);
-  params.out       = shape3d(2, 2, 1);
-  params.pad_type  = padding::same;  // test target
-  params.w_stride  = 1;
-  params.h_stride  = 1;
+  const core::conv_params params =
+    make_conv_params(3, 3, 1, 3, 1, 1, 1, padding::same);  // test target
 
   core::Conv2dPadding conv2d_padding(params);
 
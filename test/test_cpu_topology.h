@@ -0,0 +1,35 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/util/cpu_topology.h"
+
+namespace tiny_dnn {
+
+TEST(cpu_topology, parse_cpu_list) {
+  EXPECT_EQ(cpu_topology::parse_cpu_list("0-3,8,10-11\n"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(cpu_topology::parse_cpu_list("5"), std::vector<int>({5}));
+  EXPECT_TRUE(cpu_topology::parse_cpu_list("").empty());
+}
+
+TEST(cpu_topology, detect) {
+  const cpu_topology &topology = cpu_topology::instance();
+  EXPECT_GE(topology.num_nodes(), 1u);
+
+  size_t total = 0;
+  for (size_t n = 0; n < topology.num_nodes(); n++) {
+    EXPECT_FALSE(topology.cpus(n).empty());
+    total += topology.cpus(n).size();
+  }
+  EXPECT_EQ(topology.cpus_by_node().size(), total);
+}
+
+}  // namespace tiny_dnn
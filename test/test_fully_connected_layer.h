@@ -99,4 +99,101 @@ TEST(fully_connected, forward_nobias) {
   }
 }
 
+TEST(fully_connected, gemm_same_as_internal) {
+  for (bool has_bias : {true, false}) {
+    core::fully_params params;
+    params.in_size_  = 37;
+    params.out_size_ = 13;
+    params.has_bias_ = has_bias;
+    const size_t samples = 7;
+
+    tensor_t in(samples, vec_t(params.in_size_));
+    tensor_t delta(samples, vec_t(params.out_size_));
+    vec_t W(params.in_size_ * params.out_size_), bias(params.out_size_);
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    for (auto &v : delta) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+    tensor_t out1(samples, vec_t(params.out_size_)), out2 = out1;
+    kernels::fully_connected_op_internal(in, W, bias, out1, params, true);
+    kernels::fully_connected_op_gemm(in, W, bias, out2, params, true);
+
+    tensor_t dW1(samples, vec_t(W.size())), db1(samples, vec_t(bias.size()));
+    tensor_t prev1(samples, vec_t(params.in_size_));
+    tensor_t dW2 = dW1, db2 = db1, prev2 = prev1;
+    kernels::fully_connected_op_internal(in, W, dW1, db1, delta, prev1, params,
+                                         true);
+    kernels::fully_connected_op_gemm(in, W, dW2, db2, delta, prev2, params,
+                                     true);
+
+    for (size_t i = 0; i < samples; i++) {
+      for (size_t j = 0; j < params.out_size_; j++) {
+        EXPECT_NEAR(out1[i][j], out2[i][j], 1e-4);
+      }
+      for (size_t j = 0; j < params.in_size_; j++) {
+        EXPECT_NEAR(prev1[i][j], prev2[i][j], 1e-4);
+      }
+    }
+    // a sample has the same outputs alone as in the batch
+    tensor_t one{in[3]}, out3(1, vec_t(params.out_size_));
+    kernels::fully_connected_op_gemm(one, W, bias, out3, params, true);
+    for (size_t j = 0; j < params.out_size_; j++) {
+      EXPECT_EQ(out2[3][j], out3[0][j]);
+    }
+    // the gemm kernel sums the gradients of the batch in the first sample
+    auto expect_same_sum = [&](const tensor_t &a, const tensor_t &b) {
+      for (size_t j = 0; j < a[0].size(); j++) {
+        float_t sa = 0, sb = 0;
+        for (size_t i = 0; i < samples; i++) {
+          sa += a[i][j];
+          sb += b[i][j];
+        }
+        EXPECT_NEAR(sa, sb, 1e-4);
+      }
+    };
+    expect_same_sum(dW1, dW2);
+    if (has_bias) expect_same_sum(db1, db2);
+  }
+}
+
+TEST(fully_connected, batch_same_as_single_sample) {
+  // a few outputs, so the product is split over the samples as well
+  thread_pool_size_scope pool(4);
+  network<sequential> net;
+  net << fully_connected_layer(50, 10);
+
+  std::vector<tensor_t> in(64, tensor_t(1, vec_t(50)));
+  for (auto &t : in) uniform_rand(t[0].begin(), t[0].end(), -1.0, 1.0);
+
+  std::vector<tensor_t> batch = net.predict(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t single = net.predict(in[i][0]);
+    for (size_t j = 0; j < single.size(); j++) {
+      EXPECT_EQ(batch[i][0][j], single[j]);
+    }
+  }
+}
+
+TEST(fully_connected, gemm_engine) {
+  fully_connected_layer internal(20, 7, true, core::backend_t::internal);
+  fully_connected_layer gemm(20, 7, true, core::backend_t::gemm);
+  internal.setup(true);
+  gemm.setup(true);
+  for (size_t i = 0; i < internal.weights().size(); i++) {
+    *gemm.weights()[i] = *internal.weights()[i];
+  }
+
+  tensor_t in(3, vec_t(20));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  std::vector<const tensor_t *> out_internal, out_gemm;
+  internal.forward({in}, out_internal);
+  gemm.forward({in}, out_gemm);
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t j = 0; j < 7; j++) {
+      EXPECT_NEAR((*out_internal[0])[i][j], (*out_gemm[0])[i][j], 1e-5);
+    }
+  }
+}
+
 }  // namespace tiny_dnn
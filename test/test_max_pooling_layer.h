@@ -281,6 +281,35 @@ TEST(max_pool, backward) {
 }
 
 #ifndef CNN_NO_SERIALIZATION
+TEST(max_pool, blocked_layout) {
+  const size_t b = kernels::channel_block;
+  if (b == 1) return;  // the channels are not blocked without SIMD
+
+  // the last windows are cut by the border
+  max_pooling_layer l(9, 7, 2 * b, 2, 2, 2, 2, padding::same);
+  vec_t in(l.in_shape()[0].size()), blocked_in;
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+
+  std::vector<const tensor_t *> out;
+  l.forward({{in}}, out);
+  vec_t expected = (*out[0])[0];
+
+  kernels::to_channel_blocked(in, l.in_shape()[0], blocked_in);
+  for (int layouts = 1; layouts < 4; layouts++) {
+    const bool blocked_input = (layouts & 1) != 0;
+    const bool blocked_output = (layouts & 2) != 0;
+    l.set_channel_blocking(blocked_input, blocked_output);
+    l.forward({{blocked_input ? blocked_in : in}}, out);
+    vec_t actual = (*out[0])[0];
+    if (blocked_output) {
+      kernels::from_channel_blocked((*out[0])[0], l.out_shape()[0], actual);
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_FLOAT_EQ(expected[i], actual[i]);
+    }
+  }
+}
+
 TEST(max_pool, serialization) {
   max_pooling_layer src(4, 4, 1, 2);
 
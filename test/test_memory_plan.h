@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/memory_plan.h"
+
+namespace tiny_dnn {
+
+TEST(memory_plan, chain_uses_two_arenas) {
+  network<sequential> net;
+  net << fully_connected_layer(16, 32) << relu_layer()
+      << fully_connected_layer(32, 32) << tanh_layer()
+      << fully_connected_layer(32, 32) << relu_layer()
+      << fully_connected_layer(32, 4);
+  net.init_weight();
+
+  memory_usage usage = net.activation_memory(8);
+  EXPECT_EQ(usage.arenas, 2u);
+  EXPECT_EQ(usage.naive_bytes,
+            8 * (6 * 32 + batch_stride(4)) * sizeof(float_t));
+  EXPECT_EQ(usage.planned_bytes,
+            8 * (2 * 32 + batch_stride(4)) * sizeof(float_t));
+
+  // every other layer writes to the same arena
+  auto first_sample = [&](size_t layer) {
+    return &(*net[layer]->outputs()[0]->get_data())[0][0];
+  };
+  net.set_memory_planning(true);
+  net.set_netphase(net_phase::test);
+  net.predict(vec_t(16));
+  EXPECT_EQ(first_sample(0), first_sample(2));
+  EXPECT_EQ(first_sample(1), first_sample(3));
+  EXPECT_NE(first_sample(0), first_sample(1));
+
+  net.set_memory_planning(false);
+  net.predict(vec_t(16));
+  EXPECT_NE(first_sample(0), first_sample(2));
+}
+
+TEST(memory_plan, sequential_predictions_unchanged) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 1, 4) << relu_layer()
+      << average_pooling_layer(6, 6, 4, 2) << fully_connected_layer(36, 10)
+      << sigmoid_layer() << fully_connected_layer(10, 3);
+  net.init_weight();
+  net.set_netphase(net_phase::test);
+
+  std::vector<tensor_t> in(5, tensor_t(1, vec_t(64)));
+  for (auto &x : in) uniform_rand(x[0].begin(), x[0].end(), -1.0, 1.0);
+  std::vector<vec_t> expected;
+  for (auto &x : in) expected.push_back(net.predict(x[0]));
+  std::vector<tensor_t> expected_batch = net.predict(in);
+
+  net.set_memory_planning(true);
+  for (int repeat = 0; repeat < 2; repeat++) {
+    std::vector<tensor_t> batch = net.predict(in);
+    for (size_t i = 0; i < in.size(); i++) {
+      vec_t single = net.predict(in[i][0]);
+      for (size_t j = 0; j < single.size(); j++) {
+        EXPECT_FLOAT_EQ(single[j], expected[i][j]);
+        EXPECT_FLOAT_EQ(batch[i][0][j], expected_batch[i][0][j]);
+      }
+    }
+  }
+
+  // the planned activations are contiguous batches too
+  batch_matrix m;
+  net.predict(in);
+  EXPECT_TRUE(as_matrix(*net[2]->outputs()[0]->get_data(), &m));
+  EXPECT_EQ(m.rows, in.size());
+}
+
+TEST(memory_plan, graph_predictions_unchanged) {
+  auto in   = std::make_shared<input_layer>(shape3d(6, 1, 1));
+  auto fc1  = std::make_shared<fully_connected_layer>(6, 8);
+  auto act1 = std::make_shared<tanh_layer>(8);
+  auto fc2  = std::make_shared<fully_connected_layer>(8, 8);
+  auto act2 = std::make_shared<relu_layer>(8);
+  auto fc3  = std::make_shared<fully_connected_layer>(8, 8);
+  auto add  = std::make_shared<elementwise_add_layer>(2, 8);
+  auto out  = std::make_shared<fully_connected_layer>(8, 2);
+
+  // act1 is read again after fc2, fc3 (skip connection)
+  in << fc1 << act1 << fc2 << act2 << fc3;
+  (act1, fc3) << add;
+  add << out;
+
+  network<graph> net;
+  construct_graph(net, {in}, {out});
+  net.init_weight();
+  net.set_netphase(net_phase::test);
+
+  std::vector<tensor_t> x(3, tensor_t(1, vec_t(6)));
+  for (auto &v : x) uniform_rand(v[0].begin(), v[0].end(), -1.0, 1.0);
+  std::vector<tensor_t> expected = net.predict(x);
+
+  net.set_memory_planning(true);
+  EXPECT_LT(net.activation_memory().planned_bytes,
+            net.activation_memory().naive_bytes);
+  std::vector<tensor_t> actual = net.predict(x);
+  for (size_t i = 0; i < x.size(); i++) {
+    for (size_t j = 0; j < 2; j++) {
+      EXPECT_FLOAT_EQ(actual[i][0][j], expected[i][0][j]);
+    }
+  }
+  vec_t single = net.predict(x[1][0]);
+  EXPECT_FLOAT_EQ(single[0], expected[1][0][0]);
+  EXPECT_FLOAT_EQ(single[1], expected[1][0][1]);
+}
+
+TEST(memory_plan, backward_needs_train_phase) {
+  network<sequential> net;
+  net << fully_connected_layer(4, 6) << tanh_layer()
+      << fully_connected_layer(6, 2);
+  net.init_weight();
+  net.set_memory_planning(true);
+  net.set_netphase(net_phase::test);
+
+  std::vector<vec_t> in{vec_t{1, 2, 3, 4}}, t{vec_t{0, 1}};
+  std::vector<vec_t> cost;
+  EXPECT_THROW(net.bprop<mse>(net.fprop(in), t, cost), nn_error);
+
+  net.set_netphase(net_phase::train);
+  net.bprop<mse>(net.fprop(in), t, cost);
+
+  // training sets the train phase by itself
+  net.set_netphase(net_phase::test);
+  net.fprop(in);
+  adagrad opt;
+  net.fit<mse>(opt, in, t, 1, 1);
+  net.fprop(in);
+}
+
+}  // namespace tiny_dnn
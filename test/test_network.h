@@ -7,8 +7,10 @@
 */
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -261,6 +263,279 @@ TEST(network, train_predict) {
   }
 }
 
+// the replicated training modes copy the network through serialization
+#ifndef CNN_NO_SERIALIZATION
+TEST(network, train_hogwild) {
+  // train xor function, 4 minibatches at a time
+  network<sequential> net;
+  adagrad optimizer;
+
+  std::vector<vec_t> data;
+  std::vector<label_t> label;
+  size_t tnum = 400;
+
+  optimizer.alpha *= 10;
+
+  for (size_t i = 0; i < tnum; i++) {
+    bool in[2] = {bernoulli(0.5), bernoulli(0.5)};
+    data.push_back({static_cast<float_t>(in[0]), static_cast<float_t>(in[1])});
+    label.push_back((in[0] ^ in[1]) ? 1 : 0);
+  }
+
+  net << fully_connected_layer(2, 10) << tanh_layer()
+      << fully_connected_layer(10, 2) << tanh_layer();
+  net.set_training_mode(training_mode::hogwild, 4);
+  EXPECT_TRUE(net.get_training_mode() == training_mode::hogwild);
+  EXPECT_EQ(net.training_workers(), 4u);
+
+  // make sure the workers run at the same time
+  thread_pool_size_scope pool(4);
+
+  std::atomic<int> batches(0);
+  int epochs = 0;
+  net.fit<mse>(optimizer, data, label, 10, 20, [&]() { batches++; },
+               [&]() { epochs++; });
+  EXPECT_EQ(batches.load(), 20 * 40);
+  EXPECT_EQ(epochs, 20);
+
+  for (size_t i = 0; i < 4; i++) {
+    const vec_t input      = {float_t(i & 1), float_t(i >> 1)};
+    const label_t expected = ((i & 1) ^ (i >> 1)) ? 1 : 0;
+    EXPECT_EQ(expected, net.predict_label(input));
+  }
+
+  // stop_ongoing_training() is honoured by the workers
+  batches = 0;
+  net.fit<mse>(optimizer, data, label, 10, 20, [&]() {
+    if (++batches == 5) net.stop_ongoing_training();
+  }, []() {});
+  EXPECT_LE(batches.load(), 5 + 4);
+}
+
+TEST(network, train_data_parallel) {
+  auto make_net = [](network<sequential> *net) {
+    set_random_seed(7);
+    *net << convolutional_layer(6, 6, 3, 1, 2, padding::same) << relu_layer()
+         << average_pooling_layer(6, 6, 2, 2) << fully_connected_layer(18, 8)
+         << tanh_layer() << fully_connected_layer(8, 3) << sigmoid_layer();
+    net->init_weight();
+  };
+  network<sequential> expected, actual;
+  make_net(&expected);
+  make_net(&actual);
+
+  // 10 samples per minibatch, split into uneven shards of 2 and 3
+  std::vector<tensor_t> in(20, tensor_t(1, vec_t(36)));
+  std::vector<tensor_t> t(20, tensor_t(1, vec_t(3)));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i][0].begin(), in[i][0].end(), -1.0, 1.0);
+    uniform_rand(t[i][0].begin(), t[i][0].end(), 0.0, 1.0);
+  }
+
+  gradient_descent opt_expected, opt_actual;
+  expected.fit<mse>(opt_expected, in, t, 10, 2);
+
+  thread_pool_size_scope pool(4);
+
+  actual.set_training_mode(training_mode::data_parallel, 4);
+  actual.fit<mse>(opt_actual, in, t, 10, 2);
+
+  for (size_t l = 0; l < expected.depth(); l++) {
+    auto w_expected = expected[l]->weights();
+    auto w_actual   = actual[l]->weights();
+    ASSERT_EQ(w_expected.size(), w_actual.size());
+    for (size_t i = 0; i < w_expected.size(); i++) {
+      for (size_t j = 0; j < w_expected[i]->size(); j++) {
+        EXPECT_NEAR((*w_expected[i])[j], (*w_actual[i])[j], 1e-5);
+      }
+    }
+  }
+}
+
+TEST(network, train_replicated_batch_norm) {
+  // the moving statistics are all that batch normalization trains
+  std::vector<tensor_t> in(40, tensor_t(1, vec_t(8)));
+  std::vector<tensor_t> t(40, tensor_t(1, vec_t(8)));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i][0].begin(), in[i][0].end(), 2.0, 4.0);
+  }
+  tensor_t probe(1, vec_t(8, float_t(3)));
+  probe[0][1] = float_t(2.5);
+
+  network<sequential> expected;
+  expected << batch_normalization_layer(4, 2, 1e-5, 0.8);
+  gradient_descent opt;
+  expected.fit<mse>(opt, in, t, 10, 3);
+  const vec_t y_expected = expected.predict(probe)[0];
+
+  thread_pool_size_scope pool(4);
+
+  // the shards of data parallel training merge into the statistics of
+  // the whole minibatch
+  network<sequential> data_parallel;
+  data_parallel << batch_normalization_layer(4, 2, 1e-5, 0.8);
+  data_parallel.set_training_mode(training_mode::data_parallel, 3);
+  data_parallel.fit<mse>(opt, in, t, 10, 3);
+  const vec_t y_data_parallel = data_parallel.predict(probe)[0];
+
+  // hogwild folds in the minibatches in another order
+  network<sequential> hogwild;
+  hogwild << batch_normalization_layer(4, 2, 1e-5, 0.8);
+  hogwild.set_training_mode(training_mode::hogwild, 4);
+  hogwild.fit<mse>(opt, in, t, 10, 3);
+  const vec_t y_hogwild = hogwild.predict(probe)[0];
+
+  for (size_t i = 0; i < y_expected.size(); i++) {
+    EXPECT_NEAR(y_expected[i], y_data_parallel[i], 1e-4);
+    EXPECT_NEAR(y_expected[i], y_hogwild[i], 0.25);
+  }
+}
+#endif  // #ifndef CNN_NO_SERIALIZATION
+
+TEST(network, train_overlapped_updates) {
+  auto make_net = [](network<sequential> *net) {
+    set_random_seed(3);
+    *net << fully_connected_layer(10, 600) << relu_layer()
+         << fully_connected_layer(600, 4) << sigmoid_layer();
+    net->init_weight();
+  };
+  network<sequential> expected, actual;
+  make_net(&expected);
+  make_net(&actual);
+  actual.set_overlap_updates(true);
+  EXPECT_TRUE(actual.overlap_updates());
+
+  std::vector<tensor_t> in(20, tensor_t(1, vec_t(10)));
+  std::vector<tensor_t> t(20, tensor_t(1, vec_t(4)));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i][0].begin(), in[i][0].end(), -1.0, 1.0);
+    uniform_rand(t[i][0].begin(), t[i][0].end(), 0.0, 1.0);
+  }
+
+  // minibatches of 5, then single samples
+  adagrad opt_expected, opt_actual;
+  expected.fit<mse>(opt_expected, in, t, 5, 2);
+  actual.fit<mse>(opt_actual, in, t, 5, 2);
+  expected.fit<mse>(opt_expected, in, t, 1, 1);
+  actual.fit<mse>(opt_actual, in, t, 1, 1);
+
+  for (size_t l = 0; l < expected.depth(); l++) {
+    auto w_expected = expected[l]->weights();
+    auto w_actual   = actual[l]->weights();
+    for (size_t i = 0; i < w_expected.size(); i++) {
+      for (size_t j = 0; j < w_expected[i]->size(); j++) {
+        EXPECT_FLOAT_EQ((*w_expected[i])[j], (*w_actual[i])[j]);
+      }
+    }
+  }
+}
+
+#if !defined(_WIN32)
+TEST(network, train_distributed) {
+  auto make_net = [](network<sequential> *net, unsigned int seed) {
+    set_random_seed(seed);
+    *net << fully_connected_layer(6, 8) << tanh_layer()
+         << fully_connected_layer(8, 3) << sigmoid_layer();
+    net->init_weight();
+  };
+
+  // 3 processes with 4 samples per minibatch, trained like a single
+  // process with 12 samples per minibatch
+  const size_t ranks = 3, local_batch = 4, batches = 2;
+  std::vector<std::vector<tensor_t>> in(ranks), t(ranks);
+  std::vector<tensor_t> all_in, all_t;
+  for (size_t b = 0; b < batches; b++) {
+    for (size_t r = 0; r < ranks; r++) {
+      for (size_t i = 0; i < local_batch; i++) {
+        vec_t x(6), y(3);
+        uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+        uniform_rand(y.begin(), y.end(), 0.0, 1.0);
+        in[r].push_back(tensor_t{x});
+        t[r].push_back(tensor_t{y});
+        all_in.push_back(tensor_t{x});
+        all_t.push_back(tensor_t{y});
+      }
+    }
+  }
+
+  network<sequential> expected;
+  make_net(&expected, 1);
+  adagrad opt_expected;
+  expected.fit<mse>(opt_expected, all_in, all_t, ranks * local_batch, 3);
+
+  // the ranks start from different weights, rank 0 wins
+  std::vector<network<sequential>> nets(ranks);
+  for (size_t r = 0; r < ranks; r++) make_net(&nets[r], unsigned(r + 1));
+
+  run_ring(loopback_ring(ranks, 7), [&](communicator &comm) {
+    size_t r = comm.rank();
+    nets[r].set_communicator(std::shared_ptr<communicator>(
+      &comm, [](communicator *) {}));
+    adagrad opt;
+    nets[r].fit<mse>(opt, in[r], t[r], local_batch, 3);
+  });
+
+  for (size_t l = 0; l < expected.depth(); l++) {
+    auto w_expected = expected[l]->weights();
+    for (size_t i = 0; i < w_expected.size(); i++) {
+      for (size_t j = 0; j < w_expected[i]->size(); j++) {
+        float_t w0 = (*nets[0][l]->weights()[i])[j];
+        EXPECT_NEAR((*w_expected[i])[j], w0, 1e-5);
+        for (size_t r = 1; r < ranks; r++) {
+          EXPECT_EQ(w0, (*nets[r][l]->weights()[i])[j]);
+        }
+      }
+    }
+  }
+}
+
+TEST(network, train_distributed_batch_norm) {
+  auto make_net = [](network<sequential> *net) {
+    set_random_seed(1);
+    *net << fully_connected_layer(6, 8) << batch_normalization_layer(1, 8)
+         << tanh_layer() << fully_connected_layer(8, 3);
+    net->init_weight();
+  };
+
+  // each process sees inputs of its own offset
+  const size_t ranks = 2, samples = 8;
+  std::vector<std::vector<vec_t>> in(ranks), t(ranks);
+  for (size_t r = 0; r < ranks; r++) {
+    for (size_t i = 0; i < samples; i++) {
+      vec_t x(6), y(3);
+      uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+      for (auto &v : x) v += float_t(2 * r);
+      uniform_rand(y.begin(), y.end(), 0.0, 1.0);
+      in[r].push_back(x);
+      t[r].push_back(y);
+    }
+  }
+
+  std::vector<network<sequential>> nets(ranks);
+  for (size_t r = 0; r < ranks; r++) make_net(&nets[r]);
+  std::vector<std::vector<vec_t>> epochs(ranks);
+
+  run_ring(loopback_ring(ranks, 13), [&](communicator &comm) {
+    size_t r = comm.rank();
+    nets[r].set_communicator(std::shared_ptr<communicator>(
+      &comm, [](communicator *) {}));
+    adagrad opt;
+    nets[r].fit<mse>(opt, in[r], t[r], 4, 2, [] {},
+                     [&] { epochs[r].push_back(nets[r][1]->statistics()); });
+  });
+
+  // every epoch ends with the same statistics on every process
+  ASSERT_EQ(epochs[0].size(), 2u);
+  ASSERT_EQ(epochs[1].size(), 2u);
+  for (size_t e = 0; e < 2; e++) {
+    ASSERT_EQ(epochs[0][e].size(), 16u);
+    for (size_t i = 0; i < 16; i++) {
+      EXPECT_EQ(epochs[0][e][i], epochs[1][e][i]);
+    }
+  }
+}
+#endif  // !defined(_WIN32)
+
 TEST(network, train_predict_different_batches) {
   auto batch_sizes = {2, 7, 11, 16};
   size_t data_size = std::accumulate(batch_sizes.begin(), batch_sizes.end(), 1,
@@ -316,6 +591,231 @@ TEST(network, train_predict_different_batches) {
   }
 }
 
+TEST(network, pipelined_predict) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 1, 4) << relu_layer()
+      << max_pooling_layer(6, 6, 4, 2) << fully_connected_layer(36, 16)
+      << tanh_layer() << fully_connected_layer(16, 3) << softmax_layer();
+  net.init_weight();
+
+  std::vector<tensor_t> in(23, tensor_t{vec_t(64)});
+  for (auto &sample : in) {
+    uniform_rand(sample[0].begin(), sample[0].end(), -1.0, 1.0);
+  }
+  auto expected = net.predict(in);
+
+  // make sure there are enough threads for several stages
+  thread_pool_size_scope pool(4);
+
+  // the last micro-batch is ragged (23 = 5 * 4 + 3)
+  net.set_pipeline_micro_batch(4);
+  EXPECT_EQ(net.pipeline_micro_batch(), 4u);
+  auto actual = net.predict(in);
+
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t j = 0; j < expected[i][0].size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][0][j], actual[i][0][j]);
+    }
+  }
+
+  // the network stays usable for regular forward passes
+  net.set_pipeline_micro_batch(0);
+  auto again = net.predict(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_EQ(again[i][0], expected[i][0]);
+  }
+}
+
+TEST(network, pipelined_predict_in_place) {
+  network<sequential> net;
+  for (int i = 0; i < 6; i++) {
+    net << fully_connected_layer(64, 64) << relu_layer();
+  }
+  net << fully_connected_layer(64, 4);
+  net.init_weight();
+
+  std::vector<tensor_t> in(15, tensor_t{vec_t(64)});
+  for (auto &sample : in) {
+    uniform_rand(sample[0].begin(), sample[0].end(), -1.0, 1.0);
+  }
+  auto expected = net.predict(in);
+
+  // the relu layers overwrite the outputs of the fully connected layers
+  net.freeze();
+
+  thread_pool_size_scope pool(4);
+
+  net.set_pipeline_micro_batch(2);
+  std::vector<std::vector<tensor_t>> actual;
+  std::vector<const tensor_t *> buffers;
+  for (int run = 0; run < 5; run++) {
+    actual.push_back(net.predict(in));
+
+    // the stages are wired once: only the relu layers ending a stage stop
+    // running in place, and the buffers stay the same from call to call
+    size_t in_place = 0;
+    for (size_t l = 1; l < net.depth(); l += 2) {
+      in_place += net[l]->outputs()[0]->get_data() ==
+                  net[l]->inputs()[0]->get_data();
+    }
+    EXPECT_GE(in_place, 3u);
+    std::vector<const tensor_t *> current;
+    for (size_t l = 0; l < net.depth(); l++) {
+      current.push_back(net[l]->outputs()[0]->get_data());
+    }
+    if (run > 0) EXPECT_TRUE(current == buffers);
+    buffers = current;
+  }
+
+  EXPECT_TRUE(net.in_place_activations());
+  for (const auto &outputs : actual) {
+    ASSERT_EQ(outputs.size(), expected.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < expected[i][0].size(); j++) {
+        EXPECT_FLOAT_EQ(expected[i][0][j], outputs[i][0][j]);
+      }
+    }
+  }
+
+  // and still do in the regular forward passes
+  net.set_pipeline_micro_batch(0);
+  auto again = net.predict(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_EQ(again[i][0], expected[i][0]);
+  }
+}
+
+TEST(network, concurrent_predict_with_context) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 1, 4, padding::same) << relu_layer()
+      << max_pooling_layer(8, 8, 4, 2) << fully_connected_layer(64, 16)
+      << tanh_layer() << fully_connected_layer(16, 3) << softmax_layer();
+  net.init_weight();
+
+  std::vector<vec_t> in(32, vec_t(64));
+  for (auto &sample : in) {
+    uniform_rand(sample.begin(), sample.end(), -1.0, 1.0);
+  }
+  std::vector<vec_t> expected;
+  for (auto &sample : in) expected.push_back(net.predict(sample));
+
+  // every thread runs on the same network with its own context
+  const size_t nthreads = 4;
+  std::vector<std::vector<vec_t>> actual(nthreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++) {
+    threads.emplace_back([&, t] {
+      execution_context ctx;
+      for (int iter = 0; iter < 5; iter++) {
+        actual[t].clear();
+        for (auto &sample : in) actual[t].push_back(net.predict(ctx, sample));
+      }
+    });
+  }
+  for (auto &th : threads) th.join();
+
+  for (size_t t = 0; t < nthreads; t++) {
+    ASSERT_EQ(actual[t].size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      for (size_t j = 0; j < expected[i].size(); j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], actual[t][i][j]);
+      }
+    }
+  }
+
+  // batches go through a context as well
+  execution_context ctx;
+  std::vector<tensor_t> batch;
+  for (auto &sample : in) batch.push_back(tensor_t{sample});
+  auto batched = net.predict(ctx, batch);
+  ASSERT_EQ(batched.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (size_t j = 0; j < expected[i].size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][j], batched[i][0][j]);
+    }
+  }
+}
+
+TEST(network, predict_async) {
+  network<sequential> net;
+  net << fully_connected_layer(10, 20) << tanh_layer()
+      << fully_connected_layer(20, 4) << softmax_layer();
+  net.init_weight();
+
+  std::vector<vec_t> in(16, vec_t(10));
+  for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+
+  std::atomic<int> callbacks(0);
+  std::vector<std::future<vec_t>> results;
+  for (auto &sample : in) {
+    results.push_back(
+      net.predict_async(sample, [&](const vec_t &out, std::exception_ptr e) {
+        if (!e && out.size() == 4) callbacks++;
+      }));
+  }
+
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t actual   = results[i].get();
+    vec_t expected = net.predict(in[i]);
+    for (size_t j = 0; j < expected.size(); j++) {
+      EXPECT_FLOAT_EQ(expected[j], actual[j]);
+    }
+  }
+  // the callback runs before the future becomes ready
+  EXPECT_EQ(callbacks.load(), 16);
+
+  auto multi = net.predict_async(tensor_t{in[0]}).get();
+  ASSERT_EQ(multi.size(), 1u);
+  EXPECT_FLOAT_EQ(multi[0][0], net.predict(in[0])[0]);
+
+  EXPECT_THROW(net.predict_async(vec_t(3)), nn_error);
+}
+
+TEST(network, predict_with_context_beside_plain_predict) {
+  network<sequential> net;
+  net << fully_connected_layer(16, 32) << relu_layer()
+      << max_pooling_layer(4, 4, 2, 2) << fully_connected_layer(8, 4);
+  net.init_weight();
+
+  std::vector<vec_t> in(8, vec_t(16));
+  for (auto &sample : in) {
+    uniform_rand(sample.begin(), sample.end(), -1.0, 1.0);
+  }
+  std::vector<vec_t> expected;
+  for (auto &sample : in) expected.push_back(net.predict(sample));
+
+  // a context runs batches of another size than the network's edges
+  // without resizing them, while plain predict keeps using them
+  std::vector<tensor_t> batch;
+  for (auto &sample : in) batch.push_back(tensor_t{sample});
+  std::vector<std::vector<vec_t>> plain(4);
+  std::thread context_thread([&] {
+    execution_context ctx;
+    for (int iter = 0; iter < 20; iter++) {
+      auto batched = net.predict(ctx, batch);
+      for (size_t i = 0; i < expected.size(); i++) {
+        for (size_t j = 0; j < expected[i].size(); j++) {
+          EXPECT_FLOAT_EQ(expected[i][j], batched[i][0][j]);
+        }
+      }
+    }
+  });
+  for (auto &outputs : plain) {
+    for (auto &sample : in) outputs.push_back(net.predict(sample));
+  }
+  context_thread.join();
+
+  for (auto &outputs : plain) {
+    for (size_t i = 0; i < expected.size(); i++) {
+      for (size_t j = 0; j < expected[i].size(); j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], outputs[i][j]);
+      }
+    }
+  }
+  EXPECT_EQ(net[2]->outputs()[0]->get_data()->size(), 1u);
+}
+
 TEST(network, set_netphase) {
   // TODO(nyanp): add unit-test for public api
 }
@@ -721,4 +1221,216 @@ TEST(network, trainable) {
   EXPECT_NE(w4, w4_after_update);
 }
 
+TEST(network, freeze) {
+  network<sequential> net;
+  net << convolutional_layer(6, 6, 3, 1, 2, padding::same) << relu_layer()
+      << dropout_layer(72, 0.5) << fully_connected_layer(72, 3);
+  adagrad opt;
+
+  std::vector<vec_t> in(4, vec_t(36));
+  std::vector<vec_t> t(4, vec_t(3));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+  net.fit<mse>(opt, in, t, 2, 1);
+  net.set_in_place_activations(true);
+
+  std::vector<vec_t> expected;
+  for (auto &x : in) expected.push_back(net.predict(x));
+
+  net.freeze(&opt);
+  EXPECT_TRUE(net.frozen());
+  EXPECT_TRUE(net.memory_planning());
+  for (auto &x : in) net.predict(x);
+  for (size_t l = 0; l < net.depth(); l++) {
+    for (auto &e : net[l]->inputs()) EXPECT_TRUE(e->get_gradient()->empty());
+    for (auto &e : net[l]->outputs()) EXPECT_TRUE(e->get_gradient()->empty());
+  }
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t actual = net.predict(in[i]);
+    for (size_t j = 0; j < actual.size(); j++) {
+      EXPECT_FLOAT_EQ(actual[j], expected[i][j]);
+    }
+  }
+  EXPECT_THROW(net.fit<mse>(opt, in, t, 2, 1), nn_error);
+
+  net.unfreeze();
+  EXPECT_FALSE(net.frozen());
+  // the settings from before freeze() come back
+  EXPECT_TRUE(net.in_place_activations());
+  EXPECT_FALSE(net.memory_planning());
+  net.fit<mse>(opt, in, t, 2, 1);
+}
+
+TEST(network, freeze_then_add) {
+  network<sequential> net;
+  net << fully_connected_layer(4, 3) << relu_layer();
+  net.freeze();
+  net << fully_connected_layer(3, 2);
+  EXPECT_TRUE(net.frozen());
+  for (size_t l = 0; l < net.depth(); l++) {
+    EXPECT_TRUE(net[l]->inference_only());
+  }
+
+  net.predict(vec_t(4, float_t(1)));
+  for (auto &e : net[2]->outputs()) EXPECT_TRUE(e->get_gradient()->empty());
+  net.unfreeze();
+  EXPECT_FALSE(net.frozen());
+  EXPECT_FALSE(net[2]->inference_only());
+}
+
+TEST(network, channel_blocking) {
+  const size_t b = kernels::channel_block;
+  network<sequential> net;
+  net << convolutional_layer(10, 10, 3, 3, 2 * b, padding::same)
+      << relu_layer() << max_pooling_layer(10, 10, 2 * b, 2)
+      << convolutional_layer(5, 5, 3, 2 * b, b, padding::same) << tanh_layer()
+      << fully_connected_layer(25 * b, 3) << softmax_layer();
+
+  std::vector<vec_t> in(4, vec_t(300));
+  std::vector<vec_t> t(4, vec_t(3));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+  net.init_weight();
+  std::vector<vec_t> expected;
+  for (auto &x : in) expected.push_back(net.predict(x));
+
+  // the layers stay planar until they never run backward
+  net.set_channel_blocking(true);
+  EXPECT_TRUE(net.channel_blocking());
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t actual = net.predict(in[i]);
+    for (size_t j = 0; j < actual.size(); j++) {
+      EXPECT_FLOAT_EQ(actual[j], expected[i][j]);
+    }
+  }
+
+  net.freeze();
+  for (size_t i = 0; i < in.size(); i++) {
+    vec_t actual = net.predict(in[i]);
+    for (size_t j = 0; j < actual.size(); j++) {
+      EXPECT_NEAR(actual[j], expected[i][j], 1e-5);
+    }
+  }
+  execution_context ctx;
+  std::vector<tensor_t> batch;
+  for (auto &x : in) batch.push_back(tensor_t{x});
+  for (auto &out : {net.predict(batch), net.predict(ctx, batch)}) {
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < out[i][0].size(); j++) {
+        EXPECT_NEAR(out[i][0][j], expected[i][j], 1e-5);
+      }
+    }
+  }
+
+  net.unfreeze();
+  adagrad opt;
+  net.fit<mse>(opt, in, t, 2, 1);
+}
+
+TEST(network, fit_reads_samples_in_place) {
+  std::vector<vec_t> in(5, vec_t(3));
+  std::vector<vec_t> t(5, vec_t(2));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+
+  sample_view view(in);
+  EXPECT_EQ(view.slice(1, 3).size(), 3u);
+  EXPECT_EQ(&view.slice(1, 3).at(2), &in[3]);
+
+  network<sequential> expected, actual;
+  expected << fully_connected_layer(3, 4) << tanh_layer()
+           << fully_connected_layer(4, 2);
+  actual << fully_connected_layer(3, 4) << tanh_layer()
+         << fully_connected_layer(4, 2);
+  set_random_seed(5);
+  expected.init_weight();
+  set_random_seed(5);
+  actual.init_weight();
+
+  // the last minibatch holds the fifth sample only
+  gradient_descent opt_expected, opt_actual;
+  sample_view targets(t);
+  for (size_t first = 0; first < in.size(); first += 2) {
+    size_t size = std::min<size_t>(2, in.size() - first);
+    expected.bprop<mse>(expected.fprop(view.slice(first, size)),
+                        targets.slice(first, size), sample_view());
+    expected.update_weights(&opt_expected);
+  }
+  actual.fit<mse>(opt_actual, in, t, 2, 1);
+
+  for (size_t l = 0; l < expected.depth(); l++) {
+    auto w1 = expected[l]->weights();
+    auto w2 = actual[l]->weights();
+    for (size_t i = 0; i < w1.size(); i++) {
+      for (size_t j = 0; j < w1[i]->size(); j++) {
+        EXPECT_FLOAT_EQ((*w1[i])[j], (*w2[i])[j]);
+      }
+    }
+  }
+}
+
+TEST(network, in_place_activations) {
+  auto build = [](network<sequential> &net) {
+    net << fully_connected_layer(6, 8) << relu_layer()
+        << fully_connected_layer(8, 8) << tanh_layer() << sigmoid_layer()
+        << fully_connected_layer(8, 3) << elu_layer();
+    set_random_seed(3);
+    net.init_weight();
+  };
+  network<sequential> expected, actual;
+  build(expected);
+  build(actual);
+  actual.set_in_place_activations(true);
+
+  std::vector<vec_t> in(6, vec_t(6)), t(6, vec_t(3));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), 0.0, 1.0);
+  }
+  actual.fprop(sample_view(in));
+  auto data = [&](size_t l) { return actual[l]->outputs()[0]->get_data(); };
+  EXPECT_EQ(data(0), data(1));
+  EXPECT_EQ(data(2), data(3));
+  // tanh needs its output for its own gradient
+  EXPECT_NE(data(3), data(4));
+  EXPECT_EQ(data(5), data(6));
+
+  adagrad opt_expected, opt_actual;
+  expected.fit<mse>(opt_expected, in, t, 2, 2);
+  actual.fit<mse>(opt_actual, in, t, 2, 2);
+  for (size_t l = 0; l < expected.depth(); l++) {
+    auto w1 = expected[l]->weights();
+    auto w2 = actual[l]->weights();
+    for (size_t i = 0; i < w1.size(); i++) {
+      for (size_t j = 0; j < w1[i]->size(); j++) {
+        EXPECT_FLOAT_EQ((*w1[i])[j], (*w2[i])[j]);
+      }
+    }
+  }
+
+  // with checkpointing and, for inference, memory planning
+  actual.set_checkpointing(true);
+  actual.set_checkpoint(2, false);
+  EXPECT_FALSE(actual.is_checkpoint(3));
+  expected.fit<mse>(opt_expected, in, t, 3, 1);
+  actual.fit<mse>(opt_actual, in, t, 3, 1);
+  actual.set_memory_planning(true);
+  actual.set_netphase(net_phase::test);
+  for (auto &x : in) {
+    vec_t y1 = expected.predict(x);
+    vec_t y2 = actual.predict(x);
+    for (size_t j = 0; j < y1.size(); j++) EXPECT_NEAR(y1[j], y2[j], 1e-5);
+  }
+
+  actual.set_in_place_activations(false);
+  actual.fprop(sample_view(in));
+  EXPECT_NE(data(0), data(1));
+}
+
 }  // namespace tiny_dnn
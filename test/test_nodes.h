@@ -58,6 +58,32 @@ TEST(nodes, graph_branch) {
   EXPECT_FLOAT_EQ(static_cast<float_t>(res[2]), static_cast<float_t>(0.0));
 }
 
+TEST(nodes, graph_branch_with_context) {
+  auto in1   = std::make_shared<input_layer>(shape3d(3, 1, 1));
+  auto in2   = std::make_shared<input_layer>(shape3d(3, 1, 1));
+  auto added = std::make_shared<layers::add>(2, 3);
+  auto out   = std::make_shared<relu>(3);
+
+  (in1, in2) << added;
+  added << out;
+
+  network<graph> net;
+  construct_graph(net, {in1, in2}, {out});
+
+  execution_context ctx;
+  auto res = net.predict(ctx, tensor_t{{2, 4, 3}, {-1, 2, -5}});
+  ASSERT_EQ(res.size(), 1u);
+  EXPECT_FLOAT_EQ(res[0][0], float_t(1.0));
+  EXPECT_FLOAT_EQ(res[0][1], float_t(6.0));
+  EXPECT_FLOAT_EQ(res[0][2], float_t(0.0));
+
+  // the context can be reused
+  res = net.predict(ctx, tensor_t{{1, 1, 1}, {1, -2, 3}});
+  EXPECT_FLOAT_EQ(res[0][0], float_t(2.0));
+  EXPECT_FLOAT_EQ(res[0][1], float_t(0.0));
+  EXPECT_FLOAT_EQ(res[0][2], float_t(4.0));
+}
+
 TEST(nodes, graph_branch2) {
   // declare nodes
   input_layer in1(shape3d(3, 1, 1));
@@ -80,4 +106,67 @@ TEST(nodes, graph_branch2) {
   EXPECT_FLOAT_EQ(static_cast<float_t>(res[2]), static_cast<float_t>(0.0));
 }
 
+// three branches share the input edge and are merged by concat
+static void run_inception_like_graph(std::vector<vec_t> *outputs,
+                                     std::vector<vec_t> *weights) {
+  auto in  = std::make_shared<input_layer>(shape3d(6, 1, 1));
+  auto b1  = std::make_shared<fully_connected_layer>(6, 4);
+  auto b2  = std::make_shared<fully_connected_layer>(6, 4);
+  auto b3  = std::make_shared<fully_connected_layer>(6, 4);
+  auto t1  = std::make_shared<tanh_layer>(4);
+  auto cat = std::make_shared<concat_layer>(3, 4);
+  auto out = std::make_shared<fully_connected_layer>(12, 2);
+
+  in << b1 << t1;
+  in << b2;
+  in << b3;
+  (t1, b2, b3) << cat;
+  cat << out;
+
+  network<graph> net;
+  construct_graph(net, {in}, {out});
+  set_random_seed(3);
+  net.init_weight();
+
+  vec_t x{0.1, -0.2, 0.3, 0.5, -0.7, 0.2};
+  outputs->push_back(net.predict(x));
+
+  gradient_descent opt;
+  std::vector<vec_t> data{x}, target{{0.5, -0.5}};
+  net.fit<mse>(opt, data, target, 1, 3);
+  outputs->push_back(net.predict(x));
+
+  for (auto l : {b1, b2, b3, out}) {
+    for (auto w : l->weights()) weights->push_back(*w);
+  }
+}
+
+TEST(nodes, graph_concurrent_branches) {
+  std::vector<vec_t> serial_out, serial_w;
+  std::vector<vec_t> concurrent_out, concurrent_w;
+
+  {
+    thread_budget_scope scope(1);
+    run_inception_like_graph(&serial_out, &serial_w);
+  }
+  {
+    // batch size 1 on 4 threads runs the three branches concurrently
+    thread_pool_size_scope pool(4);
+    run_inception_like_graph(&concurrent_out, &concurrent_w);
+  }
+
+  ASSERT_EQ(serial_out.size(), concurrent_out.size());
+  for (size_t i = 0; i < serial_out.size(); i++) {
+    for (size_t j = 0; j < serial_out[i].size(); j++) {
+      EXPECT_NEAR(serial_out[i][j], concurrent_out[i][j], 1e-5);
+    }
+  }
+  ASSERT_EQ(serial_w.size(), concurrent_w.size());
+  for (size_t i = 0; i < serial_w.size(); i++) {
+    for (size_t j = 0; j < serial_w[i].size(); j++) {
+      EXPECT_NEAR(serial_w[i][j], concurrent_w[i][j], 1e-5);
+    }
+  }
+}
+
 }  // namespace tiny_dnn
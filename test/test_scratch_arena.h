@@ -0,0 +1,150 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/util/scratch_arena.h"
+
+namespace tiny_dnn {
+
+TEST(scratch_arena, nested_scopes) {
+  scratch_arena &arena = scratch_arena::local();
+  EXPECT_FALSE(arena.active());
+  EXPECT_TRUE(scratch_allocator<float_t>().block() == nullptr);
+
+  {
+    scratch_scope outer;
+    vec_t a(100, float_t(1), scratch_allocator<float_t>());
+    const size_t used = arena.block()->used();
+    {
+      scratch_scope inner;
+      vec_t b(100, float_t(2), scratch_allocator<float_t>());
+      EXPECT_GE(arena.block()->used(), used + 100 * sizeof(float_t));
+    }
+    // the inner scope gives back b only
+    EXPECT_EQ(arena.block()->used(), used);
+    EXPECT_FLOAT_EQ(a[99], float_t(1));
+  }
+  // grown to the peak of both scopes
+  EXPECT_FALSE(arena.active());
+  EXPECT_GE(arena.capacity(), 2 * 100 * sizeof(float_t));
+  EXPECT_EQ(arena.block()->used(), 0u);
+
+  // the same amount fits in the arena from now on
+  const size_t allocations = aligned_allocation_count();
+  {
+    scratch_scope scope;
+    vec_t a(100, float_t(0), scratch_allocator<float_t>());
+    vec_t b(100, float_t(0), scratch_allocator<float_t>());
+    EXPECT_TRUE(arena.block()->owns(&a[0]));
+    EXPECT_TRUE(arena.block()->owns(&b[0]));
+
+    // copies go to the heap, and may leave the scope
+    vec_t copy(a);
+    EXPECT_FALSE(arena.block()->owns(&copy[0]));
+  }
+  EXPECT_EQ(aligned_allocation_count() - allocations, 1u);
+}
+
+TEST(scratch_arena, predict_results_outlive_the_scope) {
+  network<sequential> net;
+  net << fully_connected_layer(8, 16) << tanh_layer()
+      << fully_connected_layer(16, 4);
+
+  std::vector<tensor_t> in(3, tensor_t{vec_t(8)});
+  for (auto &x : in) uniform_rand(x[0].begin(), x[0].end(), -1.0, 1.0);
+
+  std::vector<tensor_t> out = net.predict(in);
+  // falls back to a plain forward pass, the batch fits in one micro-batch
+  net.set_pipeline_micro_batch(4);
+  std::vector<tensor_t> pipelined = net.predict(in);
+
+  scratch_arena &arena = scratch_arena::local();
+  EXPECT_FALSE(arena.active());
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_FALSE(arena.block()->owns(&out[i][0][0]));
+    EXPECT_FALSE(arena.block()->owns(&pipelined[i][0][0]));
+    for (size_t j = 0; j < out[i][0].size(); j++) {
+      EXPECT_FLOAT_EQ(out[i][0][j], pipelined[i][0][j]);
+    }
+  }
+}
+
+// the aligned allocations (tensor memory) of each minibatch of fit
+static std::vector<size_t> allocations_per_batch(network<sequential> &net) {
+  std::vector<vec_t> in(16, vec_t(64)), t(16, vec_t(3));
+  for (auto &x : in) uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  for (auto &x : t) uniform_rand(x.begin(), x.end(), 0.0, 1.0);
+
+  std::vector<size_t> allocations;
+  size_t last = aligned_allocation_count();
+  adagrad opt;
+  net.fit<cross_entropy_multiclass>(
+    opt, in, t, 4, 2,
+    [&] {
+      allocations.push_back(aligned_allocation_count() - last);
+      last = aligned_allocation_count();
+    },
+    [] {});
+  return allocations;
+}
+
+static void make_steady_state_net(network<sequential> &net) {
+  net << convolutional_layer(8, 8, 3, 1, 4, padding::same)
+      << batch_normalization_layer(64, 4) << relu_layer()
+      << max_pooling_layer(8, 8, 4, 2) << fully_connected_layer(64, 16)
+      << tanh_layer() << dropout_layer(16, 0.3)
+      << fully_connected_layer(16, 3) << softmax_layer();
+}
+
+TEST(scratch_arena, no_allocation_in_steady_state) {
+  // the first batches set up the buffers of the layers and the arenas,
+  // then the tensors of a step come from them. the outer vectors of the
+  // tensors (std::allocator) are not counted, see the How-Tos
+  {
+    network<sequential> net;
+    make_steady_state_net(net);
+    // every layer on this thread, whose arena then covers the whole step
+    net.set_num_threads(1);
+    std::vector<size_t> allocations = allocations_per_batch(net);
+    ASSERT_EQ(allocations.size(), 8u);
+    for (size_t i = 2; i < allocations.size(); i++) {
+      EXPECT_EQ(allocations[i], 0u);
+    }
+  }
+  {
+    // the workers of the pool draw from arenas of their own
+    thread_pool_size_scope pool(4);
+    network<sequential> net;
+    make_steady_state_net(net);
+    std::vector<size_t> allocations = allocations_per_batch(net);
+    ASSERT_EQ(allocations.size(), 8u);
+    for (size_t i = 2; i < allocations.size(); i++) {
+      EXPECT_EQ(allocations[i], 0u);
+    }
+  }
+}
+
+TEST(scratch_arena, predict_allocates_its_outputs) {
+  thread_pool_size_scope pool(4);
+  network<sequential> net;
+  make_steady_state_net(net);
+  std::vector<tensor_t> in(8, tensor_t{vec_t(64)});
+  for (auto &x : in) uniform_rand(x[0].begin(), x[0].end(), -1.0, 1.0);
+
+  net.predict(in);
+  net.predict(in);
+  // the returned outputs leave the arena, one vector per sample
+  const size_t allocations = aligned_allocation_count();
+  std::vector<tensor_t> out = net.predict(in);
+  EXPECT_EQ(aligned_allocation_count() - allocations, in.size());
+  EXPECT_EQ(out.size(), in.size());
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,109 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace tiny_dnn {
+
+// tracks how many threads execute a loop body at the same time
+class concurrency_probe {
+ public:
+  concurrency_probe() : active_(0), peak_(0) {}
+
+  void enter() {
+    size_t now  = ++active_;
+    size_t peak = peak_.load();
+    while (now > peak && !peak_.compare_exchange_weak(peak, now)) {
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    --active_;
+  }
+
+  size_t peak() const { return peak_.load(); }
+
+ private:
+  std::atomic<size_t> active_;
+  std::atomic<size_t> peak_;
+};
+
+TEST(thread_budget, scope_limits_for_i) {
+  concurrency_probe probe;
+  {
+    thread_budget_scope scope(2);
+    EXPECT_LE(get_num_threads(), 2u);
+    for_i(true, 64, [&](size_t) { probe.enter(); }, 1);
+  }
+  EXPECT_LE(probe.peak(), 2u);
+  EXPECT_EQ(thread_budget(), 0u);
+}
+
+TEST(thread_budget, budget_of_one_runs_on_caller) {
+  const auto caller = std::this_thread::get_id();
+  std::atomic<int> foreign(0);
+
+  set_num_threads(1);
+  for_i(100, [&](size_t) {
+    if (std::this_thread::get_id() != caller) foreign++;
+  });
+  set_num_threads(0);
+
+  EXPECT_EQ(foreign.load(), 0);
+}
+
+TEST(thread_budget, inner_scope_cannot_raise_budget) {
+  thread_budget_scope outer(2);
+  {
+    thread_budget_scope inner(8);
+    EXPECT_EQ(thread_budget(), 2u);
+  }
+  {
+    thread_budget_scope inner(1);
+    EXPECT_EQ(thread_budget(), 1u);
+  }
+  EXPECT_EQ(thread_budget(), 2u);
+}
+
+TEST(thread_budget, nested_for_i_stays_within_budget) {
+  concurrency_probe probe;
+  {
+    thread_budget_scope scope(3);
+    for_i(true, 8,
+          [&](size_t) { for_i(true, 16, [&](size_t) { probe.enter(); }, 1); },
+          1);
+  }
+  EXPECT_LE(probe.peak(), 3u);
+}
+
+TEST(thread_budget, network_budget) {
+  network<sequential> net;
+  net << fully_connected_layer(10, 20) << tanh_layer()
+      << fully_connected_layer(20, 5);
+
+  std::vector<tensor_t> in(16, tensor_t{vec_t(10)});
+  for (auto &sample : in) uniform_rand(sample[0].begin(), sample[0].end(), -1, 1);
+
+  net.init_weight();
+  auto expected = net.predict(in);
+
+  net.set_num_threads(1);
+  EXPECT_EQ(net.num_threads(), 1u);
+  auto actual = net.predict(in);
+
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t j = 0; j < expected[i][0].size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][0][j], actual[i][0][j]);
+    }
+  }
+}
+
+}  // namespace tiny_dnn
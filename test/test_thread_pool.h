@@ -0,0 +1,157 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace tiny_dnn {
+
+TEST(thread_pool, for_i_visits_every_index_once) {
+  for (size_t size : {size_t(0), size_t(1), size_t(7), size_t(1000)}) {
+    std::vector<std::atomic<int>> visited(size);
+    for (auto &v : visited) v = 0;
+
+    for_i(size, [&](size_t i) { visited[i]++; });
+
+    for (size_t i = 0; i < size; i++) {
+      EXPECT_EQ(visited[i].load(), 1);
+    }
+  }
+}
+
+TEST(thread_pool, nested_for_i) {
+  const size_t outer = 16, inner = 64;
+  std::vector<std::atomic<int>> visited(outer * inner);
+  for (auto &v : visited) v = 0;
+
+  for_i(outer, [&](size_t i) {
+    for_i(inner, [&](size_t j) { visited[i * inner + j]++; });
+  });
+
+  for (auto &v : visited) {
+    EXPECT_EQ(v.load(), 1);
+  }
+}
+
+#if !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+
+TEST(thread_pool, run_executes_all_tasks) {
+  thread_pool pool(4);
+  EXPECT_EQ(pool.num_threads(), 4u);
+
+  std::vector<std::atomic<int>> visited(100);
+  for (auto &v : visited) v = 0;
+
+  // back-to-back jobs reuse the same parked workers
+  for (int iter = 0; iter < 50; iter++) {
+    pool.run(visited.size(), [&](size_t task) { visited[task]++; });
+  }
+
+  for (auto &v : visited) {
+    EXPECT_EQ(v.load(), 50);
+  }
+}
+
+TEST(thread_pool, run_propagates_exception) {
+  thread_pool pool(3);
+  std::atomic<int> executed(0);
+
+  EXPECT_THROW(pool.run(10,
+                        [&](size_t task) {
+                          executed++;
+                          if (task == 5) throw nn_error("task failed");
+                        }),
+               nn_error);
+
+  // the pool stays usable after a failed job
+  executed = 0;
+  pool.run(10, [&](size_t) { executed++; });
+  EXPECT_EQ(executed.load(), 10);
+}
+
+TEST(thread_pool, resize) {
+  thread_pool pool(1);
+  EXPECT_EQ(pool.num_threads(), 1u);
+
+  pool.resize(3);
+  EXPECT_EQ(pool.num_threads(), 3u);
+
+  std::atomic<int> executed(0);
+  pool.run(30, [&](size_t) { executed++; });
+  EXPECT_EQ(executed.load(), 30);
+
+  pool.resize(0);  // clamped to the calling thread only
+  EXPECT_EQ(pool.num_threads(), 1u);
+}
+
+TEST(thread_pool, affinity_maps_tasks_statically) {
+  thread_pool pool(3);
+  pool.set_affinity(true);
+  EXPECT_TRUE(pool.affinity());
+  EXPECT_EQ(pool.num_threads(), 3u);
+
+  std::vector<std::thread::id> first(9), second(9);
+  pool.run(9, [&](size_t task) { first[task] = std::this_thread::get_id(); });
+  pool.run(9, [&](size_t task) { second[task] = std::this_thread::get_id(); });
+
+  for (size_t i = 0; i < 9; i++) {
+    // task i always runs on thread i % 3, the caller taking thread 0
+    EXPECT_EQ(first[i], second[i]);
+    EXPECT_EQ(first[i], first[i % 3]);
+    EXPECT_EQ(first[i] == std::this_thread::get_id(), i % 3 == 0);
+  }
+
+  pool.set_affinity(false);
+  EXPECT_FALSE(pool.affinity());
+}
+
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_GCD) && \
+  !defined(CNN_USE_WORK_STEALING)
+
+TEST(thread_pool, topology_aware_forward) {
+  network<sequential> net;
+  net << fully_connected_layer(8, 16) << relu_layer()
+      << fully_connected_layer(16, 4);
+  net.init_weight();
+
+  std::vector<tensor_t> small(2, tensor_t{vec_t(8)});
+  std::vector<tensor_t> large(30, tensor_t{vec_t(8)});
+  for (size_t i = 0; i < large.size(); i++) {
+    for (size_t j = 0; j < 8; j++) large[i][0][j] = float_t(i + j) / 10;
+  }
+  net.predict(small);
+  auto expected = net.predict(large);
+  net.predict(small);
+
+  thread_pool &pool = thread_pool::instance();
+  size_t nthreads   = pool.num_threads();
+  pool.resize(3);
+  pool.set_affinity(true);
+  EXPECT_TRUE(topology_aware());
+
+  // growing the batch allocates the new samples on the worker threads
+  auto actual = net.predict(large);
+
+  pool.set_affinity(false);
+  pool.resize(nthreads);
+
+  for (size_t i = 0; i < large.size(); i++) {
+    for (size_t j = 0; j < expected[i][0].size(); j++) {
+      EXPECT_FLOAT_EQ(expected[i][0][j], actual[i][0][j]);
+    }
+  }
+}
+
+#endif
+
+#endif  // !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
+
+}  // namespace tiny_dnn
@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "tiny_dnn/util/work_stealing_scheduler.h"
+
+namespace tiny_dnn {
+
+TEST(work_stealing_scheduler, honors_grainsize) {
+  work_stealing_scheduler sched(4);
+  EXPECT_EQ(sched.num_threads(), 4u);
+
+  const size_t size = 1000, grain = 16;
+  std::vector<std::atomic<int>> visited(size);
+  for (auto &v : visited) v = 0;
+  std::atomic<size_t> chunks(0);
+  std::atomic<bool> oversized(false);
+
+  sched.parallel_for(0, size, grain, [&](size_t begin, size_t end) {
+    if (end - begin > grain || begin >= end) oversized = true;
+    for (size_t i = begin; i < end; i++) visited[i]++;
+    chunks++;
+  });
+
+  EXPECT_FALSE(oversized.load());
+  EXPECT_GE(chunks.load(), (size + grain - 1) / grain);
+  for (auto &v : visited) {
+    EXPECT_EQ(v.load(), 1);
+  }
+}
+
+TEST(work_stealing_scheduler, nested) {
+  work_stealing_scheduler sched(4);
+  const size_t outer = 32, inner = 100;
+  std::vector<std::atomic<int>> visited(outer * inner);
+  for (auto &v : visited) v = 0;
+
+  sched.parallel_for(0, outer, 1, [&](size_t ob, size_t oe) {
+    for (size_t i = ob; i < oe; i++) {
+      sched.parallel_for(0, inner, 8, [&](size_t ib, size_t ie) {
+        for (size_t j = ib; j < ie; j++) visited[i * inner + j]++;
+      });
+    }
+  });
+
+  for (auto &v : visited) {
+    EXPECT_EQ(v.load(), 1);
+  }
+}
+
+TEST(work_stealing_scheduler, concurrent_callers) {
+  work_stealing_scheduler sched(3);
+  const size_t ncallers = 4, size = 500;
+  std::vector<std::atomic<int>> visited(ncallers * size);
+  for (auto &v : visited) v = 0;
+
+  std::vector<std::thread> callers;
+  for (size_t c = 0; c < ncallers; c++) {
+    callers.emplace_back([&, c] {
+      for (int iter = 0; iter < 10; iter++) {
+        sched.parallel_for(0, size, 4, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) visited[c * size + i]++;
+        });
+      }
+    });
+  }
+  for (auto &t : callers) t.join();
+
+  for (auto &v : visited) {
+    EXPECT_EQ(v.load(), 10);
+  }
+}
+
+TEST(work_stealing_scheduler, propagates_exception) {
+  work_stealing_scheduler sched(3);
+  std::atomic<size_t> executed(0);
+
+  EXPECT_THROW(sched.parallel_for(0, 100, 1,
+                                  [&](size_t begin, size_t end) {
+                                    executed += end - begin;
+                                    if (begin == 42) throw nn_error("failed");
+                                  }),
+               nn_error);
+  // the remaining chunks still run before the exception is rethrown
+  EXPECT_EQ(executed.load(), 100u);
+
+  executed = 0;
+  sched.parallel_for(0, 100, 1,
+                     [&](size_t begin, size_t end) { executed += end - begin; });
+  EXPECT_EQ(executed.load(), 100u);
+}
+
+}  // namespace tiny_dnn
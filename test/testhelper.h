@@ -284,4 +284,81 @@ inline std::shared_ptr<layer> json_to_layer(const std::string &src) {
 }
 #endif
 
+/**
+ * the parameters of a k x k convolution with bias of a w x h x in_channels
+ * input into out_channels, padded as convolutional_layer pads it.
+ **/
+inline core::conv_params make_conv_params(size_t w,
+                                          size_t h,
+                                          size_t in_channels,
+                                          size_t k,
+                                          size_t out_channels,
+                                          size_t stride   = 1,
+                                          size_t dilation = 1,
+                                          padding pad     = padding::valid) {
+  const size_t extent = (k - 1) * dilation + 1;
+  const size_t pw     = pad == padding::same ? w + extent - 1 : w;
+  const size_t ph     = pad == padding::same ? h + extent - 1 : h;
+  core::conv_params params;
+  params.in        = shape3d(w, h, in_channels);
+  params.in_padded = shape3d(pw, ph, in_channels);
+  params.out       = shape3d((pw - extent) / stride + 1,
+                       (ph - extent) / stride + 1, out_channels);
+  params.weight     = shape3d(k, k, in_channels * out_channels);
+  params.has_bias   = true;
+  params.pad_type   = pad;
+  params.w_stride   = stride;
+  params.h_stride   = stride;
+  params.w_dilation = dilation;
+  params.h_dilation = dilation;
+  return params;
+}
+
+/**
+ * expects every element of the two tensors to be within abs_error
+ **/
+inline void expect_tensor_near(const tensor_t &expected,
+                               const tensor_t &actual,
+                               float_t abs_error) {
+  EXPECT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (size_t j = 0; j < expected[i].size(); j++) {
+      EXPECT_NEAR(expected[i][j], actual[i][j], abs_error);
+    }
+  }
+}
+
+/**
+ * resizes the default thread pool to the given number of workers until the
+ * end of the scope, so that the parallel paths run concurrently on machines
+ * with fewer cores. the other threading backends are left as they are.
+ **/
+class thread_pool_size_scope {
+ public:
+  explicit thread_pool_size_scope(size_t num_threads) {
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && \
+  !defined(CNN_USE_GCD) && !defined(CNN_USE_WORK_STEALING) &&   \
+  !defined(CNN_SINGLE_THREAD)
+    previous_ = thread_pool::instance().num_threads();
+    thread_pool::instance().resize(num_threads);
+#else
+    CNN_UNREFERENCED_PARAMETER(num_threads);
+#endif
+  }
+
+  ~thread_pool_size_scope() {
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && \
+  !defined(CNN_USE_GCD) && !defined(CNN_USE_WORK_STEALING) &&   \
+  !defined(CNN_SINGLE_THREAD)
+    thread_pool::instance().resize(previous_);
+#endif
+  }
+
+  thread_pool_size_scope(const thread_pool_size_scope &) = delete;
+  thread_pool_size_scope &operator=(const thread_pool_size_scope &) = delete;
+
+ private:
+  size_t previous_ = 0;
+};
+
 }  // namespace tiny_dnn
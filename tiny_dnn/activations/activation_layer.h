@@ -71,6 +71,10 @@ class activation_layer : public layer {
     this->in_shape_ = in_shape;
   }
 
+  bool reentrant_forward() const override { return true; }
+
+  bool elementwise() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &x = *in_data[0];
@@ -37,6 +37,9 @@ class elu_layer : public activation_layer {
 
   std::string layer_type() const override { return "elu-activation"; }
 
+  // the gradient only depends on y
+  bool can_run_in_place() const override { return true; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     for (size_t j = 0; j < x.size(); j++) {
       y[j] =
@@ -70,6 +70,9 @@ class leaky_relu_layer : public activation_layer {
 
   std::string layer_type() const override { return "leaky-relu-activation"; }
 
+  // the gradient only depends on y
+  bool can_run_in_place() const override { return true; }
+
   float_t epsilon_value() const { return epsilon_; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
@@ -22,6 +22,9 @@ class relu_layer : public activation_layer {
 
   std::string layer_type() const override { return "relu-activation"; }
 
+  // the gradient only depends on y
+  bool can_run_in_place() const override { return true; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     for (size_t j = 0; j < x.size(); j++) {
       y[j] = std::max(float_t(0), x[j]);
@@ -21,6 +21,9 @@ class sigmoid_layer : public activation_layer {
 
   std::string layer_type() const override { return "sigmoid-activation"; }
 
+  // the gradient only depends on y
+  bool can_run_in_place() const override { return true; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     for (size_t j = 0; j < x.size(); j++) {
       y[j] = float_t(1) / (float_t(1) + std::exp(-x[j]));
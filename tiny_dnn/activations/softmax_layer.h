@@ -21,6 +21,9 @@ class softmax_layer : public activation_layer {
 
   std::string layer_type() const override { return "softmax-activation"; }
 
+  // normalizes over all the values of a sample
+  bool elementwise() const override { return false; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     const float_t alpha = *std::max_element(x.begin(), x.end());
     float_t denominator(0);
@@ -39,12 +42,10 @@ class softmax_layer : public activation_layer {
                            const vec_t &dy) override {
     const size_t len = dy.size();
 
-// auxilliary vector to store element wise softmax gradients of all elements
-
-#if HAS_CXX11_THREAD_LOCAL
-    thread_local
-#endif
-      vec_t df(len, 0);
+    // auxilliary vector to store element wise softmax gradients of all
+    // elements
+    scratch_scope scratch;
+    vec_t df(len, float_t(0), scratch_allocator<float_t>());
     for (size_t j = 0; j < x.size(); j++) {
       for (size_t k = 0; k < x.size(); k++) {
         df[k] = (k == j) ? y[j] * (float_t(1) - y[j]) : -y[k] * y[j];
@@ -77,6 +77,9 @@ class softplus_layer : public activation_layer {
 
   std::string layer_type() const override { return "softplus-activation"; }
 
+  // the gradient only depends on y
+  bool can_run_in_place() const override { return true; }
+
   float_t beta_value() const { return beta_; }
 
   float_t threshold_value() const { return threshold_; }
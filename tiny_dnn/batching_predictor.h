@@ -0,0 +1,278 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <future>  // NOLINT
+#include <iterator>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/execution_context.h"
+#include "tiny_dnn/network.h"
+
+namespace tiny_dnn {
+
+/**
+ * counters of a batching_predictor
+ **/
+struct batching_stats {
+  /** number of samples predicted */
+  size_t num_requests = 0;
+  /** number of batched forward passes */
+  size_t num_batches = 0;
+  /** size of the largest batch */
+  size_t largest_batch = 0;
+  /** time the requests spent in the queue, summed over all requests */
+  std::chrono::microseconds total_wait{0};
+  /** longest time a request spent in the queue */
+  std::chrono::microseconds max_wait{0};
+  /** time spent in the forward passes, summed over all batches */
+  std::chrono::microseconds total_compute{0};
+
+  double average_batch_size() const {
+    return num_batches ? double(num_requests) / num_batches : 0.0;
+  }
+
+  std::chrono::microseconds average_wait() const {
+    if (num_requests == 0) return std::chrono::microseconds(0);
+    return std::chrono::microseconds(total_wait.count() / num_requests);
+  }
+
+  std::chrono::microseconds average_compute() const {
+    if (num_batches == 0) return std::chrono::microseconds(0);
+    return std::chrono::microseconds(total_compute.count() / num_batches);
+  }
+};
+
+/**
+ * coalesces single-sample predictions of concurrent callers into batches.
+ *
+ * Every submitted sample is queued and a future is returned. A scheduler
+ * thread runs one batched forward pass as soon as max_batch_size samples
+ * are waiting, or when the oldest one has waited for max_delay, whichever
+ * comes first. A larger batch size gives more throughput, a shorter delay
+ * bounds the latency added by the queue at low load.
+ *
+ *     batching_predictor<sequential> server(net, 32,
+ *                                           std::chrono::milliseconds(2));
+ *
+ *     // from any number of threads
+ *     std::future<vec_t> y = server.submit(x);
+ *     use(y.get());
+ *
+ * The forward passes use their own execution_context, so other threads may
+ * keep calling net.predict(ctx, ...) meanwhile. The network must outlive
+ * the predictor and must not be trained while it is running. Only networks
+ * with a single input are supported.
+ **/
+template <typename NetType>
+class batching_predictor {
+ public:
+  typedef std::chrono::steady_clock clock;
+
+  /**
+   * @param net            network to run, shared with the caller
+   * @param max_batch_size largest number of samples per forward pass
+   * @param max_delay      longest time a sample waits for a batch to fill
+   **/
+  explicit batching_predictor(
+    network<NetType> &net,
+    size_t max_batch_size              = 32,
+    std::chrono::microseconds max_delay = std::chrono::microseconds(1000))
+    : net_(net),
+      max_batch_size_(max_batch_size),
+      max_delay_(max_delay),
+      stop_(false) {
+    if (max_batch_size == 0) {
+      throw nn_error("max_batch_size must be positive");
+    }
+    scheduler_ = std::thread([this] { schedule(); });
+  }
+
+  /**
+   * samples still queued are predicted before the predictor is destroyed
+   **/
+  ~batching_predictor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    scheduler_.join();
+  }
+
+  batching_predictor(const batching_predictor &) = delete;
+  batching_predictor &operator=(const batching_predictor &) = delete;
+
+  /**
+   * queue one sample and return the future output of the network
+   **/
+  std::future<vec_t> submit(const vec_t &in) {
+    if (in.size() != net_.in_data_size()) data_mismatch(*net_[0], in);
+
+    request r;
+    r.input    = in;
+    r.enqueued = clock::now();
+    std::future<vec_t> result = r.output.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) throw nn_error("batching_predictor is shutting down");
+      queue_.push_back(std::move(r));
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+  /**
+   * submit and wait for the result
+   **/
+  vec_t predict(const vec_t &in) { return submit(in).get(); }
+
+  void set_max_batch_size(size_t max_batch_size) {
+    if (max_batch_size == 0) {
+      throw nn_error("max_batch_size must be positive");
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      max_batch_size_ = max_batch_size;
+    }
+    cv_.notify_one();
+  }
+
+  size_t max_batch_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_batch_size_;
+  }
+
+  void set_max_delay(std::chrono::microseconds max_delay) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      max_delay_ = max_delay;
+    }
+    cv_.notify_one();
+  }
+
+  std::chrono::microseconds max_delay() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_delay_;
+  }
+
+  /**
+   * number of samples waiting for a batch
+   **/
+  size_t queue_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+  batching_stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  void reset_stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = batching_stats();
+  }
+
+ private:
+  struct request {
+    vec_t input;
+    std::promise<vec_t> output;
+    clock::time_point enqueued;
+  };
+
+  void schedule() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // stopped, and nothing left to do
+
+      // wait for the batch to fill up, at most until the oldest request
+      // is due. the deadline is re-read since max_delay may change.
+      while (!stop_ && queue_.size() < max_batch_size_) {
+        auto deadline = queue_.front().enqueued + max_delay_;
+        if (clock::now() >= deadline) break;
+        cv_.wait_until(lock, deadline);
+      }
+
+      size_t n = std::min(queue_.size(), max_batch_size_);
+      std::vector<request> batch(std::make_move_iterator(queue_.begin()),
+                                 std::make_move_iterator(queue_.begin() + n));
+      queue_.erase(queue_.begin(), queue_.begin() + n);
+
+      lock.unlock();
+      auto start = clock::now();
+      std::exception_ptr error;
+      std::vector<tensor_t> out = run(batch, &error);
+      auto compute = clock::now() - start;
+      lock.lock();
+
+      // account for the batch before any caller can observe its result
+      stats_.num_requests += n;
+      stats_.num_batches++;
+      stats_.largest_batch = std::max(stats_.largest_batch, n);
+      stats_.total_compute +=
+        std::chrono::duration_cast<std::chrono::microseconds>(compute);
+      for (auto &r : batch) {
+        auto wait =
+          std::chrono::duration_cast<std::chrono::microseconds>(start -
+                                                                r.enqueued);
+        stats_.total_wait += wait;
+        stats_.max_wait = std::max(stats_.max_wait, wait);
+      }
+
+      lock.unlock();
+      for (size_t i = 0; i < n; i++) {
+        if (error) {
+          batch[i].output.set_exception(error);
+        } else {
+          batch[i].output.set_value(std::move(out[i][0]));
+        }
+      }
+      lock.lock();
+    }
+  }
+
+  std::vector<tensor_t> run(std::vector<request> &batch,
+                            std::exception_ptr *error) {
+    std::vector<tensor_t> in(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      in[i].push_back(std::move(batch[i].input));
+    }
+
+    try {
+      return net_.predict(ctx_, in);
+    } catch (...) {
+      *error = std::current_exception();
+      return std::vector<tensor_t>();
+    }
+  }
+
+  network<NetType> &net_;
+  execution_context ctx_;  // used by the scheduler thread only
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<request> queue_;
+  size_t max_batch_size_;
+  std::chrono::microseconds max_delay_;
+  bool stop_;
+  batching_stats stats_;
+
+  std::thread scheduler_;
+};
+
+}  // namespace tiny_dnn
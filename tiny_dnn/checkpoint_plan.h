@@ -0,0 +1,198 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * choice of the activations kept between the forward and the backward pass
+ * of training (gradient checkpointing).
+ *
+ * The layers, in the order they run, are cut into segments each ending
+ * with a checkpoint layer. The outputs of the checkpoints are kept; those
+ * of the other layers are released as soon as their last reader has run,
+ * and recomputed one segment at a time during backward, from the outputs
+ * of the previous checkpoint. With a checkpoint every sqrt(N) layers, a
+ * chain of N layers keeps O(sqrt(N)) activations for one more forward
+ * pass.
+ *
+ * Some layers are always checkpoints: the outputs of the network, layers
+ * which are not recomputable(), the last layer, and layers whose outputs
+ * are read beyond their own segment (skip connections) or from outside of
+ * the network.
+ * Layers running in place share the checkpoint status of the layer whose
+ * outputs they overwrite.
+ **/
+class checkpoint_plan {
+ public:
+  checkpoint_plan() : built_(false) {}
+
+  /**
+   * @param order     layers in the order they run
+   * @param outputs   layers whose outputs are read after the forward pass
+   * @param overrides checkpoint (true) or not (false) by index in order,
+   *                  instead of the automatic choice
+   **/
+  void build(const std::vector<layer *> &order,
+             const std::vector<layer *> &outputs,
+             const std::unordered_map<size_t, bool> &overrides) {
+    clear();
+    order_ = order;
+    const size_t n = order.size();
+
+    std::unordered_map<const node *, size_t> step;
+    for (size_t i = 0; i < n; i++) step[order[i]] = i;
+
+    // layers running in place write to the data of an earlier layer, which
+    // owns it for the whole group
+    group_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      group_[i] = i;
+      for (auto &e : order[i]->outputs()) {
+        if (!e->data_owner()) continue;
+        auto it = step.find(e->data_owner()->prev());
+        if (it != step.end()) group_[i] = group_[it->second];
+      }
+    }
+
+    // last step reading the outputs of each layer, n if read from outside
+    std::vector<size_t> last_use(n);
+    const size_t every = std::max<size_t>(
+      1, static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(n)))));
+    keep_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      auto o    = overrides.find(i);
+      keep_[i]  = o != overrides.end() ? o->second : (i + 1) % every == 0;
+      keep_[i]  = keep_[i] || !order[i]->recomputable() || i + 1 == n ||
+                 std::find(outputs.begin(), outputs.end(), order[i]) !=
+                   outputs.end();
+      last_use[i] = i;
+      for (auto &e : order[i]->outputs()) {
+        for (auto c : e->next()) {
+          auto it     = step.find(c);
+          last_use[i] = std::max(last_use[i], it == step.end() ? n : it->second);
+        }
+      }
+      last_use[group_[i]] = std::max(last_use[group_[i]], last_use[i]);
+    }
+    for (size_t i = 0; i < n; i++) last_use[i] = last_use[group_[i]];
+
+    // a layer read after the end of its segment becomes a checkpoint, which
+    // shortens the segments before it: repeat until nothing changes
+    for (bool changed = true; changed;) {
+      changed = false;
+      // a group is kept or recomputed as a whole
+      for (size_t i = 0; i < n; i++) {
+        if (keep_[i] != keep_[group_[i]]) {
+          keep_[i] = keep_[group_[i]] = true;
+          changed                     = true;
+        }
+      }
+      size_t end = n;
+      for (size_t i = n; i-- > 0;) {
+        if (keep_[i]) {
+          end = i;
+        } else if (last_use[i] > end) {
+          keep_[i] = true;
+          end      = i;
+          changed  = true;
+        }
+      }
+    }
+
+    release_at_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      if (!keep_[i] && group_[i] == i) release_at_[last_use[i]].push_back(i);
+    }
+    released_.assign(n, false);
+    built_ = true;
+  }
+
+  void clear() {
+    order_.clear();
+    group_.clear();
+    keep_.clear();
+    release_at_.clear();
+    released_.clear();
+    built_ = false;
+  }
+
+  bool built() const { return built_; }
+
+  /**
+   * true if the outputs of the given layer (index in order) are kept
+   **/
+  bool is_checkpoint(size_t step) const { return keep_[step]; }
+
+  /**
+   * release the outputs nobody reads once the given step has run forward.
+   * those of the last segment are read back first, so they stay.
+   **/
+  void forwarded(size_t step) {
+    const size_t last_segment = segment_begin(order_.size() - 1);
+    for (size_t i : release_at_[step]) {
+      if (i < last_segment) release(i);
+    }
+  }
+
+  /**
+   * backward pass over every layer, last to first, recomputing the
+   * released outputs of each segment before going through it
+   **/
+  void backward(const std::function<void(layer *)> &on_backward) {
+    size_t end = order_.size();
+    while (end > 0) {
+      const size_t first = segment_begin(end - 1);
+
+      for (size_t i = first; i < end; i++) {
+        if (!released_[i]) continue;
+        order_[i]->forward();
+        released_[i] = false;
+      }
+      for (size_t i = end; i-- > first;) {
+        order_[i]->backward();
+        if (on_backward) on_backward(order_[i]);
+      }
+      for (size_t i = first; i < end; i++) {
+        if (!keep_[i] && group_[i] == i) release(i);
+      }
+      end = first;
+    }
+  }
+
+ private:
+  // first step of the segment the given step belongs to
+  size_t segment_begin(size_t step) const {
+    while (step > 0 && !keep_[step - 1]) step--;
+    return step;
+  }
+
+  void release(size_t i) {
+    for (auto &e : order_[i]->outputs()) tensor_t().swap(*e->get_data());
+    for (size_t j = i; j < order_.size(); j++) {
+      if (group_[j] == i) released_[j] = true;
+    }
+  }
+
+  bool built_;
+  std::vector<layer *> order_;
+  std::vector<size_t> group_;  // first layer of the data written by each
+  std::vector<bool> keep_;
+  std::vector<std::vector<size_t>> release_at_;  // by the step reading last
+  std::vector<bool> released_;
+};
+
+}  // namespace tiny_dnn
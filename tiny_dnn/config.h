@@ -35,6 +35,11 @@
  */
 // #define CNN_USE_GCD
 
+/**
+ * define to enable the built-in work-stealing scheduler
+ */
+// #define CNN_USE_WORK_STEALING
+
 /**
  * define to use exceptions
  */
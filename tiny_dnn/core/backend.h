@@ -27,7 +27,16 @@ namespace core {
 // TODO(edgar): remove this
 class context;
 
-enum class backend_t { internal, nnpack, libdnn, avx, opencl, cblas };
+enum class backend_t {
+  internal,
+  nnpack,
+  libdnn,
+  avx,
+  opencl,
+  cblas,
+  gemm,
+  fft
+};
 
 inline std::ostream &operator<<(std::ostream &os, backend_t type) {
   switch (type) {
@@ -37,6 +46,8 @@ inline std::ostream &operator<<(std::ostream &os, backend_t type) {
     case backend_t::avx: os << "AVX"; break;
     case backend_t::opencl: os << "OpenCL"; break;
     case backend_t::cblas: os << "CBLAS"; break;
+    case backend_t::gemm: os << "GEMM"; break;
+    case backend_t::fft: os << "FFT"; break;
     default: throw nn_error("Not supported ostream enum."); break;
   }
   return os;
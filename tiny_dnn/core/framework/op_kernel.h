@@ -55,6 +55,9 @@ class OpKernelContext {
     bool parallelize = false;
 
     backend_t engine = default_engine();
+
+    // version of the weights of the layer (see layer::weights_version)
+    size_t weights_version = 0;
   };
 
   OpKernelContext()
@@ -117,6 +120,12 @@ class OpKernelContext {
 
   void setEngine(const backend_t engine) { op_params_->engine = engine; }
 
+  size_t weightsVersion() const { return op_params_->weights_version; }
+
+  void setWeightsVersion(const size_t version) {
+    op_params_->weights_version = version;
+  }
+
  private:
   std::vector<tensor_t *> *in_data_;
   std::vector<tensor_t *> *out_data_;
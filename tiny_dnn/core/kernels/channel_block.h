@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "tiny_dnn/util/product.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * the number of channels interleaved by the channel-blocked layout, one
+ * SIMD register: 8 with AVX (NCHW8c), 4 with SSE (NCHW4c). the channels
+ * are not blocked without SIMD.
+ *
+ * in the blocked layout, channel c of pixel (x, y) is stored at
+ * ((c / channel_block) * height + y) * width + x) * channel_block +
+ * c % channel_block, so that the same pixel of channel_block consecutive
+ * channels fills one register.
+ **/
+static const size_t channel_block = vectorize::CNN_VECTORIZE_TYPE::unroll_size;
+
+/**
+ * true if a tensor of the shape can be stored in the blocked layout
+ **/
+inline bool channel_blockable(const shape3d &shape) {
+  return channel_block > 1 && shape.depth_ % channel_block == 0;
+}
+
+/**
+ * where the values of one channel are, in either layout: the value of
+ * (x, y) is at data[offset + y * row + x * column]. the next channel of
+ * the same block is lane floats further.
+ **/
+struct channel_view {
+  channel_view(const shape3d &shape, bool blocked)
+    : column(blocked ? channel_block : 1),
+      row(shape.width_ * column),
+      lane(blocked ? 1 : shape.width_ * shape.height_),
+      block_(shape.width_ * shape.height_ * channel_block) {}
+
+  size_t offset(size_t c) const {
+    return c / channel_block * block_ + c % channel_block * lane;
+  }
+
+  size_t column;
+  size_t row;
+  size_t lane;
+
+ private:
+  size_t block_;
+};
+
+/**
+ * dst = src, converted from the planar to the blocked layout
+ **/
+inline void to_channel_blocked(const vec_t &src,
+                               const shape3d &shape,
+                               vec_t &dst) {
+  const channel_view view(shape, true);
+  dst.resize(shape.size());
+  for (size_t c = 0; c < shape.depth_; c++) {
+    const float_t *p = &src[shape.get_index(0, 0, c)];
+    for (size_t y = 0; y < shape.height_; y++) {
+      for (size_t x = 0; x < shape.width_; x++) {
+        dst[view.offset(c) + y * view.row + x * view.column] = *p++;
+      }
+    }
+  }
+}
+
+/**
+ * dst = src, converted from the blocked to the planar layout
+ **/
+inline void from_channel_blocked(const vec_t &src,
+                                 const shape3d &shape,
+                                 vec_t &dst) {
+  const channel_view view(shape, true);
+  dst.resize(shape.size());
+  for (size_t c = 0; c < shape.depth_; c++) {
+    float_t *p = &dst[shape.get_index(0, 0, c)];
+    for (size_t y = 0; y < shape.height_; y++) {
+      for (size_t x = 0; x < shape.width_; x++) {
+        *p++ = src[view.offset(c) + y * view.row + x * view.column];
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -10,6 +10,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/conv2d_grad_op_avx.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 
 namespace tiny_dnn {
@@ -38,7 +39,14 @@ class Conv2dGradOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
-    if (engine == core::backend_t::internal) {
+    // the fft engine has no backward pass of its own
+    const bool lowered = engine == core::backend_t::internal ||
+                         engine == core::backend_t::gemm ||
+                         engine == core::backend_t::fft;
+    if (lowered && kernels::conv2d_gemm_eligible(params)) {
+      kernels::conv2d_op_gemm(prev_out, W[0], dW, db, curr_delta, prev_delta,
+                              params, context.parallelize());
+    } else if (lowered) {
       kernels::conv2d_op_internal(prev_out, W[0], dW, db, curr_delta,
                                   prev_delta, params, context.parallelize());
     } else if (engine == core::backend_t::avx) {
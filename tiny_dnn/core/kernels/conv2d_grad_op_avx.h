@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
@@ -893,6 +894,11 @@ inline void conv2d_grad_op_avx(const tensor_t &prev_out,
   }
 #endif
 
+  if (conv2d_gemm_eligible(params)) {
+    conv2d_op_gemm(prev_out, W, dW, db, curr_delta, prev_delta, params,
+                   layer_parallelize);
+    return;
+  }
   conv2d_op_internal(prev_out, W, dW, db, curr_delta, prev_delta, params,
                      layer_parallelize);
 }
@@ -10,8 +10,12 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/conv2d_op_avx.h"
+#include "tiny_dnn/core/kernels/conv2d_op_blocked.h"
+#include "tiny_dnn/core/kernels/conv2d_op_fft.h"
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/kernels/conv2d_op_nnpack.h"
+#include "tiny_dnn/core/kernels/conv2d_op_winograd.h"
 
 namespace tiny_dnn {
 
@@ -36,8 +40,39 @@ class Conv2dOp : public core::OpKernel {
     // on the selected engine type
 
     const core::backend_t engine = context.engine();
+    const size_t weights_version = context.weightsVersion();
 
-    if (engine == core::backend_t::internal) {
+    // only the blocked kernel reads and writes the channel-blocked layout
+    // (see layer::set_channel_blocking). otherwise, the internal and avx
+    // engines switch to winograd for 3x3 filters
+    // and to fft for large ones when the layer has enough channels. the
+    // internal engine lowers to gemm whenever the convolution allows it,
+    // and so does the fft engine for the convolutions it cannot compute.
+    const bool automatic = engine == core::backend_t::internal ||
+                           engine == core::backend_t::avx;
+    if (params.blocked_input || params.blocked_output) {
+      kernels::conv2d_op_blocked(in_data, W[0], bias[0], out_data, params,
+                                 blocked_filter_, weights_version,
+                                 context.parallelize());
+    } else if (automatic && kernels::conv2d_winograd_preferred(params)) {
+      kernels::conv2d_op_winograd(in_data, W[0], bias[0], out_data, params,
+                                  winograd_filter_, weights_version,
+                                  context.parallelize());
+    } else if ((automatic && kernels::conv2d_fft_preferred(params)) ||
+               (engine == core::backend_t::fft &&
+                kernels::conv2d_fft_eligible(params))) {
+      kernels::conv2d_op_fft(in_data, W[0], bias[0], out_data, params,
+                             fft_filter_, weights_version,
+                             context.parallelize());
+    } else if ((engine == core::backend_t::internal ||
+                engine == core::backend_t::gemm ||
+                engine == core::backend_t::fft) &&
+               kernels::conv2d_gemm_eligible(params)) {
+      kernels::conv2d_op_gemm(in_data, W[0], bias[0], out_data, params,
+                              context.parallelize());
+    } else if (engine == core::backend_t::internal ||
+               engine == core::backend_t::gemm ||
+               engine == core::backend_t::fft) {
       kernels::conv2d_op_internal(in_data, W[0], bias[0], out_data, params,
                                   context.parallelize());
     } else if (engine == core::backend_t::nnpack) {
@@ -49,6 +84,12 @@ class Conv2dOp : public core::OpKernel {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
   }
+
+ private:
+  // the transformed weights, reused until they change
+  kernels::conv2d_winograd_filter winograd_filter_;
+  kernels::conv2d_fft_filter fft_filter_;
+  kernels::conv2d_blocked_filter blocked_filter_;
 };
 
 }  // namespace tiny_dnn
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
@@ -464,6 +465,10 @@ inline void conv2d_op_avx(const tensor_t &in_data,
     return;
   }
 #endif
+  if (conv2d_gemm_eligible(params)) {
+    conv2d_op_gemm(in_data, W, bias, out_data, params, layer_parallelize);
+    return;
+  }
   conv2d_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
 }
 
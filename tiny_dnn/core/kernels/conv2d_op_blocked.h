@@ -0,0 +1,338 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include "tiny_dnn/core/kernels/channel_block.h"
+#include "tiny_dnn/core/kernels/conv2d_op_fft.h"
+#include "tiny_dnn/core/kernels/conv2d_op_winograd.h"
+#include "tiny_dnn/core/kernels/weight_transform_cache.h"
+#include "tiny_dnn/core/params/conv_params.h"
+#include "tiny_dnn/util/scratch_arena.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+namespace blocked_detail {
+
+typedef vectorize::CNN_VECTORIZE_TYPE simd;
+typedef simd::register_type simd_register;
+
+// output pixels computed together, one accumulator each
+static const size_t register_block = 6;
+
+// the weights of each block of channel_block output channels, for each
+// block of (up to) channel_block input channels starting at i0: the weight
+// (kx, ky) between input channel i0 + j and output channel ob + lane is at
+// Wb[ob * id * kh * kw + i0 * kh * kw + ((ky * kw + kx) * count + j) *
+// channel_block + lane]
+inline void pack_filter(const vec_t &W,
+                        const core::conv_params &params,
+                        vec_t &Wb) {
+  const size_t id = params.in.depth_;
+  const size_t od = params.out.depth_;
+  const size_t kw = params.weight.width_;
+  const size_t kh = params.weight.height_;
+  Wb.resize(od * id * kh * kw);
+
+  float_t *dst = &Wb[0];
+  for (size_t ob = 0; ob < od; ob += channel_block) {
+    for (size_t i0 = 0; i0 < id; i0 += channel_block) {
+      const size_t count = std::min(channel_block, id - i0);
+      for (size_t ky = 0; ky < kh; ky++) {
+        for (size_t kx = 0; kx < kw; kx++) {
+          for (size_t j = 0; j < count; j++) {
+            for (size_t lane = 0; lane < channel_block; lane++) {
+              *dst++ = W[params.weight.get_index(kx, ky,
+                                                 id * (ob + lane) + i0 + j)];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// a[r][b] += the products of Count input channels, lane apart from p, and
+// their weights w, for R output pixels step apart and OB output channel
+// blocks ldw apart
+template <size_t R, size_t OB, size_t Count>
+CNN_MUST_INLINE void madd_channels(const float_t *p,
+                                   size_t lane,
+                                   size_t step,
+                                   const float_t *w,
+                                   size_t ldw,
+                                   size_t count,
+                                   simd_register (&a)[R][OB]) {
+  const size_t n = Count ? Count : count;
+  for (size_t j = 0; j < n; j++, p += lane, w += channel_block) {
+    simd_register wv[OB];
+    for (size_t b = 0; b < OB; b++) {
+      wv[b] = simd::load<std::true_type>(w + b * ldw);
+    }
+    for (size_t r = 0; r < R; r++) {
+      const simd_register x = simd::set1(p[r * step]);
+      for (size_t b = 0; b < OB; b++) {
+        a[r][b] = simd::madd(x, wv[b], a[r][b]);
+      }
+    }
+  }
+}
+
+// adds the products of the input channels [i0, i1) with their weights to
+// the accumulators of R output pixels, starting at in, in each of OB
+// output channel blocks (lda floats apart in acc, ldw in w). i0 is a
+// multiple of channel_block.
+template <size_t R, size_t OB>
+void accumulate(const float_t *in,
+                const channel_view &src,
+                const float_t *w,
+                size_t ldw,
+                const core::conv_params &params,
+                size_t i0,
+                size_t i1,
+                float_t *acc,
+                size_t lda) {
+  const size_t kw    = params.weight.width_;
+  const size_t kh    = params.weight.height_;
+  const size_t dx    = params.w_dilation * src.column;
+  const size_t dy    = params.h_dilation * src.row;
+  const size_t step  = params.w_stride * src.column;
+  const size_t block = channel_block;
+
+  simd_register a[R][OB];
+  for (size_t r = 0; r < R; r++) {
+    for (size_t b = 0; b < OB; b++) {
+      a[r][b] = simd::load<std::true_type>(acc + b * lda + r * block);
+    }
+  }
+  w += i0 * kh * kw * block;
+  for (size_t ib = i0; ib < i1; ib += block) {
+    const float_t *pin = in + src.offset(ib);
+    const size_t count = std::min(block, i1 - ib);
+    for (size_t ky = 0; ky < kh; ky++) {
+      const float_t *pwin = pin + ky * dy;
+      for (size_t kx = 0; kx < kw; kx++, w += count * block) {
+        const float_t *p = pwin + kx * dx;
+        if (count == block) {
+          madd_channels<R, OB, block>(p, src.lane, step, w, ldw, count, a);
+        } else {
+          madd_channels<R, OB, 0>(p, src.lane, step, w, ldw, count, a);
+        }
+      }
+    }
+  }
+  for (size_t r = 0; r < R; r++) {
+    for (size_t b = 0; b < OB; b++) {
+      simd::store<std::true_type>(acc + b * lda + r * block, a[r][b]);
+    }
+  }
+}
+
+// one row of the output in OB channel blocks starting at block ob
+template <size_t OB>
+void conv2d_blocked_row(const float_t *in,
+                        const float_t *Wb,
+                        const vec_t &bias,
+                        float_t *out,
+                        const core::conv_params &params,
+                        const channel_view &src,
+                        const channel_view &dst,
+                        size_t ob,
+                        size_t oy) {
+  const size_t block = channel_block;
+  const size_t id    = params.in.depth_;
+  const size_t ow    = params.out.width_;
+  const size_t ldw   = id * params.weight.width_ * params.weight.height_ *
+                     block;
+  const size_t lda = ow * block;
+
+  // the weights of a chunk of input channels stay in L1 for the whole row
+  const size_t chunk = std::max(
+    block, size_t(16384) / (ldw / id * OB * sizeof(float_t)) / block * block);
+
+  scratch_scope scratch;
+  vec_t acc(OB * lda, float_t(0), scratch_allocator<float_t>());
+  if (params.has_bias) {
+    for (size_t b = 0; b < OB; b++) {
+      const float_t *pb = &bias[(ob + b) * block];
+      for (size_t ox = 0; ox < ow; ox++) {
+        std::copy(pb, pb + block, &acc[b * lda + ox * block]);
+      }
+    }
+  }
+
+  in += oy * params.h_stride * src.row;
+  const float_t *w  = Wb + ob * ldw;
+  const size_t step = params.w_stride * src.column;
+  for (size_t i0 = 0; i0 < id; i0 += chunk) {
+    const size_t i1 = std::min(id, i0 + chunk);
+    size_t ox       = 0;
+    for (; ox + register_block <= ow; ox += register_block) {
+      accumulate<register_block, OB>(in + ox * step, src, w, ldw, params, i0,
+                                     i1, &acc[ox * block], lda);
+    }
+    for (; ox < ow; ox++) {
+      accumulate<1, OB>(in + ox * step, src, w, ldw, params, i0, i1,
+                        &acc[ox * block], lda);
+    }
+  }
+
+  for (size_t b = 0; b < OB; b++) {
+    const float_t *pacc = &acc[b * lda];
+    const size_t c      = (ob + b) * block;
+    if (params.blocked_output) {
+      std::copy(pacc, pacc + lda, out + dst.offset(c) + oy * dst.row);
+      continue;
+    }
+    for (size_t lane = 0; lane < block; lane++) {
+      float_t *pout = out + dst.offset(c + lane) + oy * dst.row;
+      for (size_t ox = 0; ox < ow; ox++) {
+        pout[ox] = pacc[ox * block + lane];
+      }
+    }
+  }
+}
+
+}  // namespace blocked_detail
+
+/**
+ * true if conv2d_op_blocked computes the convolution: the output channels
+ * (and the input channels, if blocked) must fill whole blocks, and there
+ * must be no connection table.
+ **/
+inline bool conv2d_blocked_eligible(const core::conv_params &params) {
+  return channel_blockable(params.out) &&
+         (!params.blocked_input || channel_blockable(params.in)) &&
+         params.tbl.is_empty();
+}
+
+/**
+ * true if the convolution runs faster in the blocked layout than with
+ * the planar kernels. Winograd keeps the lead on 3x3 filters from 32
+ * input channels on, as soon as a batch gives its products enough tiles,
+ * and fft on large filters.
+ **/
+inline bool conv2d_blocked_preferred(const core::conv_params &params) {
+  return conv2d_blocked_eligible(params) &&
+         !(conv2d_winograd_preferred(params) && params.in.depth_ >= 32) &&
+         !conv2d_fft_preferred(params);
+}
+
+/**
+ * the filters of a layer packed for conv2d_op_blocked, packed again only
+ * when the weights change
+ **/
+class conv2d_blocked_filter {
+ public:
+  std::shared_ptr<const vec_t> get(const vec_t &W,
+                                   size_t weights_version,
+                                   const core::conv_params &params) {
+    return packed_.get(W, weights_version, [&](const vec_t &w, vec_t &Wb) {
+      blocked_detail::pack_filter(w, params, Wb);
+    });
+  }
+
+ private:
+  weight_transform_cache packed_;
+};
+
+/**
+ * direct convolution keeping channel_block output channels in each SIMD
+ * register. reads the (padded) input in the blocked layout if
+ * params.blocked_input, and writes the output in the blocked layout if
+ * params.blocked_output, the planar layout otherwise: a reorder at the
+ * border of a blocked part of the network costs nothing more.
+ **/
+inline void conv2d_op_blocked(const tensor_t &in_data,
+                              const vec_t &W,
+                              const vec_t &bias,
+                              tensor_t &out_data,
+                              const core::conv_params &params,
+                              conv2d_blocked_filter &filter,
+                              const size_t weights_version,
+                              const bool parallelize) {
+  if (!conv2d_blocked_eligible(params)) {
+    throw nn_error("the convolution can not be computed in blocks");
+  }
+  const size_t blocks = params.out.depth_ / channel_block;
+  const size_t oh     = params.out.height_;
+
+  const channel_view src(params.in_padded, params.blocked_input);
+  const channel_view dst(params.out, params.blocked_output);
+  const std::shared_ptr<const vec_t> Wb =
+    filter.get(W, weights_version, params);
+
+  // pairs of output channel blocks, the last one alone if their number is
+  // odd
+  const size_t pairs = (blocks + 1) / 2;
+  const size_t rows  = in_data.size() * pairs * oh;
+  for_i(parallelize, rows, [&](size_t task) {
+    const size_t sample = task / (pairs * oh);
+    const size_t ob     = task / oh % pairs * 2;
+    const size_t oy     = task % oh;
+    const float_t *in   = &in_data[sample][0];
+    float_t *out        = &out_data[sample][0];
+    if (ob + 1 < blocks) {
+      blocked_detail::conv2d_blocked_row<2>(in, &(*Wb)[0], bias, out, params,
+                                            src, dst, ob, oy);
+    } else {
+      blocked_detail::conv2d_blocked_row<1>(in, &(*Wb)[0], bias, out, params,
+                                            src, dst, ob, oy);
+    }
+  });
+}
+
+/**
+ * out = in with the padding of params.in_padded around each channel, both
+ * in the blocked layout
+ **/
+inline void conv2d_pad_blocked_input(const tensor_t &in,
+                                     const core::conv_params &params,
+                                     tensor_t &out) {
+  if (params.pad_type == padding::valid) {
+    return;
+  }
+  const size_t block  = channel_block;
+  const size_t iw     = params.in.width_;
+  const size_t ih     = params.in.height_;
+  const size_t pw     = params.in_padded.width_;
+  const size_t ph     = params.in_padded.height_;
+  const size_t left   = params.weight.width_ / 2;
+  const size_t top    = params.weight.height_ / 2;
+  const size_t blocks = params.in.depth_ / block;
+
+  const size_t right  = pw - iw - left;
+  const size_t bottom = ph - ih - top;
+
+  out.resize(in.size());
+  for_i(true, out.size(), [&](size_t sample) {
+    // unlike Conv2dPadding::copy_and_pad_input, the border is cleared: the
+    // buffer may hold a planar input from before. the rest is overwritten.
+    out[sample].resize(params.in_padded.size());
+    for (size_t b = 0; b < blocks; b++) {
+      const float_t *pin = &in[sample][b * ih * iw * block];
+      float_t *pimg      = &out[sample][b * ph * pw * block];
+      std::fill_n(pimg, top * pw * block, float_t(0));
+      pimg += top * pw * block;
+      for (size_t y = 0; y < ih; y++) {
+        std::fill_n(pimg, left * block, float_t(0));
+        std::copy(pin, pin + iw * block, pimg + left * block);
+        std::fill_n(pimg + (left + iw) * block, right * block, float_t(0));
+        pin += iw * block;
+        pimg += pw * block;
+      }
+      std::fill_n(pimg, bottom * pw * block, float_t(0));
+    }
+  });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -0,0 +1,495 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "tiny_dnn/core/kernels/weight_transform_cache.h"
+#include "tiny_dnn/core/params/conv_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+namespace fft_detail {
+
+typedef vectorize::CNN_VECTORIZE_TYPE simd;
+typedef simd::register_type simd_register;
+
+// the planes of a spectrum are padded to whole cache lines
+static const size_t plane_alignment = 64 / sizeof(float_t);
+
+inline size_t next_power_of_2(size_t n) {
+  size_t p = 1;
+  while (p < n) p *= 2;
+  return p;
+}
+
+inline size_t round_up(size_t n, size_t multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+/**
+ * radix-2 complex FFT of a fixed power of two length, with the twiddle
+ * factors and the bit-reversal permutation computed once.
+ *
+ * It transforms many sequences at once: element n of sequence l is at
+ * re[n * lanes + l] and im[n * lanes + l], so that every butterfly is a
+ * vector operation across the sequences. lanes must be a multiple of the
+ * SIMD width, and the planes aligned to it.
+ **/
+class fft_plan {
+ public:
+  explicit fft_plan(size_t n = 1)
+    : n_(n), twiddle_re_(n / 2), twiddle_im_(n / 2), reversed_(n) {
+    const double pi = std::acos(-1.0);
+    for (size_t k = 0; k < n / 2; k++) {
+      twiddle_re_[k] = float_t(std::cos(-2.0 * pi * k / n));
+      twiddle_im_[k] = float_t(std::sin(-2.0 * pi * k / n));
+    }
+    size_t bits = 0;
+    while ((size_t(1) << bits) < n) bits++;
+    for (size_t i = 0; i < n; i++) {
+      size_t r = 0;
+      for (size_t b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+      reversed_[i] = r;
+    }
+  }
+
+  size_t size() const { return n_; }
+
+  // x = DFT(x), or n * IDFT(x) with inverse, for every sequence
+  void transform(float_t *re, float_t *im, size_t lanes, bool inverse) const {
+    for (size_t i = 0; i < n_; i++) {
+      const size_t j = reversed_[i];
+      if (i < j) {
+        std::swap_ranges(re + i * lanes, re + (i + 1) * lanes, re + j * lanes);
+        std::swap_ranges(im + i * lanes, im + (i + 1) * lanes, im + j * lanes);
+      }
+    }
+    const simd_register minus_one = simd::set1(float_t(-1));
+    const float_t sign            = inverse ? float_t(-1) : float_t(1);
+    for (size_t len = 2; len <= n_; len *= 2) {
+      const size_t half = len / 2;
+      const size_t step = n_ / len;
+      for (size_t j = 0; j < half; j++) {
+        const simd_register wr  = simd::set1(twiddle_re_[j * step]);
+        const simd_register wi  = simd::set1(sign * twiddle_im_[j * step]);
+        const simd_register nwi = simd::set1(-sign * twiddle_im_[j * step]);
+        for (size_t i = j; i < n_; i += len) {
+          float_t *ur = re + i * lanes, *vr = re + (i + half) * lanes;
+          float_t *ui = im + i * lanes, *vi = im + (i + half) * lanes;
+          for (size_t l = 0; l < lanes; l += simd::unroll_size) {
+            const simd_register xr = simd::load<std::true_type>(vr + l);
+            const simd_register xi = simd::load<std::true_type>(vi + l);
+            const simd_register yr = simd::load<std::true_type>(ur + l);
+            const simd_register yi = simd::load<std::true_type>(ui + l);
+            // t = v * w, u' = u + t, v' = u - t
+            const simd_register tr = simd::madd(xr, wr, simd::mul(xi, nwi));
+            const simd_register ti = simd::madd(xr, wi, simd::mul(xi, wr));
+            simd::store<std::true_type>(ur + l, simd::add(yr, tr));
+            simd::store<std::true_type>(ui + l, simd::add(yi, ti));
+            simd::store<std::true_type>(vr + l, simd::madd(tr, minus_one, yr));
+            simd::store<std::true_type>(vi + l, simd::madd(ti, minus_one, yi));
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  size_t n_;
+  std::vector<float_t> twiddle_re_;
+  std::vector<float_t> twiddle_im_;
+  std::vector<size_t> reversed_;
+};
+
+/**
+ * the tiling of a convolution for conv2d_op_fft: the input is cut into
+ * overlapping tiles of rows x cols, each giving step_y x step_x outputs
+ * (overlap-save), so that the spectra of the filters stay small.
+ **/
+struct fft_tiling {
+  explicit fft_tiling(const core::conv_params &params) {
+    const size_t ky = (params.weight.height_ - 1) * params.h_dilation + 1;
+    const size_t kx = (params.weight.width_ - 1) * params.w_dilation + 1;
+    const size_t ih = std::max<size_t>(2, params.in_padded.height_);
+    const size_t iw = std::max<size_t>(2, params.in_padded.width_);
+    // at least half of each tile is output, unless the input is smaller
+    rows = std::min(next_power_of_2(std::max<size_t>(16, 2 * (ky - 1))),
+                    next_power_of_2(ih));
+    cols = std::min(next_power_of_2(std::max<size_t>(16, 2 * (kx - 1))),
+                    next_power_of_2(iw));
+    half        = cols / 2 + 1;
+    half_lanes  = round_up(half, simd::unroll_size);
+    pair_lanes  = round_up(rows / 2, simd::unroll_size);
+    plane       = round_up(rows * half, plane_alignment);
+    step_y      = rows - ky + 1;
+    step_x      = cols - kx + 1;
+    tiles_y     = (params.out.height_ + step_y - 1) / step_y;
+    tiles_x     = (params.out.width_ + step_x - 1) / step_x;
+  }
+
+  size_t tiles() const { return tiles_y * tiles_x; }
+
+  // floats used by forward_2d and inverse_2d
+  size_t work_size() const {
+    return 2 * cols * pair_lanes + 2 * rows * half_lanes;
+  }
+
+  size_t rows, cols;        // the FFT size of a tile
+  size_t half;              // columns of a real spectrum, cols / 2 + 1
+  size_t half_lanes;        // the same, padded to the SIMD width
+  size_t pair_lanes;        // pairs of rows, padded to the SIMD width
+  size_t plane;             // floats of one stored plane of a spectrum
+  size_t step_y, step_x;    // outputs of a tile
+  size_t tiles_y, tiles_x;  // tiles of a sample
+};
+
+/**
+ * the spectrum of a real h x w block (zero padded to rows x cols), stored
+ * as its rows x half non-redundant frequencies in planes of real and
+ * imaginary parts. the row FFTs run on two rows at a time, as the real and
+ * imaginary parts of one complex sequence, and the column FFTs on rows
+ * padded to half_lanes.
+ **/
+inline void forward_2d(const float_t *src,
+                       size_t src_stride,
+                       size_t h,
+                       size_t w,
+                       const fft_plan &row_plan,
+                       const fft_plan &col_plan,
+                       const fft_tiling &tiling,
+                       float_t *work,
+                       float_t *re,
+                       float_t *im) {
+  const size_t rows  = tiling.rows;
+  const size_t cols  = tiling.cols;
+  const size_t pairs = tiling.pair_lanes;
+  const size_t lanes = tiling.half_lanes;
+  float_t *zr        = work;
+  float_t *zi        = zr + cols * pairs;
+  float_t *sr        = zi + cols * pairs;
+  float_t *si        = sr + rows * lanes;
+
+  // z[c][p] = src[2p][c] + i src[2p + 1][c]
+  std::fill(work, work + 2 * cols * pairs, float_t(0));
+  for (size_t r = 0; r < h; r++) {
+    float_t *z        = (r % 2 ? zi : zr) + r / 2;
+    const float_t *s  = src + r * src_stride;
+    for (size_t c = 0; c < w; c++) z[c * pairs] = s[c];
+  }
+  row_plan.transform(zr, zi, pairs, false);
+
+  // split the spectra of the two rows, using their hermitian symmetry
+  for (size_t k = 0; k < tiling.half; k++) {
+    const size_t kc = (cols - k) & (cols - 1);
+    for (size_t p = 0; p < rows / 2; p++) {
+      const float_t ar = zr[k * pairs + p], ai = zi[k * pairs + p];
+      const float_t br = zr[kc * pairs + p], bi = -zi[kc * pairs + p];
+      sr[2 * p * lanes + k]       = (ar + br) * float_t(0.5);
+      si[2 * p * lanes + k]       = (ai + bi) * float_t(0.5);
+      sr[(2 * p + 1) * lanes + k] = (ai - bi) * float_t(0.5);
+      si[(2 * p + 1) * lanes + k] = (br - ar) * float_t(0.5);
+    }
+  }
+  for (size_t r = 0; r < rows; r++) {
+    std::fill(sr + r * lanes + tiling.half, sr + (r + 1) * lanes, float_t(0));
+    std::fill(si + r * lanes + tiling.half, si + (r + 1) * lanes, float_t(0));
+  }
+  col_plan.transform(sr, si, lanes, false);
+
+  for (size_t r = 0; r < rows; r++) {
+    std::copy(sr + r * lanes, sr + r * lanes + tiling.half,
+              re + r * tiling.half);
+    std::copy(si + r * lanes, si + r * lanes + tiling.half,
+              im + r * tiling.half);
+  }
+}
+
+/**
+ * dst[0:h, 0:w] = bias + the real block of the spectrum in re, im, the
+ * inverse of forward_2d
+ **/
+inline void inverse_2d(const float_t *re,
+                       const float_t *im,
+                       const fft_plan &row_plan,
+                       const fft_plan &col_plan,
+                       const fft_tiling &tiling,
+                       float_t *work,
+                       float_t bias,
+                       float_t *dst,
+                       size_t dst_stride,
+                       size_t h,
+                       size_t w) {
+  const size_t cols   = tiling.cols;
+  const size_t pairs  = tiling.pair_lanes;
+  const size_t lanes  = tiling.half_lanes;
+  const float_t scale = float_t(1) / float_t(tiling.rows * cols);
+  const size_t rows   = tiling.rows;
+  float_t *zr         = work;
+  float_t *zi         = zr + cols * pairs;
+  float_t *sr         = zi + cols * pairs;
+  float_t *si         = sr + rows * lanes;
+
+  for (size_t r = 0; r < rows; r++) {
+    std::copy(re + r * tiling.half, re + (r + 1) * tiling.half, sr + r * lanes);
+    std::copy(im + r * tiling.half, im + (r + 1) * tiling.half, si + r * lanes);
+  }
+  col_plan.transform(sr, si, lanes, true);
+
+  // z[k][p] = a + i b for the spectra a, b of rows 2p and 2p + 1, whose
+  // upper half mirrors the lower one
+  std::fill(work, work + 2 * cols * pairs, float_t(0));
+  for (size_t p = 0; 2 * p < h; p++) {
+    const float_t *ar = sr + 2 * p * lanes, *ai = si + 2 * p * lanes;
+    const float_t *br = ar + lanes, *bi = ai + lanes;
+    for (size_t k = 0; k < tiling.half; k++) {
+      zr[k * pairs + p] = ar[k] - bi[k];
+      zi[k * pairs + p] = ai[k] + br[k];
+    }
+    for (size_t k = tiling.half; k < cols; k++) {
+      const size_t kc   = cols - k;
+      zr[k * pairs + p] = ar[kc] + bi[kc];
+      zi[k * pairs + p] = br[kc] - ai[kc];
+    }
+  }
+  row_plan.transform(zr, zi, pairs, true);
+
+  for (size_t r = 0; r < h; r++) {
+    const float_t *z = (r % 2 ? zi : zr) + r / 2;
+    float_t *d       = dst + r * dst_stride;
+    for (size_t c = 0; c < w; c++) d[c] = z[c * pairs] * scale + bias;
+  }
+}
+
+/**
+ * y[t][o] = sum over i of x[t][i] * f[o][i] for the frequencies
+ * [j0, j0 + chunk) of every tile t and output channel o, where the input
+ * spectra x come as planes of real, imaginary and negated imaginary parts,
+ * and the filter spectra f as real and imaginary planes. the sum over the
+ * input channels stays in registers, and the chunk of a tile in L1 while
+ * it goes to every output channel.
+ **/
+inline void multiply_spectra(const float_t *x,
+                             const float_t *f,
+                             float_t *y,
+                             size_t tiles,
+                             size_t in_channels,
+                             size_t out_channels,
+                             size_t plane,
+                             size_t j0) {
+  static const size_t nv = plane_alignment / simd::unroll_size;
+
+  for (size_t t = 0; t < tiles; t++) {
+    const float_t *xt = x + t * in_channels * 3 * plane + j0;
+    for (size_t o = 0; o < out_channels; o++) {
+      const float_t *fo = f + o * in_channels * 2 * plane + j0;
+      simd_register yr[nv], yi[nv];
+      for (size_t v = 0; v < nv; v++) yr[v] = yi[v] = simd::zero();
+      for (size_t i = 0; i < in_channels; i++) {
+        const float_t *xi = xt + i * 3 * plane;
+        const float_t *fi = fo + i * 2 * plane;
+        for (size_t v = 0; v < nv; v++) {
+          const size_t j          = v * simd::unroll_size;
+          const simd_register xr  = simd::load<std::true_type>(xi + j);
+          const simd_register xm  = simd::load<std::true_type>(xi + plane + j);
+          const simd_register nxm =
+            simd::load<std::true_type>(xi + 2 * plane + j);
+          const simd_register fr = simd::load<std::true_type>(fi + j);
+          const simd_register fm = simd::load<std::true_type>(fi + plane + j);
+          yr[v] = simd::madd(nxm, fm, simd::madd(xr, fr, yr[v]));
+          yi[v] = simd::madd(xm, fr, simd::madd(xr, fm, yi[v]));
+        }
+      }
+      float_t *yt = y + (t * out_channels + o) * 2 * plane + j0;
+      for (size_t v = 0; v < nv; v++) {
+        const size_t j = v * simd::unroll_size;
+        simd::store<std::true_type>(yt + j, yr[v]);
+        simd::store<std::true_type>(yt + plane + j, yi[v]);
+      }
+    }
+  }
+}
+
+}  // namespace fft_detail
+
+/**
+ * true for the convolutions conv2d_op_fft computes: unit strides, without
+ * connection tables.
+ **/
+inline bool conv2d_fft_eligible(const core::conv_params &params) {
+  return params.w_stride == 1 && params.h_stride == 1 &&
+         params.tbl.is_empty();
+}
+
+/**
+ * true if conv2d_op_fft is faster than the other kernels: its cost does not
+ * grow with the filter size, which pays off from 7x7 filters on, unless
+ * the transforms of a few channels cost more than the products.
+ **/
+inline bool conv2d_fft_preferred(const core::conv_params &params) {
+  const size_t id = params.in.depth_;
+  const size_t od = params.out.depth_;
+  return conv2d_fft_eligible(params) && params.weight.width_ >= 7 &&
+         params.weight.height_ >= 7 &&
+         id * od * params.weight.width_ * params.weight.height_ >=
+           64 * (id + od);
+}
+
+/**
+ * the FFT plans of a layer and the spectra of its filters, transformed
+ * again only when the weights changed.
+ **/
+class conv2d_fft_filter {
+ public:
+  std::shared_ptr<const vec_t> get(const vec_t &W,
+                                   size_t weights_version,
+                                   const core::conv_params &params) {
+    using namespace fft_detail;
+    const fft_tiling tiling(params);
+    {
+      std::lock_guard<std::mutex> lock(plan_mutex_);
+      if (row_plan_.size() != tiling.cols) row_plan_ = fft_plan(tiling.cols);
+      if (col_plan_.size() != tiling.rows) col_plan_ = fft_plan(tiling.rows);
+    }
+
+    return spectra_.get(W, weights_version, [&](const vec_t &w, vec_t &F) {
+      const size_t id    = params.in.depth_;
+      const size_t od    = params.out.depth_;
+      const size_t kh    = params.weight.height_;
+      const size_t kw    = params.weight.width_;
+      const size_t plane = tiling.plane;
+      F.assign(od * id * 2 * plane, float_t(0));
+
+      // the filters spread over their dilation, as one tile
+      vec_t block(tiling.rows * tiling.cols);
+      vec_t work(tiling.work_size());
+      for (size_t o = 0; o < od; o++) {
+        for (size_t i = 0; i < id; i++) {
+          const float_t *g = &w[params.weight.get_index(0, 0, id * o + i)];
+          std::fill(block.begin(), block.end(), float_t(0));
+          for (size_t y = 0; y < kh; y++) {
+            for (size_t x = 0; x < kw; x++) {
+              block[y * params.h_dilation * tiling.cols +
+                    x * params.w_dilation] = g[y * kw + x];
+            }
+          }
+          float_t *re = &F[(o * id + i) * 2 * plane];
+          float_t *im = re + plane;
+          forward_2d(&block[0], tiling.cols, tiling.rows, tiling.cols,
+                     row_plan_, col_plan_, tiling, &work[0], re, im);
+          // correlation multiplies with the conjugate
+          for (size_t f = 0; f < plane; f++) im[f] = -im[f];
+        }
+      }
+    });
+  }
+
+  const fft_detail::fft_plan &row_plan() const { return row_plan_; }
+  const fft_detail::fft_plan &col_plan() const { return col_plan_; }
+
+ private:
+  std::mutex plan_mutex_;
+  fft_detail::fft_plan row_plan_;
+  fft_detail::fft_plan col_plan_;
+  weight_transform_cache spectra_;
+};
+
+/**
+ * forward convolution through the frequency domain, for large filters.
+ *
+ * The input is cut into overlapping tiles (overlap-save) whose spectra are
+ * computed with a radix-2 FFT of real data, multiplied with the cached
+ * spectra of the filters and summed over the input channels in one pass,
+ * then transformed back into the outputs each tile covers. The samples are
+ * split over the threads; a single sample splits its channels instead.
+ **/
+inline void conv2d_op_fft(const tensor_t &in_data,
+                          const vec_t &W,
+                          const vec_t &bias,
+                          tensor_t &out_data,
+                          const core::conv_params &params,
+                          conv2d_fft_filter &filter,
+                          const size_t weights_version,
+                          const bool parallelize) {
+  using namespace fft_detail;
+  if (!conv2d_fft_eligible(params)) {
+    throw nn_error("FFT convolution requires unit strides and no connection "
+                   "table");
+  }
+  const fft_tiling tiling(params);
+  std::shared_ptr<const vec_t> F = filter.get(W, weights_version, params);
+  const fft_plan &row_plan       = filter.row_plan();
+  const fft_plan &col_plan       = filter.col_plan();
+
+  const size_t id    = params.in.depth_;
+  const size_t od    = params.out.depth_;
+  const size_t iw    = params.in_padded.width_;
+  const size_t ih    = params.in_padded.height_;
+  const size_t ow    = params.out.width_;
+  const size_t oh    = params.out.height_;
+  const size_t tiles = tiling.tiles();
+  const size_t plane = tiling.plane;
+  const size_t work_size = tiling.work_size();
+  const bool per_sample = parallelize && in_data.size() > 1;
+
+  for_i(per_sample, in_data.size(), [&](size_t sample) {
+    const bool split = parallelize && !per_sample;
+    scratch_scope scratch;
+    vec_t X(scratch_allocator<float_t>());
+    vec_t Y(scratch_allocator<float_t>());
+    X.assign(tiles * id * 3 * plane, float_t(0));
+    Y.resize(tiles * od * 2 * plane);
+
+    // spectra of the input tiles
+    for_i(split, id, [&](size_t i) {
+      scratch_scope channel_scratch;
+      vec_t work(work_size, float_t(0), scratch_allocator<float_t>());
+      const float_t *in =
+        &in_data[sample][params.in_padded.get_index(0, 0, i)];
+      for (size_t t = 0; t < tiles; t++) {
+        const size_t y0 = t / tiling.tiles_x * tiling.step_y;
+        const size_t x0 = t % tiling.tiles_x * tiling.step_x;
+        float_t *x      = &X[(t * id + i) * 3 * plane];
+        forward_2d(in + y0 * iw + x0, iw, std::min(tiling.rows, ih - y0),
+                   std::min(tiling.cols, iw - x0), row_plan, col_plan, tiling,
+                   &work[0], x, x + plane);
+        for (size_t f = 0; f < plane; f++) x[2 * plane + f] = -x[plane + f];
+      }
+    }, 1);
+
+    // products, summed over the input channels
+    for_i(split, plane / plane_alignment, [&](size_t chunk) {
+      multiply_spectra(&X[0], &(*F)[0], &Y[0], tiles, id, od, plane,
+                       chunk * plane_alignment);
+    }, 1);
+
+    // back to the outputs of each tile
+    for_i(split, od, [&](size_t o) {
+      scratch_scope channel_scratch;
+      vec_t work(work_size, float_t(0), scratch_allocator<float_t>());
+      float_t *out    = &out_data[sample][params.out.get_index(0, 0, o)];
+      const float_t b = params.has_bias ? bias[o] : float_t(0);
+      for (size_t t = 0; t < tiles; t++) {
+        const size_t y0 = t / tiling.tiles_x * tiling.step_y;
+        const size_t x0 = t % tiling.tiles_x * tiling.step_x;
+        const float_t *y = &Y[(t * od + o) * 2 * plane];
+        inverse_2d(y, y + plane, row_plan, col_plan, tiling, &work[0], b,
+                   out + y0 * ow + x0, ow, std::min(tiling.step_y, oh - y0),
+                   std::min(tiling.step_x, ow - x0));
+      }
+    }, 1);
+  }, 1);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
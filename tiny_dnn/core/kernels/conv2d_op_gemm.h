@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <numeric>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/params/conv_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * true if conv2d_op_gemm can compute the convolution: the gemm kernels do
+ * not support connection tables. the engines use them for every eligible
+ * layer, they were faster than conv2d_op_internal on every shape measured,
+ * down to LeNet-size layers.
+ **/
+inline bool conv2d_gemm_eligible(const core::conv_params &params) {
+  return params.tbl.is_empty();
+}
+
+// the input windows of one (padded) sample as a matrix of
+// in.depth * kh * kw rows, one per weight, and out.width * out.height
+// columns, one per output pixel
+inline void conv2d_im2col(const vec_t &in,
+                          const core::conv_params &params,
+                          float_t *col) {
+  const size_t iw = params.in_padded.width_;
+  const size_t ow = params.out.width_;
+  const size_t oh = params.out.height_;
+  for (size_t inc = 0; inc < params.in.depth_; inc++) {
+    const float_t *pin = &in[params.in_padded.get_index(0, 0, inc)];
+    for (size_t wy = 0; wy < params.weight.height_; wy++) {
+      for (size_t wx = 0; wx < params.weight.width_; wx++) {
+        const float_t *pwin = pin + wy * params.h_dilation * iw +
+                              wx * params.w_dilation;
+        for (size_t y = 0; y < oh; y++) {
+          const float_t *pline = pwin + y * params.h_stride * iw;
+          if (params.w_stride == 1) {
+            std::copy(pline, pline + ow, col);
+          } else {
+            for (size_t x = 0; x < ow; x++) {
+              col[x] = pline[x * params.w_stride];
+            }
+          }
+          col += ow;
+        }
+      }
+    }
+  }
+}
+
+// inverse of conv2d_im2col, adding every column back to its window
+inline void conv2d_col2im(const float_t *col,
+                          const core::conv_params &params,
+                          vec_t &delta) {
+  const size_t iw = params.in_padded.width_;
+  const size_t ow = params.out.width_;
+  const size_t oh = params.out.height_;
+  for (size_t inc = 0; inc < params.in.depth_; inc++) {
+    float_t *pdelta = &delta[params.in_padded.get_index(0, 0, inc)];
+    for (size_t wy = 0; wy < params.weight.height_; wy++) {
+      for (size_t wx = 0; wx < params.weight.width_; wx++) {
+        float_t *pwin = pdelta + wy * params.h_dilation * iw +
+                        wx * params.w_dilation;
+        for (size_t y = 0; y < oh; y++) {
+          float_t *pline = pwin + y * params.h_stride * iw;
+          for (size_t x = 0; x < ow; x++) {
+            pline[x * params.w_stride] += col[x];
+          }
+          col += ow;
+        }
+      }
+    }
+  }
+}
+
+// a 1x1 convolution with unit strides reads the input as it is
+inline bool conv2d_im2col_is_identity(const core::conv_params &params) {
+  return params.weight.width_ == 1 && params.weight.height_ == 1 &&
+         params.w_stride == 1 && params.h_stride == 1 &&
+         params.in_padded.width_ == params.in.width_ &&
+         params.in_padded.height_ == params.in.height_;
+}
+
+/**
+ * forward convolution as a matrix product: the weights, a matrix of
+ * out.depth rows and in.depth * kh * kw columns, times the windows of each
+ * sample lowered with conv2d_im2col. the samples are split over the
+ * threads; a single sample splits its product instead.
+ **/
+inline void conv2d_op_gemm(const tensor_t &in_data,
+                           const vec_t &W,
+                           const vec_t &bias,
+                           tensor_t &out_data,
+                           const core::conv_params &params,
+                           const bool parallelize) {
+  const size_t m = params.out.depth_;
+  const size_t n = params.out.area();
+  const size_t k = params.in.depth_ * params.weight.area();
+  const bool per_sample = parallelize && in_data.size() > 1;
+
+  for_i(per_sample, in_data.size(), [&](size_t sample) {
+    float_t *out = &out_data[sample][0];
+    if (params.has_bias) {
+      for (size_t o = 0; o < m; o++) {
+        vectorize::add(bias[o], n, out + o * n);
+      }
+    }
+
+    scratch_scope scratch;
+    vec_t col(scratch_allocator<float_t>());
+    const float_t *windows = &in_data[sample][0];
+    if (!conv2d_im2col_is_identity(params)) {
+      col.resize(k * n);
+      conv2d_im2col(in_data[sample], params, &col[0]);
+      windows = &col[0];
+    }
+    gemm(m, n, k, strided_matrix(&W[0], k, 1), strided_matrix(windows, n, 1),
+         out, n, parallelize && !per_sample);
+  }, 1);
+}
+
+/**
+ * backward convolution with the same matrix products as conv2d_op_gemm:
+ * dW += delta * windows^T, and the windows of prev_delta += W^T * delta,
+ * added back to prev_delta with conv2d_col2im.
+ **/
+inline void conv2d_op_gemm(const tensor_t &prev_out,
+                           const vec_t &W,
+                           tensor_t &dW,
+                           tensor_t &db,
+                           tensor_t &curr_delta,
+                           tensor_t &prev_delta,
+                           const core::conv_params &params,
+                           const bool parallelize) {
+  const size_t m = params.out.depth_;
+  const size_t n = params.out.area();
+  const size_t k = params.in.depth_ * params.weight.area();
+  const bool per_sample = parallelize && prev_out.size() > 1;
+  const bool identity   = conv2d_im2col_is_identity(params);
+
+  for_i(per_sample, prev_out.size(), [&](size_t sample) {
+    const bool split      = parallelize && !per_sample;
+    const float_t *delta  = &curr_delta[sample][0];
+    scratch_scope scratch;
+    vec_t col(scratch_allocator<float_t>());
+
+    // weights
+    const float_t *windows = &prev_out[sample][0];
+    if (!identity) {
+      col.resize(k * n);
+      conv2d_im2col(prev_out[sample], params, &col[0]);
+      windows = &col[0];
+    }
+    gemm(m, k, n, strided_matrix(delta, n, 1),
+         strided_matrix(windows, n, 1).transposed(), &dW[sample][0], k, split);
+
+    // previous layer
+    if (identity) {
+      gemm(k, n, m, strided_matrix(&W[0], k, 1).transposed(),
+           strided_matrix(delta, n, 1), &prev_delta[sample][0], n, split);
+    } else {
+      std::fill(col.begin(), col.end(), float_t(0));
+      gemm(k, n, m, strided_matrix(&W[0], k, 1).transposed(),
+           strided_matrix(delta, n, 1), &col[0], n, split);
+      conv2d_col2im(&col[0], params, prev_delta[sample]);
+    }
+
+    // bias
+    if (params.has_bias) {
+      for (size_t o = 0; o < m; o++) {
+        db[sample][o] +=
+          std::accumulate(delta + o * n, delta + (o + 1) * n, float_t{0});
+      }
+    }
+  }, 1);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
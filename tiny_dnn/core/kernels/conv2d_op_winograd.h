@@ -0,0 +1,405 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/kernels/weight_transform_cache.h"
+#include "tiny_dnn/core/params/conv_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+namespace winograd_detail {
+
+typedef vectorize::CNN_VECTORIZE_TYPE simd;
+typedef simd::register_type simd_register;
+
+/**
+ * the transforms of F(m x m, 3 x 3), which computes an m x m tile of the
+ * output from an alpha x alpha tile of the input, alpha = m + 2
+ * (Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks").
+ * BT transforms the input tile, G the filter and AT the product back.
+ **/
+template <size_t M>
+struct transforms;
+
+template <>
+struct transforms<2> {
+  static const size_t m     = 2;
+  static const size_t alpha = 4;
+  static const float_t *BT() {
+    static const float_t bt[alpha * alpha] = {
+      1, 0, -1, 0,  //
+      0, 1, 1,  0,  //
+      0, -1, 1, 0,  //
+      0, 1, 0,  -1};
+    return bt;
+  }
+  static const float_t *G() {
+    static const float_t g[alpha * 3] = {
+      1,   0,    0,    //
+      0.5, 0.5,  0.5,  //
+      0.5, -0.5, 0.5,  //
+      0,   0,    1};
+    return g;
+  }
+  static const float_t *AT() {
+    static const float_t at[m * alpha] = {
+      1, 1, 1,  0,  //
+      0, 1, -1, -1};
+    return at;
+  }
+};
+
+template <>
+struct transforms<4> {
+  static const size_t m     = 4;
+  static const size_t alpha = 6;
+  static const float_t *BT() {
+    static const float_t bt[alpha * alpha] = {
+      4, 0,  -5, 0,  1, 0,  //
+      0, -4, -4, 1,  1, 0,  //
+      0, 4,  -4, -1, 1, 0,  //
+      0, -2, -1, 2,  1, 0,  //
+      0, 2,  -1, -2, 1, 0,  //
+      0, 4,  0,  -5, 0, 1};
+    return bt;
+  }
+  static const float_t *G() {
+    static const float_t g[alpha * 3] = {
+      float_t(1) / 4,  0,                0,                //
+      float_t(-1) / 6, float_t(-1) / 6,  float_t(-1) / 6,  //
+      float_t(-1) / 6, float_t(1) / 6,   float_t(-1) / 6,  //
+      float_t(1) / 24, float_t(1) / 12,  float_t(1) / 6,   //
+      float_t(1) / 24, float_t(-1) / 12, float_t(1) / 6,   //
+      0,               0,                1};
+    return g;
+  }
+  static const float_t *AT() {
+    static const float_t at[m * alpha] = {
+      1, 1, 1,  1, 1,  0,  //
+      0, 1, -1, 2, -2, 0,  //
+      0, 1, 1,  4, 4,  0,  //
+      0, 1, -1, 8, -8, 1};
+    return at;
+  }
+};
+
+// dst[0:n] = sum of coef[c] * src[c * src_stride + 0:n] over c < count,
+// the step shared by all the transforms
+inline void combine(const float_t *coef,
+                    size_t coef_stride,
+                    size_t count,
+                    const float_t *src,
+                    size_t src_stride,
+                    float_t *dst,
+                    size_t n) {
+  const size_t vn = n / simd::unroll_size * simd::unroll_size;
+  for (size_t j = 0; j < vn; j += simd::unroll_size) {
+    simd_register acc = simd::zero();
+    for (size_t c = 0; c < count; c++) {
+      const float_t w = coef[c * coef_stride];
+      if (w == float_t(0)) continue;
+      acc = simd::madd(simd::set1(w),
+                       simd::load<std::false_type>(src + c * src_stride + j),
+                       acc);
+    }
+    simd::store<std::false_type>(dst + j, acc);
+  }
+  for (size_t j = vn; j < n; j++) {
+    float_t acc = float_t(0);
+    for (size_t c = 0; c < count; c++) {
+      acc += coef[c * coef_stride] * src[c * src_stride + j];
+    }
+    dst[j] = acc;
+  }
+}
+
+// U[xi][o][i] = (G g G^T)[xi] for the 3x3 filter g between input channel i
+// and output channel o
+template <size_t M>
+void transform_filter(const vec_t &W,
+                      const core::conv_params &params,
+                      float_t *U) {
+  typedef transforms<M> T;
+  const size_t alpha = T::alpha;
+  const size_t id    = params.in.depth_;
+  const size_t od    = params.out.depth_;
+  const float_t *G   = T::G();
+
+  for (size_t o = 0; o < od; o++) {
+    for (size_t i = 0; i < id; i++) {
+      const float_t *g = &W[params.weight.get_index(0, 0, id * o + i)];
+      float_t gg[alpha * 3];
+      for (size_t a = 0; a < alpha; a++) {
+        for (size_t x = 0; x < 3; x++) {
+          gg[a * 3 + x] =
+            G[a * 3] * g[x] + G[a * 3 + 1] * g[3 + x] + G[a * 3 + 2] * g[6 + x];
+        }
+      }
+      for (size_t a = 0; a < alpha; a++) {
+        for (size_t b = 0; b < alpha; b++) {
+          U[((a * alpha + b) * od + o) * id + i] =
+            gg[a * 3] * G[b * 3] + gg[a * 3 + 1] * G[b * 3 + 1] +
+            gg[a * 3 + 2] * G[b * 3 + 2];
+        }
+      }
+    }
+  }
+}
+
+// V[xi][i][tile] = (BT d B)[xi] for every input tile d of one sample,
+// one channel at a time, vectorized over the tiles. rows of V are ldv
+// floats apart.
+template <size_t M>
+void transform_input(const float_t *in,
+                     const core::conv_params &params,
+                     size_t tiles_x,
+                     size_t tiles_y,
+                     float_t *V,
+                     size_t ldv,
+                     float_t *stage) {
+  typedef transforms<M> T;
+  const size_t alpha = T::alpha;
+  const size_t iw    = params.in_padded.width_;
+  const size_t ih    = params.in_padded.height_;
+  const size_t id    = params.in.depth_;
+  const size_t tiles = tiles_x * tiles_y;
+  float_t *d         = stage;
+  float_t *tmp       = stage + alpha * alpha * tiles;
+
+  for (size_t i = 0; i < id; i++) {
+    const float_t *plane = in + params.in_padded.get_index(0, 0, i);
+    // d[r][c][tile] = in[ty * m + r][tx * m + c], zero outside the input
+    for (size_t r = 0; r < alpha; r++) {
+      for (size_t c = 0; c < alpha; c++) {
+        float_t *dst = d + (r * alpha + c) * tiles;
+        for (size_t ty = 0; ty < tiles_y; ty++, dst += tiles_x) {
+          const size_t y = ty * M + r;
+          if (y >= ih) {
+            std::fill(dst, dst + tiles_x, float_t(0));
+            continue;
+          }
+          const float_t *line = plane + y * iw;
+          for (size_t tx = 0; tx < tiles_x; tx++) {
+            const size_t x = tx * M + c;
+            dst[tx]        = x < iw ? line[x] : float_t(0);
+          }
+        }
+      }
+    }
+    // BT d, then (BT d) B
+    for (size_t a = 0; a < alpha; a++) {
+      for (size_t c = 0; c < alpha; c++) {
+        combine(T::BT() + a * alpha, 1, alpha, d + c * tiles, alpha * tiles,
+                tmp + (a * alpha + c) * tiles, tiles);
+      }
+    }
+    for (size_t a = 0; a < alpha; a++) {
+      for (size_t b = 0; b < alpha; b++) {
+        combine(T::BT() + b * alpha, 1, alpha, tmp + a * alpha * tiles, tiles,
+                V + ((a * alpha + b) * id + i) * ldv, tiles);
+      }
+    }
+  }
+}
+
+// out[o] = bias[o] + AT M[.][o] A for every output tile, cropped to the
+// output. rows of M are ldm floats apart.
+template <size_t M>
+void transform_output(const float_t *Mt,
+                      size_t ldm,
+                      const vec_t &bias,
+                      const core::conv_params &params,
+                      size_t tiles_x,
+                      size_t tiles_y,
+                      float_t *out,
+                      float_t *stage) {
+  typedef transforms<M> T;
+  const size_t alpha = T::alpha;
+  const size_t ow    = params.out.width_;
+  const size_t oh    = params.out.height_;
+  const size_t od    = params.out.depth_;
+  const size_t tiles = tiles_x * tiles_y;
+  float_t *tmp       = stage;
+  float_t *y         = stage + M * alpha * tiles;
+
+  for (size_t o = 0; o < od; o++) {
+    const float_t b  = params.has_bias ? bias[o] : float_t(0);
+    float_t *plane   = out + params.out.get_index(0, 0, o);
+    const float_t *m = Mt + o * ldm;
+    // AT M, then (AT M) A
+    for (size_t a = 0; a < M; a++) {
+      for (size_t c = 0; c < alpha; c++) {
+        combine(T::AT() + a * alpha, 1, alpha, m + c * od * ldm,
+                alpha * od * ldm, tmp + (a * alpha + c) * tiles, tiles);
+      }
+    }
+    for (size_t a = 0; a < M; a++) {
+      for (size_t c = 0; c < M; c++) {
+        combine(T::AT() + c * alpha, 1, alpha, tmp + a * alpha * tiles, tiles,
+                y + (a * M + c) * tiles, tiles);
+      }
+    }
+    for (size_t ty = 0; ty < tiles_y; ty++) {
+      for (size_t a = 0; a < M && ty * M + a < oh; a++) {
+        float_t *line = plane + (ty * M + a) * ow;
+        for (size_t c = 0; c < M; c++) {
+          const float_t *src = y + (a * M + c) * tiles + ty * tiles_x;
+          for (size_t tx = 0; tx < tiles_x && tx * M + c < ow; tx++) {
+            line[tx * M + c] = src[tx] + b;
+          }
+        }
+      }
+    }
+  }
+}
+
+template <size_t M>
+void conv2d_op_winograd(const tensor_t &in_data,
+                        const float_t *U,
+                        const vec_t &bias,
+                        tensor_t &out_data,
+                        const core::conv_params &params,
+                        const bool parallelize) {
+  typedef transforms<M> T;
+  const size_t alpha   = T::alpha;
+  const size_t id      = params.in.depth_;
+  const size_t od      = params.out.depth_;
+  const size_t tiles_x = (params.out.width_ + M - 1) / M;
+  const size_t tiles_y = (params.out.height_ + M - 1) / M;
+  const size_t tiles   = tiles_x * tiles_y;
+  // the tiles of all the samples side by side, so that the products are
+  // wide enough for the gemm kernel even on small outputs
+  const size_t n = tiles * in_data.size();
+
+  scratch_scope scratch;
+  vec_t V(scratch_allocator<float_t>());
+  vec_t Mt(scratch_allocator<float_t>());
+  V.resize(alpha * alpha * id * n);
+  Mt.assign(alpha * alpha * od * n, float_t(0));
+
+  for_i(parallelize, in_data.size(), [&](size_t sample) {
+    scratch_scope sample_scratch;
+    vec_t stage(2 * alpha * alpha * tiles, float_t(0),
+                scratch_allocator<float_t>());
+    transform_input<M>(&in_data[sample][0], params, tiles_x, tiles_y,
+                       &V[sample * tiles], n, &stage[0]);
+  }, 1);
+
+  // one product per element of the transformed tiles
+  for (size_t xi = 0; xi < alpha * alpha; xi++) {
+    gemm(od, n, id, strided_matrix(U + xi * od * id, id, 1),
+         strided_matrix(&V[xi * id * n], n, 1), &Mt[xi * od * n], n,
+         parallelize);
+  }
+
+  for_i(parallelize, in_data.size(), [&](size_t sample) {
+    scratch_scope sample_scratch;
+    vec_t stage(2 * alpha * alpha * tiles, float_t(0),
+                scratch_allocator<float_t>());
+    transform_output<M>(&Mt[sample * tiles], n, bias, params, tiles_x,
+                        tiles_y, &out_data[sample][0], &stage[0]);
+  }, 1);
+}
+
+}  // namespace winograd_detail
+
+/**
+ * true for the convolutions conv2d_op_winograd computes: 3x3 filters with
+ * unit strides and dilations, without connection tables.
+ **/
+inline bool conv2d_winograd_eligible(const core::conv_params &params) {
+  return params.weight.width_ == 3 && params.weight.height_ == 3 &&
+         params.w_stride == 1 && params.h_stride == 1 &&
+         params.w_dilation == 1 && params.h_dilation == 1 &&
+         params.tbl.is_empty();
+}
+
+/**
+ * true if conv2d_op_winograd is faster than conv2d_op_gemm. with few
+ * channels the transforms cost more than the multiplications they save.
+ **/
+inline bool conv2d_winograd_preferred(const core::conv_params &params) {
+  return conv2d_winograd_eligible(params) && params.in.depth_ >= 16 &&
+         params.out.depth_ >= 16;
+}
+
+/**
+ * the output tile size of conv2d_op_winograd, from the shape of one sample
+ * so that a sample gives the same result alone and in a batch:
+ * F(4x4, 3x3) saves more multiplications, F(2x2, 3x3) rounds less, and its
+ * products stay wide enough for the gemm kernel on small outputs.
+ **/
+inline size_t conv2d_winograd_tile_size(const core::conv_params &params) {
+  return params.out.width_ >= 16 && params.out.height_ >= 16 ? 4 : 2;
+}
+
+/**
+ * the filters of a layer in the Winograd domain, transformed again only
+ * when the weights changed.
+ **/
+class conv2d_winograd_filter {
+ public:
+  std::shared_ptr<const vec_t> get(const vec_t &W,
+                                   size_t weights_version,
+                                   const core::conv_params &params,
+                                   size_t tile) {
+    const size_t alpha = tile + 2;
+    return transformed_.get(W, weights_version, [&](const vec_t &w, vec_t &U) {
+      U.resize(alpha * alpha * params.in.depth_ * params.out.depth_);
+      if (tile == 4) {
+        winograd_detail::transform_filter<4>(w, params, &U[0]);
+      } else {
+        winograd_detail::transform_filter<2>(w, params, &U[0]);
+      }
+    });
+  }
+
+ private:
+  weight_transform_cache transformed_;
+};
+
+/**
+ * forward 3x3 convolution with Winograd's minimal filtering algorithm.
+ *
+ * The filters come transformed from the cache, every tile of the input is
+ * transformed with vectorized linear combinations, and the elementwise
+ * products, summed over the input channels, become one matrix product per
+ * element of the transformed tiles. The output transform crops the last
+ * row and column of tiles and adds the bias.
+ **/
+inline void conv2d_op_winograd(const tensor_t &in_data,
+                               const vec_t &W,
+                               const vec_t &bias,
+                               tensor_t &out_data,
+                               const core::conv_params &params,
+                               conv2d_winograd_filter &filter,
+                               const size_t weights_version,
+                               const bool parallelize) {
+  if (!conv2d_winograd_eligible(params)) {
+    throw nn_error("Winograd convolution requires 3x3 filters with unit "
+                   "strides and dilations");
+  }
+  const size_t tile = conv2d_winograd_tile_size(params);
+  std::shared_ptr<const vec_t> U =
+    filter.get(W, weights_version, params, tile);
+  if (tile == 4) {
+    winograd_detail::conv2d_op_winograd<4>(in_data, &(*U)[0], bias, out_data,
+                                           params, parallelize);
+  } else {
+    winograd_detail::conv2d_op_winograd<2>(in_data, &(*U)[0], bias, out_data,
+                                           params, parallelize);
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -10,6 +10,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/fully_connected_op_avx.h"
+#include "tiny_dnn/core/kernels/fully_connected_op_gemm.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_internal.h"
 
 namespace tiny_dnn {
@@ -38,7 +39,17 @@ class FullyConnectedGradOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
-    if (engine == core::backend_t::internal) {
+    // the gradients of larger batches are matrix products, those of the
+    // gemm engine always
+    const bool automatic = engine == core::backend_t::internal ||
+                           engine == core::backend_t::avx;
+    if (engine == core::backend_t::gemm ||
+        (automatic &&
+         kernels::fully_connected_gemm_preferred(params, prev_out.size()))) {
+      kernels::fully_connected_op_gemm(
+        prev_out, W[0], dW, params.has_bias_ ? *db : dummy, curr_delta,
+        prev_delta, params, context.parallelize());
+    } else if (engine == core::backend_t::internal) {
       kernels::fully_connected_op_internal(
         prev_out, W[0], dW, params.has_bias_ ? *db : dummy, curr_delta,
         prev_delta, params, context.parallelize());
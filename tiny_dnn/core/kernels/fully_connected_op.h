@@ -9,8 +9,8 @@
 
 #include "tiny_dnn/core/framework/op_kernel.h"
 
-#include "tiny_dnn/core/kernels/fully_connected_op_avx.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_cblas.h"
+#include "tiny_dnn/core/kernels/fully_connected_op_gemm.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_internal.h"
 #include "tiny_dnn/core/kernels/fully_connected_op_nnpack.h"
 
@@ -37,21 +37,23 @@ class FullyConnectedOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
-    if (engine == core::backend_t::internal) {
-      kernels::fully_connected_op_internal(
-        in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
+    // binding the bias to a temporary in the conditional would copy it
+    const vec_t no_bias;
+
+    // the batch is one matrix product, which sums the products of each
+    // output in the same order for any batch size
+    if (engine == core::backend_t::internal ||
+        engine == core::backend_t::avx || engine == core::backend_t::gemm) {
+      kernels::fully_connected_op_gemm(
+        in_data, W[0], params.has_bias_ ? (*bias)[0] : no_bias, out_data,
         params, context.parallelize());
     } else if (engine == core::backend_t::nnpack) {
       kernels::fully_connected_op_nnpack(
-        in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
+        in_data, W[0], params.has_bias_ ? (*bias)[0] : no_bias, out_data,
         params, context.parallelize());
-    } else if (engine == core::backend_t::avx) {
-      kernels::fully_connected_op_avx(in_data, W[0],
-                                      params.has_bias_ ? (*bias)[0] : vec_t(),
-                                      out_data, params, context.parallelize());
     } else if (engine == core::backend_t::cblas) {
       kernels::fully_connected_op_cblas(
-        in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
+        in_data, W[0], params.has_bias_ ? (*bias)[0] : no_bias, out_data,
         params, context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/params/fully_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * true if the gradients of a batch of the given size are computed faster
+ * as matrix products by fully_connected_op_gemm than sample by sample.
+ * the packing of the weights pays off from a few samples on.
+ *
+ * the forward pass has no such threshold: it must give a sample the same
+ * output in any batch, so an engine computes it with one kernel only.
+ **/
+inline bool fully_connected_gemm_preferred(const core::fully_params &params,
+                                           size_t samples) {
+  CNN_UNREFERENCED_PARAMETER(params);
+  return samples >= 4;
+}
+
+namespace fully_connected_detail {
+
+// the samples of t as the rows of one matrix
+inline void gather_rows(const tensor_t &t, size_t size, float_t *dst) {
+  for (size_t sample = 0; sample < t.size(); sample++) {
+    std::copy(t[sample].begin(), t[sample].begin() + size, dst);
+    dst += size;
+  }
+}
+
+}  // namespace fully_connected_detail
+
+/**
+ * forward pass of a batch as one matrix product: the samples form the
+ * rows of X, and Y = X * W + bias, W being stored in_size x out_size.
+ **/
+inline void fully_connected_op_gemm(const tensor_t &in_data,
+                                    const vec_t &W,
+                                    const vec_t &bias,
+                                    tensor_t &out_data,
+                                    const core::fully_params &params,
+                                    const bool layer_parallelize) {
+  using fully_connected_detail::gather_rows;
+  const size_t samples  = in_data.size();
+  const size_t in_size  = params.in_size_;
+  const size_t out_size = params.out_size_;
+
+  scratch_scope scratch;
+  vec_t x(scratch_allocator<float_t>()), y(scratch_allocator<float_t>());
+  x.resize(samples * in_size);
+  y.resize(samples * out_size);
+  gather_rows(in_data, in_size, &x[0]);
+  for (size_t sample = 0; sample < samples; sample++) {
+    if (params.has_bias_) {
+      std::copy(bias.begin(), bias.begin() + out_size, &y[sample * out_size]);
+    } else {
+      std::fill_n(&y[sample * out_size], out_size, float_t{0});
+    }
+  }
+
+  gemm(samples, out_size, in_size, strided_matrix(&x[0], in_size, 1),
+       strided_matrix(&W[0], out_size, 1), &y[0], out_size,
+       layer_parallelize);
+
+  for (size_t sample = 0; sample < samples; sample++) {
+    const float_t *row = &y[sample * out_size];
+    std::copy(row, row + out_size, out_data[sample].begin());
+  }
+}
+
+/**
+ * backward pass of a batch as matrix products: dX += dY * W^T and
+ * dW += X^T * dY. the weight gradient of the whole batch goes to the
+ * first sample, as their sum is all that the update reads.
+ **/
+inline void fully_connected_op_gemm(const tensor_t &prev_out,
+                                    const vec_t &W,
+                                    tensor_t &dW,
+                                    tensor_t &db,
+                                    tensor_t &curr_delta,
+                                    tensor_t &prev_delta,
+                                    const core::fully_params &params,
+                                    const bool layer_parallelize) {
+  using fully_connected_detail::gather_rows;
+  const size_t samples  = prev_out.size();
+  const size_t in_size  = params.in_size_;
+  const size_t out_size = params.out_size_;
+
+  scratch_scope scratch;
+  vec_t x(scratch_allocator<float_t>()), dy(scratch_allocator<float_t>());
+  vec_t dx(scratch_allocator<float_t>());
+  x.resize(samples * in_size);
+  dy.resize(samples * out_size);
+  dx.resize(samples * in_size);
+  gather_rows(prev_out, in_size, &x[0]);
+  gather_rows(curr_delta, out_size, &dy[0]);
+
+  // previous layer
+  gemm(samples, in_size, out_size, strided_matrix(&dy[0], out_size, 1),
+       strided_matrix(&W[0], out_size, 1).transposed(), &dx[0], in_size,
+       layer_parallelize);
+  for (size_t sample = 0; sample < samples; sample++) {
+    const float_t *row = &dx[sample * in_size];
+    vectorize::reduce(row, in_size, &prev_delta[sample][0]);
+  }
+
+  // weights
+  gemm(in_size, out_size, samples,
+       strided_matrix(&x[0], in_size, 1).transposed(),
+       strided_matrix(&dy[0], out_size, 1), &dW[0][0], out_size,
+       layer_parallelize);
+
+  // bias
+  if (params.has_bias_) {
+    for (size_t sample = 0; sample < samples; sample++) {
+      vectorize::reduce(&dy[sample * out_size], out_size, &db[0][0]);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
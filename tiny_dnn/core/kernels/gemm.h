@@ -0,0 +1,203 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * read-only matrix with arbitrary strides: element (i, j) is at
+ * data[i * row_stride + j * col_stride]. swapping the strides transposes
+ * the matrix without moving it.
+ **/
+struct strided_matrix {
+  strided_matrix(const float_t *data, size_t row_stride, size_t col_stride)
+    : data(data), row_stride(row_stride), col_stride(col_stride) {}
+
+  const float_t &operator()(size_t i, size_t j) const {
+    return data[i * row_stride + j * col_stride];
+  }
+
+  strided_matrix transposed() const {
+    return strided_matrix(data, col_stride, row_stride);
+  }
+
+  const float_t *data;
+  size_t row_stride;
+  size_t col_stride;
+};
+
+namespace gemm_detail {
+
+typedef vectorize::CNN_VECTORIZE_TYPE simd;
+typedef simd::register_type simd_register;
+
+// register block of C computed by the micro kernel: mr rows of nv
+// registers each, which leaves registers for a sliver of B and one
+// element of A. without SIMD, wider rows let the compiler vectorize.
+static const size_t mr = 6;
+static const size_t nv = simd::unroll_size == 1 ? 8 : 2;
+static const size_t nr = nv * simd::unroll_size;
+
+// cache blocks: an mc x kc panel of A stays in L2, a kc x nr sliver of B
+// in L1, and each task of the parallel loop owns nc columns of C, or of a
+// range of its rows (see gemm)
+static const size_t mc = 24 * mr;
+static const size_t kc = 256;
+static const size_t nc = 4 * nr;
+
+// rows [i0, i0 + m) and columns [p0, p0 + k) of A, as slivers of mr rows
+// stored column after column. the last sliver is padded with zeros.
+inline void pack_a(const strided_matrix &a,
+                   size_t i0,
+                   size_t m,
+                   size_t p0,
+                   size_t k,
+                   float_t *dst) {
+  for (size_t i = 0; i < m; i += mr) {
+    const size_t rows = std::min(mr, m - i);
+    for (size_t p = 0; p < k; p++) {
+      size_t r = 0;
+      for (; r < rows; r++) *dst++ = a(i0 + i + r, p0 + p);
+      for (; r < mr; r++) *dst++ = float_t(0);
+    }
+  }
+}
+
+// rows [p0, p0 + k) and columns [j0, j0 + n) of B, as slivers of nr columns
+// stored row after row. the last sliver is padded with zeros.
+inline void pack_b(const strided_matrix &b,
+                   size_t p0,
+                   size_t k,
+                   size_t j0,
+                   size_t n,
+                   float_t *dst) {
+  for (size_t j = 0; j < n; j += nr) {
+    const size_t cols = std::min(nr, n - j);
+    for (size_t p = 0; p < k; p++) {
+      size_t c = 0;
+      if (b.col_stride == 1) {
+        const float_t *src = &b(p0 + p, j0 + j);
+        for (; c < cols; c++) *dst++ = src[c];
+      } else {
+        for (; c < cols; c++) *dst++ = b(p0 + p, j0 + j + c);
+      }
+      for (; c < nr; c++) *dst++ = float_t(0);
+    }
+  }
+}
+
+// C[0:rows, 0:cols] += a * b for one sliver of each, accumulated in
+// registers
+inline void micro_kernel(size_t k,
+                         const float_t *a,
+                         const float_t *b,
+                         float_t *c,
+                         size_t ldc,
+                         size_t rows,
+                         size_t cols) {
+  simd_register acc[mr][nv];
+  for (size_t i = 0; i < mr; i++) {
+    for (size_t v = 0; v < nv; v++) acc[i][v] = simd::zero();
+  }
+  for (size_t p = 0; p < k; p++, a += mr, b += nr) {
+    simd_register bv[nv];
+    for (size_t v = 0; v < nv; v++) {
+      bv[v] = simd::load<std::true_type>(b + v * simd::unroll_size);
+    }
+    for (size_t i = 0; i < mr; i++) {
+      const simd_register ai = simd::set1(a[i]);
+      for (size_t v = 0; v < nv; v++) acc[i][v] = simd::madd(ai, bv[v], acc[i][v]);
+    }
+  }
+
+  alignas(64) float_t block[mr][nr];
+  for (size_t i = 0; i < mr; i++) {
+    for (size_t v = 0; v < nv; v++) {
+      simd::store<std::true_type>(&block[i][v * simd::unroll_size], acc[i][v]);
+    }
+  }
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = 0; j < cols; j++) c[i * ldc + j] += block[i][j];
+  }
+}
+
+}  // namespace gemm_detail
+
+/**
+ * C += A * B, with A of m x k, B of k x n and C of m x n stored row by row
+ * (ldc floats apart).
+ *
+ * The product is cache-blocked: A is packed kc columns at a time and B
+ * one kc x nc block at a time, into contiguous buffers from the scratch
+ * arena, in the order a register-blocked micro kernel reads them to
+ * compute mr x nr blocks of C. With parallelize, the blocks of columns of
+ * C are split over the worker threads, and so are its rows when there are
+ * fewer column blocks than threads (e.g. the outputs of a classifier).
+ * Each element of C is summed in the same order for any split.
+ **/
+inline void gemm(size_t m,
+                 size_t n,
+                 size_t k,
+                 const strided_matrix &a,
+                 const strided_matrix &b,
+                 float_t *c,
+                 size_t ldc,
+                 bool parallelize) {
+  using namespace gemm_detail;
+  if (m == 0 || n == 0 || k == 0) return;
+
+  scratch_scope scratch;
+  const size_t m_padded = (m + mr - 1) / mr * mr;
+  vec_t packed_a(scratch_allocator<float_t>());
+  packed_a.resize(m_padded * std::min(k, kc));
+
+  const size_t col_tasks = (n + nc - 1) / nc;
+  const size_t threads   = parallelize ? get_num_threads() : 1;
+  size_t row_tasks       = 1;
+  if (col_tasks < threads) {
+    row_tasks = std::min(m_padded / mr, (threads + col_tasks - 1) / col_tasks);
+  }
+  // whole slivers of mr rows per task
+  const size_t task_rows = (m_padded / mr + row_tasks - 1) / row_tasks * mr;
+  row_tasks              = (m + task_rows - 1) / task_rows;
+
+  for (size_t p0 = 0; p0 < k; p0 += kc) {
+    const size_t kb = std::min(kc, k - p0);
+    pack_a(a, 0, m, p0, kb, &packed_a[0]);
+
+    for_i(parallelize, row_tasks * col_tasks, [&](size_t task) {
+      scratch_scope task_scratch;
+      const size_t j0 = task % col_tasks * nc;
+      const size_t nb = std::min(nc, n - j0);
+      const size_t r0 = task / col_tasks * task_rows;
+      const size_t r1 = std::min(m, r0 + task_rows);
+      vec_t packed_b(scratch_allocator<float_t>());
+      packed_b.resize((nb + nr - 1) / nr * nr * kb);
+      pack_b(b, p0, kb, j0, nb, &packed_b[0]);
+
+      for (size_t i0 = r0; i0 < r1; i0 += mc) {
+        const size_t mb = std::min(mc, r1 - i0);
+        for (size_t j = 0; j < nb; j += nr) {
+          for (size_t i = 0; i < mb; i += mr) {
+            micro_kernel(kb, &packed_a[(i0 + i) * kb], &packed_b[j * kb],
+                         c + (i0 + i) * ldc + j0 + j, ldc,
+                         std::min(mr, mb - i), std::min(nr, nb - j));
+          }
+        }
+      }
+    }, 1);
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -54,12 +54,14 @@ class GRUCellOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
+    const vec_t no_bias;
+
     if (engine == core::backend_t::internal || engine == core::backend_t::avx) {
       kernels::gru_cell_op_internal(
         x, h_prev, W_x2z[0], W_x2r[0], W_x2h[0], W_hr2c[0], W_s2z[0], W_s2r[0],
-        params.has_bias_ ? (*b_2z)[0] : vec_t(),
-        params.has_bias_ ? (*b_2r)[0] : vec_t(),
-        params.has_bias_ ? (*b_2h)[0] : vec_t(), out, h, r, z, hr, post_z,
+        params.has_bias_ ? (*b_2z)[0] : no_bias,
+        params.has_bias_ ? (*b_2r)[0] : no_bias,
+        params.has_bias_ ? (*b_2h)[0] : no_bias, out, h, r, z, hr, post_z,
         params, context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
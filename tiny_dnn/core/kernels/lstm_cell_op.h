@@ -59,13 +59,15 @@ class LSTMCellOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
+    const vec_t no_bias;
+
     if (engine == core::backend_t::internal || engine == core::backend_t::avx) {
       kernels::lstm_cell_op_internal(
         x, h_prev, c_prev, W_x2i[0], W_x2f[0], W_x2c[0], W_x2o[0], W_h2i[0],
-        W_h2f[0], W_h2c[0], W_h2o[0], params.has_bias_ ? (*b_2i)[0] : vec_t(),
-        params.has_bias_ ? (*b_2f)[0] : vec_t(),
-        params.has_bias_ ? (*b_2c)[0] : vec_t(),
-        params.has_bias_ ? (*b_2o)[0] : vec_t(), out_data, h_next, c_next, i, f,
+        W_h2f[0], W_h2c[0], W_h2o[0], params.has_bias_ ? (*b_2i)[0] : no_bias,
+        params.has_bias_ ? (*b_2f)[0] : no_bias,
+        params.has_bias_ ? (*b_2c)[0] : no_bias,
+        params.has_bias_ ? (*b_2o)[0] : no_bias, out_data, h_next, c_next, i, f,
         z, c, params, context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
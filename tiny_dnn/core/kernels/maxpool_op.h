@@ -10,6 +10,7 @@
 #include "tiny_dnn/core/framework/op_kernel.h"
 
 #include "tiny_dnn/core/kernels/maxpool_op_avx.h"
+#include "tiny_dnn/core/kernels/maxpool_op_blocked.h"
 #include "tiny_dnn/core/kernels/maxpool_op_internal.h"
 #include "tiny_dnn/core/kernels/maxpool_op_nnpack.h"
 
@@ -35,7 +36,11 @@ class MaxPoolOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
-    if (engine == core::backend_t::internal) {
+    if (params.blocked_input || params.blocked_output) {
+      // the channel-blocked layout is only read and written by this kernel
+      kernels::maxpool_op_blocked(in_data, out_data, params,
+                                  context.parallelize());
+    } else if (engine == core::backend_t::internal) {
       kernels::maxpool_op_internal(in_data, out_data, params.out2inmax,
                                    params.out2in, context.parallelize());
     } else if (engine == core::backend_t::nnpack) {
@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include "tiny_dnn/core/kernels/channel_block.h"
+#include "tiny_dnn/core/params/maxpool_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * true if maxpool_op_blocked pools the channels of the layer
+ **/
+inline bool maxpool_blocked_eligible(const core::maxpool_params &params) {
+  return channel_blockable(params.in);
+}
+
+/**
+ * max pooling of channel_block channels at once, over the same windows as
+ * maxpool_op_internal. reads the blocked layout if params.blocked_input
+ * and writes it if params.blocked_output, the planar layout otherwise.
+ * the indices of the maxima are not recorded: the layer can not run
+ * backward afterwards.
+ **/
+inline void maxpool_op_blocked(const tensor_t &in_data,
+                               tensor_t &out_data,
+                               const core::maxpool_params &params,
+                               const bool layer_parallelize) {
+  if (!maxpool_blocked_eligible(params)) {
+    throw nn_error("the channels of the pooling can not be blocked");
+  }
+  const size_t block  = channel_block;
+  const size_t blocks = params.in.depth_ / block;
+  const size_t ow     = params.out.width_;
+  const size_t oh     = params.out.height_;
+  const channel_view src(params.in, params.blocked_input);
+  const channel_view dst(params.out, params.blocked_output);
+
+  for_i(layer_parallelize, in_data.size() * blocks, [&](size_t task) {
+    const size_t sample = task / blocks;
+    const size_t c      = task % blocks * block;
+    const float_t *in   = &in_data[sample][0] + src.offset(c);
+    float_t *out        = &out_data[sample][0] + dst.offset(c);
+
+    for (size_t oy = 0; oy < oh; oy++) {
+      const size_t y0 = oy * params.stride_y;
+      const size_t y1 = std::min(y0 + params.pool_size_y, params.in.height_);
+      for (size_t ox = 0; ox < ow; ox++) {
+        const size_t x0 = ox * params.stride_x;
+        const size_t x1 = std::min(x0 + params.pool_size_x, params.in.width_);
+
+        float_t max[channel_block];
+        std::fill(max, max + block, std::numeric_limits<float_t>::lowest());
+        for (size_t y = y0; y < y1; y++) {
+          for (size_t x = x0; x < x1; x++) {
+            const float_t *p = in + y * src.row + x * src.column;
+            for (size_t lane = 0; lane < block; lane++) {
+              max[lane] = std::max(max[lane], p[lane * src.lane]);
+            }
+          }
+        }
+
+        float_t *pout = out + oy * dst.row + ox * dst.column;
+        for (size_t lane = 0; lane < block; lane++) {
+          pout[lane * dst.lane] = max[lane];
+        }
+      }
+    }
+  });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -39,10 +39,12 @@ class RecurrentCellOp : public core::OpKernel {
 
     const core::backend_t engine = context.engine();
 
+    const vec_t no_bias;
+
     if (engine == core::backend_t::internal || engine == core::backend_t::avx) {
       kernels::rnn_cell_op_internal(in_data, prev_h, U[0], W[0], V[0],
-                                    params.has_bias_ ? (*bias)[0] : vec_t(),
-                                    params.has_bias_ ? (*c)[0] : vec_t(),
+                                    params.has_bias_ ? (*bias)[0] : no_bias,
+                                    params.has_bias_ ? (*c)[0] : no_bias,
                                     out_data, next_h, params,
                                     context.parallelize());
     } else {
@@ -11,10 +11,19 @@
 #include <limits>
 #include <vector>
 
+#include "tiny_dnn/util/scratch_arena.h"
+
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
+/**
+ * buffer of quantized values. the kernels allocate theirs with
+ * scratch_allocator(), from the scratch arena of the calling thread.
+ **/
+template <class T>
+using quantized_buffer = std::vector<T, aligned_allocator<T, 64>>;
+
 template <class T>
 T highest() {
   return (std::numeric_limits<T>::max)();
@@ -186,29 +195,30 @@ inline void requantize_many_in_new_range<int32_t, uint8_t>(int32_t *input,
 }
 
 // REQUIRES: 'result->NumElements() == input.NumElements()'
-template <class T>
+template <class T, class Alloc>
 void float_tensor_to_quantized_in_place(const vec_t &input,
                                         float_t min,
                                         float_t max,
-                                        std::vector<T> *result) {
+                                        std::vector<T, Alloc> *result) {
   const size_t data_size = input.size();
   for (size_t i = 0; i < data_size; ++i) {
     (*result)[i] = float_to_quantized<T>(input[i], min, max);
   }
 }
 
-template <class T>
-std::vector<T> float_tensor_to_quantized(const vec_t &input,
-                                         float_t min,
-                                         float_t max) {
-  std::vector<T> result(input.size(), static_cast<T>(0));
+template <class T, class Alloc = std::allocator<T>>
+std::vector<T, Alloc> float_tensor_to_quantized(const vec_t &input,
+                                                float_t min,
+                                                float_t max,
+                                                const Alloc &alloc = Alloc()) {
+  std::vector<T, Alloc> result(input.size(), static_cast<T>(0), alloc);
   float_tensor_to_quantized_in_place<T>(input, min, max, &result);
   return result;
 }
 
 // REQUIRES: 'result->NumElements() == input.NumElements()'
-template <class T>
-void quantized_tensor_to_float_in_place(const std::vector<T> &input,
+template <class T, class Alloc>
+void quantized_tensor_to_float_in_place(const std::vector<T, Alloc> &input,
                                         float_t min,
                                         float_t max,
                                         vec_t *result) {
@@ -218,8 +228,8 @@ void quantized_tensor_to_float_in_place(const std::vector<T> &input,
   }
 }
 
-template <class T>
-vec_t quantized_tensor_to_float(const std::vector<T> &input,
+template <class T, class Alloc>
+vec_t quantized_tensor_to_float(const std::vector<T, Alloc> &input,
                                 float_t min,
                                 float_t max) {
   vec_t result(input.size(), static_cast<float_t>(0));
@@ -227,13 +237,13 @@ vec_t quantized_tensor_to_float(const std::vector<T> &input,
   return result;
 }
 
-template <class T1, class T2>
-void quantize_down_and_shrink_range(std::vector<T1> &input,
+template <class T1, class T2, class Alloc1, class Alloc2>
+void quantize_down_and_shrink_range(std::vector<T1, Alloc1> &input,
                                     float_t min_input,
                                     float_t max_input,
                                     float_t *min_new,
                                     float_t *max_new,
-                                    std::vector<T2> *output) {
+                                    std::vector<T2, Alloc2> *output) {
   const int32_t input_lowest_quantized  = static_cast<int32_t>(lowest<T1>());
   const int32_t input_highest_quantized = static_cast<int32_t>(highest<T1>());
   T1 actual_min_quantized               = input_highest_quantized;
@@ -23,6 +23,7 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
                                          const vec_t &bias,
                                          vec_t &a,
                                          const bool layer_parallelize) {
+  scratch_scope scratch;
   // image quantization
   float_t min_input(in[0]);
   float_t max_input(in[0]);
@@ -34,8 +35,9 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
       max_input  = std::max(max_input, (&in[idx])[ins]);
     }
   }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+  quantized_buffer<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input,
+                                       scratch_allocator<uint8_t>());
   // filter quantization
   float_t min_filter(W[0]);
   float_t max_filter(W[0]);
@@ -51,12 +53,13 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
     max_filter = W[0] + 1e-3f;
     min_filter = W[0] - 1e-3f;
   }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  quantized_buffer<uint8_t> W_quantized =
+    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter,
+                                       scratch_allocator<uint8_t>());
   // bias quantization
   float_t min_bias(0);
   float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
+  quantized_buffer<uint8_t> bias_quantized(scratch_allocator<uint8_t>());
   if (params.has_bias) {
     for (size_t inc = 0; inc < params.out.depth_; inc++) {
       min_bias = std::min(min_bias, bias[inc]);
@@ -67,7 +70,8 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
       min_bias = bias[0] - 1e-3f;
     }
     bias_quantized =
-      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias,
+                                         scratch_allocator<uint8_t>());
   }
   // output range
   float_t min_output_value;
@@ -76,7 +80,8 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
     min_input, max_input, min_filter, max_filter, &min_output_value,
     &max_output_value);
 
-  std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> a_quantized(a.size(), static_cast<int32_t>(0),
+                                        scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_input = int64_to_int32(
@@ -133,8 +138,9 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
 
   float_t min_output_requantized;
   float_t max_output_requantized;
-  std::vector<uint8_t> a_requantized(a_quantized.size(),
-                                     static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> a_requantized(a_quantized.size(),
+                                          static_cast<uint8_t>(0),
+                                          scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -143,8 +149,9 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized,
-                                         max_output_requantized);
+  quantized_tensor_to_float_in_place<uint8_t>(a_requantized,
+                                              min_output_requantized,
+                                              max_output_requantized, &a);
 }
 
 inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
@@ -154,6 +161,7 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
                                               vec_t &db,
                                               vec_t &curr_delta,
                                               vec_t *prev_delta) {
+  scratch_scope scratch;
   // previous output quantization
   float_t min_prev_out(prev_out[0]);
   float_t max_prev_out(prev_out[0]);
@@ -165,8 +173,9 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
       max_prev_out = std::max(min_prev_out, (&prev_out[idx])[ins]);
     }
   }
-  std::vector<uint8_t> prev_out_quantized =
-    float_tensor_to_quantized<uint8_t>(prev_out, min_prev_out, max_prev_out);
+  quantized_buffer<uint8_t> prev_out_quantized =
+    float_tensor_to_quantized<uint8_t>(prev_out, min_prev_out, max_prev_out,
+                                       scratch_allocator<uint8_t>());
 
   // filter quantization
   float_t min_filter(W[0]);
@@ -183,8 +192,9 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
     max_filter = W[0] + 1e-3f;
     min_filter = W[0] - 1e-3f;
   }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  quantized_buffer<uint8_t> W_quantized =
+    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter,
+                                       scratch_allocator<uint8_t>());
 
   // current delta quantization
   float_t min_curr_delta(curr_delta[0]);
@@ -196,9 +206,10 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
       max_curr_delta = std::max(max_curr_delta, (&curr_delta[idx])[ins]);
     }
   }
-  std::vector<uint8_t> curr_delta_quantized =
+  quantized_buffer<uint8_t> curr_delta_quantized =
     float_tensor_to_quantized<uint8_t>(curr_delta, min_curr_delta,
-                                       max_curr_delta);
+                                       max_curr_delta,
+                                       scratch_allocator<uint8_t>());
 
   // output range for previous delta
   float_t min_prev_delta_value;
@@ -207,8 +218,8 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
     min_curr_delta, max_curr_delta, min_filter, max_filter,
     &min_prev_delta_value, &max_prev_delta_value);
 
-  std::vector<int32_t> prev_delta_quantized(prev_delta->size(),
-                                            static_cast<int32_t>(0));
+  quantized_buffer<int32_t> prev_delta_quantized(
+    prev_delta->size(), static_cast<int32_t>(0), scratch_allocator<int32_t>());
 
   // output range for dW
   float_t min_dW_value;
@@ -217,7 +228,8 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
     min_curr_delta, max_curr_delta, min_prev_out, max_prev_out, &min_dW_value,
     &max_dW_value);
 
-  std::vector<int32_t> dW_quantized(dW.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> dW_quantized(dW.size(), static_cast<int32_t>(0),
+                                         scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_prev_out = int64_to_int32(
@@ -273,8 +285,9 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
 
   float_t min_prev_delta_requantized;
   float_t max_prev_delta_requantized;
-  std::vector<uint8_t> prev_delta_requantized(prev_delta_quantized.size(),
-                                              static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> prev_delta_requantized(
+    prev_delta_quantized.size(), static_cast<uint8_t>(0),
+    scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -284,9 +297,12 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  vec_t prev_delta_vec = quantized_tensor_to_float<uint8_t>(
-    prev_delta_requantized, min_prev_delta_requantized,
-    max_prev_delta_requantized);
+  vec_t prev_delta_vec(prev_delta_requantized.size(), float_t{0},
+                       scratch_allocator<float_t>());
+  quantized_tensor_to_float_in_place<uint8_t>(prev_delta_requantized,
+                                              min_prev_delta_requantized,
+                                              max_prev_delta_requantized,
+                                              &prev_delta_vec);
 
   // Accumulate dw
   for_i(params.in.depth_, [&](size_t inc) {
@@ -324,8 +340,9 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
 
   float_t min_dW_requantized;
   float_t max_dW_requantized;
-  std::vector<uint8_t> dW_requantized(dW_quantized.size(),
-                                      static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> dW_requantized(dW_quantized.size(),
+                                           static_cast<uint8_t>(0),
+                                           scratch_allocator<uint8_t>());
 
   // requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -334,8 +351,9 @@ inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  dW = quantized_tensor_to_float<uint8_t>(dW_requantized, min_dW_requantized,
-                                          max_dW_requantized);
+  quantized_tensor_to_float_in_place<uint8_t>(dW_requantized,
+                                              min_dW_requantized,
+                                              max_dW_requantized, &dW);
 
   // Accumulate db
   if (params.has_bias) {
@@ -360,6 +378,7 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
                                          vec_t &a,
                                          vec_t &a_r,
                                          const bool layer_parallelize) {
+  scratch_scope scratch;
   // filter range
   float_t min_filter(W_r[0]);
   float_t max_filter(W_r[1]);
@@ -374,18 +393,24 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
     in_r[0], in_r[1], min_filter, max_filter, &min_output_value,
     &max_output_value);
   // data type restore
-  std::vector<uint8_t> in_quantized, W_quantized, bias_quantized;
+  quantized_buffer<uint8_t> in_quantized(in.size(), static_cast<uint8_t>(0),
+                                         scratch_allocator<uint8_t>());
+  quantized_buffer<uint8_t> W_quantized(W.size(), static_cast<uint8_t>(0),
+                                        scratch_allocator<uint8_t>());
+  quantized_buffer<uint8_t> bias_quantized(bias.size(), static_cast<uint8_t>(0),
+                                           scratch_allocator<uint8_t>());
   for (size_t i = 0; i < in.size(); i++) {
-    in_quantized.push_back(static_cast<uint8_t>(in[i]));
+    in_quantized[i] = static_cast<uint8_t>(in[i]);
   }
   for (size_t i = 0; i < W.size(); i++) {
-    W_quantized.push_back(static_cast<uint8_t>(W[i]));
+    W_quantized[i] = static_cast<uint8_t>(W[i]);
   }
   for (size_t i = 0; i < bias.size(); i++) {
-    bias_quantized.push_back(static_cast<uint8_t>(bias[i]));
+    bias_quantized[i] = static_cast<uint8_t>(bias[i]);
   }
 
-  std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> a_quantized(a.size(), static_cast<int32_t>(0),
+                                        scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_input = int64_to_int32(
@@ -442,8 +467,9 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
 
   float_t min_output_requantized;
   float_t max_output_requantized;
-  std::vector<uint8_t> a_requantized(a_quantized.size(),
-                                     static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> a_requantized(a_quantized.size(),
+                                          static_cast<uint8_t>(0),
+                                          scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
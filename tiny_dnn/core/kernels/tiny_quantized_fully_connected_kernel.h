@@ -26,6 +26,7 @@ inline void tiny_quantized_fully_connected_kernel(
   const vec_t &b,
   vec_t &out,
   const bool layer_parallelize) {
+  scratch_scope scratch;
   // input quantization
   float_t min_input(in[0]);
   float_t max_input(in[0]);
@@ -33,8 +34,9 @@ inline void tiny_quantized_fully_connected_kernel(
     min_input = std::min(min_input, in[c]);
     max_input = std::max(max_input, in[c]);
   }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+  quantized_buffer<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input,
+                                       scratch_allocator<uint8_t>());
   // filter quantization
   float_t min_filter(W[0]);
   float_t max_filter(W[0]);
@@ -46,8 +48,9 @@ inline void tiny_quantized_fully_connected_kernel(
     max_filter = W[0] + 1e-3f;
     min_filter = W[0] - 1e-3f;
   }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  quantized_buffer<uint8_t> W_quantized =
+    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter,
+                                       scratch_allocator<uint8_t>());
   // output range
   float_t min_output_value;
   float_t max_output_value;
@@ -57,7 +60,7 @@ inline void tiny_quantized_fully_connected_kernel(
   // bias quantization
   float_t min_bias(0);
   float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
+  quantized_buffer<uint8_t> bias_quantized(scratch_allocator<uint8_t>());
   if (params.has_bias_) {
     for (size_t inc = 0; inc < b.size(); inc++) {
       min_bias = std::min(min_bias, b[inc]);
@@ -67,12 +70,15 @@ inline void tiny_quantized_fully_connected_kernel(
       max_bias = b[0] + 1e-3f;
       min_bias = b[0] - 1e-3f;
     }
-    bias_quantized = float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias);
+    bias_quantized =
+      float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias,
+                                         scratch_allocator<uint8_t>());
   }
   min_output_value += min_bias;
   max_output_value += max_bias;
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> out_quantized(out.size(), static_cast<int32_t>(0),
+                                          scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_input =
@@ -113,8 +119,9 @@ inline void tiny_quantized_fully_connected_kernel(
 
   float_t min_output_requantized;
   float_t max_output_requantized;
-  std::vector<uint8_t> out_requantized(out_quantized.size(),
-                                       static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> out_requantized(out_quantized.size(),
+                                            static_cast<uint8_t>(0),
+                                            scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -123,8 +130,9 @@ inline void tiny_quantized_fully_connected_kernel(
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  out = quantized_tensor_to_float<uint8_t>(
-    out_requantized, min_output_requantized, max_output_requantized);
+  quantized_tensor_to_float_in_place<uint8_t>(out_requantized,
+                                              min_output_requantized,
+                                              max_output_requantized, &out);
 }
 
 inline void tiny_quantized_fully_connected_back_kernel(
@@ -136,6 +144,7 @@ inline void tiny_quantized_fully_connected_back_kernel(
   vec_t &curr_delta,
   vec_t &db,
   const bool layer_parallelize) {
+  scratch_scope scratch;
   // previous output quantization
   float_t min_prev_out(prev_out[0]);
   float_t max_prev_out(prev_out[0]);
@@ -143,8 +152,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
     min_prev_out = std::min(min_prev_out, prev_out[inc]);
     max_prev_out = std::max(min_prev_out, prev_out[inc]);
   }
-  std::vector<uint8_t> prev_out_quantized =
-    float_tensor_to_quantized<uint8_t>(prev_out, min_prev_out, max_prev_out);
+  quantized_buffer<uint8_t> prev_out_quantized =
+    float_tensor_to_quantized<uint8_t>(prev_out, min_prev_out, max_prev_out,
+                                       scratch_allocator<uint8_t>());
 
   // filter quantization
   float_t min_filter(W[0]);
@@ -157,8 +167,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
     max_filter = W[0] + 1e-3f;
     min_filter = W[0] - 1e-3f;
   }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  quantized_buffer<uint8_t> W_quantized =
+    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter,
+                                       scratch_allocator<uint8_t>());
 
   // current delta quantization
   float_t min_curr_delta(curr_delta[0]);
@@ -167,9 +178,10 @@ inline void tiny_quantized_fully_connected_back_kernel(
     min_curr_delta = std::min(min_curr_delta, curr_delta[inc]);
     max_curr_delta = std::max(max_curr_delta, curr_delta[inc]);
   }
-  std::vector<uint8_t> curr_delta_quantized =
+  quantized_buffer<uint8_t> curr_delta_quantized =
     float_tensor_to_quantized<uint8_t>(curr_delta, min_curr_delta,
-                                       max_curr_delta);
+                                       max_curr_delta,
+                                       scratch_allocator<uint8_t>());
 
   // output range for previous delta
   float_t min_prev_delta_value;
@@ -178,8 +190,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
     min_curr_delta, max_curr_delta, min_filter, max_filter,
     &min_prev_delta_value, &max_prev_delta_value);
 
-  std::vector<int32_t> prev_delta_quantized(prev_delta.size(),
-                                            static_cast<int32_t>(0));
+  quantized_buffer<int32_t> prev_delta_quantized(prev_delta.size(),
+                                                 static_cast<int32_t>(0),
+                                                 scratch_allocator<int32_t>());
 
   // output range for dW
   float_t min_dW_value;
@@ -188,7 +201,8 @@ inline void tiny_quantized_fully_connected_back_kernel(
     min_curr_delta, max_curr_delta, min_prev_out, max_prev_out, &min_dW_value,
     &max_dW_value);
 
-  std::vector<int32_t> dW_quantized(dW.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> dW_quantized(dW.size(), static_cast<int32_t>(0),
+                                         scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_prev_out =
@@ -214,8 +228,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
 
   float_t min_prev_delta_requantized;
   float_t max_prev_delta_requantized;
-  std::vector<uint8_t> prev_delta_requantized(prev_delta_quantized.size(),
-                                              static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> prev_delta_requantized(
+    prev_delta_quantized.size(), static_cast<uint8_t>(0),
+    scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -225,9 +240,10 @@ inline void tiny_quantized_fully_connected_back_kernel(
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  prev_delta = quantized_tensor_to_float<uint8_t>(prev_delta_requantized,
-                                                  min_prev_delta_requantized,
-                                                  max_prev_delta_requantized);
+  quantized_tensor_to_float_in_place<uint8_t>(prev_delta_requantized,
+                                              min_prev_delta_requantized,
+                                              max_prev_delta_requantized,
+                                              &prev_delta);
 
   for_(layer_parallelize, 0, size_t(params.out_size_),
        [&](const blocked_range &r) {
@@ -252,8 +268,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
 
   float_t min_dW_requantized;
   float_t max_dW_requantized;
-  std::vector<uint8_t> dW_requantized(dW_quantized.size(),
-                                      static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> dW_requantized(dW_quantized.size(),
+                                           static_cast<uint8_t>(0),
+                                           scratch_allocator<uint8_t>());
 
   // requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -262,8 +279,9 @@ inline void tiny_quantized_fully_connected_back_kernel(
 
   // dequantize to flaot, this could be removed within concatenated quantized
   // network
-  dW = quantized_tensor_to_float<uint8_t>(dW_requantized, min_dW_requantized,
-                                          max_dW_requantized);
+  quantized_tensor_to_float_in_place<uint8_t>(dW_requantized,
+                                              min_dW_requantized,
+                                              max_dW_requantized, &dW);
 }
 
 inline void tiny_quantized_fully_connected_kernel(
@@ -277,6 +295,7 @@ inline void tiny_quantized_fully_connected_kernel(
   vec_t &out,
   vec_t &out_r,
   const bool layer_parallelize) {
+  scratch_scope scratch;
   // filter range
   float_t min_filter(W_r[0]);
   float_t max_filter(W_r[1]);
@@ -300,20 +319,26 @@ inline void tiny_quantized_fully_connected_kernel(
     in_r[0], in_r[1], min_filter, max_filter, &min_output_value,
     &max_output_value);
   // data type restore
-  std::vector<uint8_t> in_quantized, W_quantized, bias_quantized;
+  quantized_buffer<uint8_t> in_quantized(in.size(), static_cast<uint8_t>(0),
+                                         scratch_allocator<uint8_t>());
+  quantized_buffer<uint8_t> W_quantized(W.size(), static_cast<uint8_t>(0),
+                                        scratch_allocator<uint8_t>());
+  quantized_buffer<uint8_t> bias_quantized(b.size(), static_cast<uint8_t>(0),
+                                           scratch_allocator<uint8_t>());
   for (size_t i = 0; i < in.size(); i++) {
-    in_quantized.push_back(static_cast<uint8_t>(in[i]));
+    in_quantized[i] = static_cast<uint8_t>(in[i]);
   }
   for (size_t i = 0; i < W.size(); i++) {
-    W_quantized.push_back(static_cast<uint8_t>(W[i]));
+    W_quantized[i] = static_cast<uint8_t>(W[i]);
   }
   for (size_t i = 0; i < b.size(); i++) {
-    bias_quantized.push_back(static_cast<uint8_t>(b[i]));
+    bias_quantized[i] = static_cast<uint8_t>(b[i]);
   }
   min_output_value += min_bias;
   max_output_value += max_bias;
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
+  quantized_buffer<int32_t> out_quantized(out.size(), static_cast<int32_t>(0),
+                                          scratch_allocator<int32_t>());
 
   // calculating offset
   const int32_t offset_input =
@@ -354,8 +379,9 @@ inline void tiny_quantized_fully_connected_kernel(
 
   float_t min_output_requantized;
   float_t max_output_requantized;
-  std::vector<uint8_t> out_requantized(out_quantized.size(),
-                                       static_cast<uint8_t>(0));
+  quantized_buffer<uint8_t> out_requantized(out_quantized.size(),
+                                            static_cast<uint8_t>(0),
+                                            scratch_allocator<uint8_t>());
 
   // Requantize from 32bits to 8 bits for next layer
   quantize_down_and_shrink_range<int32_t, uint8_t>(
@@ -64,10 +64,10 @@ void gemmlowp_multiply(const uint8_t *a_data,
     &context, lhs, rhs, &result, -offset_a, -offset_b, empty_pipeline);
 }
 
-template <class T1, class T2, class Toutput>
-void tiny_quantized_matmul(const std::vector<T1> &a,
-                           const std::vector<T2> &b,
-                           std::vector<Toutput> &c,
+template <class T1, class T2, class Toutput, class A1, class A2, class A3>
+void tiny_quantized_matmul(const std::vector<T1, A1> &a,
+                           const std::vector<T2, A2> &b,
+                           std::vector<Toutput, A3> &c,
                            const std::vector<size_t> shape_all,
                            const int32_t offset_a,
                            const int32_t offset_b,
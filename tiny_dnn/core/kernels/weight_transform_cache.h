@@ -0,0 +1,60 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <memory>
+#include <mutex>  // NOLINT
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * the weights of a layer transformed for a kernel, kept between calls and
+ * transformed again only when the weights changed, as told by their
+ * version (see layer::weights_version). safe to share between threads
+ * computing the same layer.
+ **/
+class weight_transform_cache {
+ public:
+  /**
+   * the transform of W, computed by transform(W, dst) unless W is the
+   * vector of the last call at the same version
+   **/
+  template <typename Transform>
+  std::shared_ptr<const vec_t> get(const vec_t &W,
+                                   size_t version,
+                                   Transform transform) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (transformed_ && weights_ == &W[0] && size_ == W.size() &&
+        version_ == version) {
+      return transformed_;
+    }
+
+    // transform in place unless a caller still reads the old transform
+    if (!transformed_ || transformed_.use_count() > 1) {
+      transformed_ = std::make_shared<vec_t>();
+    }
+    transform(W, *transformed_);
+    weights_ = &W[0];
+    size_    = W.size();
+    version_ = version;
+    return transformed_;
+  }
+
+ private:
+  std::mutex mutex_;
+  const float_t *weights_ = nullptr;
+  size_t size_            = 0;
+  size_t version_         = 0;
+  std::shared_ptr<vec_t> transformed_;
+};
+
+}  // namespace kernels
+}  // namespace tiny_dnn
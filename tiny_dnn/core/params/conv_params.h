@@ -73,6 +73,9 @@ class conv_params : public Params {
   size_t h_stride;
   size_t w_dilation;
   size_t h_dilation;
+  /* channel-blocked layouts of the data (see kernels::channel_block) */
+  bool blocked_input  = false;
+  bool blocked_output = false;
 
   friend std::ostream &operator<<(std::ostream &o,
                                   const core::conv_params &param) {
@@ -108,15 +111,15 @@ class Conv2dPadding {
       return;
     }
 
-    tensor_t buf(in.size());
+    // the buffer of the previous call is reused: its border is still zero
+    out.resize(in.size());
 
-    for_i(true, buf.size(), [&](size_t sample) {
-      // alloc temporary buffer.
-      buf[sample].resize(params_.in_padded.size());
+    for_i(true, out.size(), [&](size_t sample) {
+      out[sample].resize(params_.in_padded.size());
 
       // make padded version in order to avoid corner-case in fprop/bprop
       for (size_t c = 0; c < params_.in.depth_; c++) {
-        float_t *pimg = &buf[sample][params_.in_padded.get_index(
+        float_t *pimg = &out[sample][params_.in_padded.get_index(
           params_.weight.width_ / 2, params_.weight.height_ / 2, c)];
         const float_t *pin = &in[sample][params_.in.get_index(0, 0, c)];
 
@@ -127,9 +130,6 @@ class Conv2dPadding {
         }
       }
     });
-
-    // shrink buffer to output
-    out = buf;
   }
 
   /* Applies unpadding to an input tensor given the convolution parameters
@@ -142,16 +142,15 @@ class Conv2dPadding {
       return;
     }
 
-    tensor_t buf(delta.size());
+    delta_unpadded.resize(delta.size());
 
-    for_i(true, buf.size(), [&](size_t sample) {
-      // alloc temporary buffer.
-      buf[sample].resize(params_.in.size());
+    for_i(true, delta_unpadded.size(), [&](size_t sample) {
+      delta_unpadded[sample].resize(params_.in.size());
 
       for (size_t c = 0; c < params_.in.depth_; c++) {
         const float_t *pin = &delta[sample][params_.in_padded.get_index(
           params_.weight.width_ / 2, params_.weight.height_ / 2, c)];
-        float_t *pdst = &buf[sample][params_.in.get_index(0, 0, c)];
+        float_t *pdst = &delta_unpadded[sample][params_.in.get_index(0, 0, c)];
 
         for (size_t y = 0; y < params_.in.height_; y++) {
           std::copy(pin, pin + params_.in.width_, pdst);
@@ -160,9 +159,6 @@ class Conv2dPadding {
         }
       }
     });
-
-    // shrink buffer to output
-    delta_unpadded = buf;
   }
 
  private:
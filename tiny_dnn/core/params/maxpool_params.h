@@ -23,6 +23,9 @@ class maxpool_params : public Params {
   size_t stride_x;
   size_t stride_y;
   padding pad_type;
+  /* channel-blocked layouts of the data (see kernels::channel_block) */
+  bool blocked_input  = false;
+  bool blocked_output = false;
 
   /* mapping out => max_index(in) (1:1) */
   std::vector<std::vector<size_t>> out2inmax;
@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <unordered_map>
+
+#include "tiny_dnn/node.h"
+
+namespace tiny_dnn {
+
+class layer;
+class nodes;
+
+/**
+ * activation buffers of inferences running on a shared network.
+ *
+ * predict(in) keeps the activations in the edges of the network, so two
+ * threads can not run it on the same network at once. A context owns its
+ * own copy of every activation and of the layers' scratch buffers, while
+ * the weights stay in the network, shared and read-only. Every thread uses
+ * its own context:
+ *
+ *     execution_context ctx;          // one per thread
+ *     auto y = net.predict(ctx, x);   // may run alongside other contexts
+ *
+ * The buffers are kept from one call to the next. A context must not be
+ * used by two threads at the same time, and the network must not be
+ * trained or modified while contexts are running on it.
+ **/
+class execution_context {
+ public:
+  execution_context() : owner_(nullptr) {}
+
+  /**
+   * activations flowing through the given edge
+   **/
+  tensor_t &data(const edge *e) { return data_[e]; }
+
+  /**
+   * scratch buffer of the given layer
+   **/
+  tensor_t &scratch(const layer *l) { return scratch_[l]; }
+
+  /**
+   * network the context has been prepared for (nullptr if none)
+   **/
+  const nodes *owner() const { return owner_; }
+
+  void set_owner(const nodes *owner) { owner_ = owner; }
+
+  /**
+   * release every buffer
+   **/
+  void clear() {
+    data_.clear();
+    scratch_.clear();
+    owner_ = nullptr;
+  }
+
+ private:
+  const nodes *owner_;
+  std::unordered_map<const edge *, tensor_t> data_;
+  std::unordered_map<const layer *, tensor_t> scratch_;
+};
+
+}  // namespace tiny_dnn
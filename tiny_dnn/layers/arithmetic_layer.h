@@ -41,6 +41,8 @@ class elementwise_add_layer : public layer {
     return {shape3d(dim_, 1, 1)};
   }
 
+  bool reentrant_forward() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &in1 = *in_data[0];
@@ -98,8 +98,16 @@ class batch_normalization_layer : public layer {
 
     CNN_UNREFERENCED_PARAMETER(in_data);
 
-    tensor_t delta_dot_y = curr_out;
-    vec_t mean_delta_dot_y, mean_delta, mean_Y;
+    // the temporaries below live until the end of this pass
+    scratch_scope scratch;
+    const auto alloc = scratch_allocator<float_t>();
+
+    tensor_t delta_dot_y;
+    delta_dot_y.reserve(num_samples);
+    for (size_t i = 0; i < num_samples; i++) {
+      delta_dot_y.emplace_back(curr_out[i], alloc);
+    }
+    vec_t mean_delta_dot_y(alloc), mean_delta(alloc);
 
     for (size_t i = 0; i < num_samples; i++) {
       for (size_t j = 0; j < curr_out[0].size(); j++) {
@@ -167,6 +175,9 @@ class batch_normalization_layer : public layer {
 
   void set_context(net_phase ctx) override { phase_ = ctx; }
 
+  // the moving statistics are updated on every forward pass
+  bool recomputable() const override { return false; }
+
   std::string layer_type() const override { return "batch-norm"; }
 
   void post_update() override {
@@ -177,6 +188,50 @@ class batch_normalization_layer : public layer {
     }
   }
 
+  void merge_batch_statistics(const layer &replica,
+                              size_t shard_samples,
+                              size_t merged_samples) override {
+    const auto &shard = static_cast<const batch_normalization_layer &>(replica);
+    if (merged_samples == 0) {
+      mean_current_     = shard.mean_current_;
+      variance_current_ = shard.variance_current_;
+    } else {
+      // the variances are unbiased: combine the sums of squared deviations
+      const float_t na = float_t(merged_samples * in_spatial_size_);
+      const float_t nb = float_t(shard_samples * in_spatial_size_);
+      const float_t n  = na + nb;
+      for (size_t i = 0; i < in_channels_; i++) {
+        const float_t delta = shard.mean_current_[i] - mean_current_[i];
+        const float_t ss =
+          variance_current_[i] * std::max(float_t(1), na - 1) +
+          shard.variance_current_[i] * std::max(float_t(1), nb - 1) +
+          delta * delta * na * nb / n;
+        mean_current_[i] += delta * nb / n;
+        variance_current_[i] = ss / std::max(float_t(1), n - 1);
+      }
+    }
+    if (update_immidiately_) {
+      mean_     = mean_current_;
+      variance_ = variance_current_;
+    }
+  }
+
+  // the means and the second moments average over the processes
+  vec_t statistics() const override {
+    vec_t s(mean_);
+    for (size_t i = 0; i < in_channels_; i++) {
+      s.push_back(variance_[i] + mean_[i] * mean_[i]);
+    }
+    return s;
+  }
+
+  void set_statistics(const vec_t &averaged) override {
+    for (size_t i = 0; i < in_channels_; i++) {
+      mean_[i]     = averaged[i];
+      variance_[i] = averaged[in_channels_ + i] - mean_[i] * mean_[i];
+    }
+  }
+
   void save(
     std::ostream &os,
     const int precision = std::numeric_limits<float_t>::digits10 + 2
@@ -65,6 +65,8 @@ class concat_layer : public layer {
 
   std::vector<shape3d> out_shape() const override { return {out_shape_}; }
 
+  bool reentrant_forward() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const size_t num_samples = (*out_data[0]).size();
@@ -283,7 +283,7 @@ class convolutional_layer : public layer {
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     // apply padding to the input tensor
-    padding_op_.copy_and_pad_input(*in_data[0], cws_.prev_out_padded_);
+    copy_and_pad_input(*in_data[0], cws_.prev_out_padded_);
 
     fwd_in_data_.resize(in_data.size());
     std::copy(in_data.begin(), in_data.end(), fwd_in_data_.begin());
@@ -293,11 +293,54 @@ class convolutional_layer : public layer {
     fwd_ctx_.set_in_out(fwd_in_data_, out_data);
     fwd_ctx_.setParallelize(layer::parallelize());
     fwd_ctx_.setEngine(layer::engine());
+    fwd_ctx_.setWeightsVersion(layer::weights_version());
 
     // launch convolutional kernel
     kernel_fwd_->compute(fwd_ctx_);
   }
 
+  void forward_in_context(const std::vector<tensor_t *> &in_data,
+                          std::vector<tensor_t *> &out_data,
+                          execution_context &ctx) override {
+    if (layer::engine() == core::backend_t::libdnn) {
+      // device kernels are not reentrant
+      layer::forward_in_context(in_data, out_data, ctx);
+      return;
+    }
+
+    // the padded input goes to the context instead of cws_
+    std::vector<tensor_t *> in(in_data);
+    if (params_.pad_type == padding::same) {
+      tensor_t &padded = ctx.scratch(this);
+      copy_and_pad_input(*in_data[0], padded);
+      in[0] = &padded;
+    }
+
+    core::OpKernelContext fwd_ctx;
+    fwd_ctx.set_in_out(in, out_data);
+    fwd_ctx.setParallelize(layer::parallelize());
+    fwd_ctx.setEngine(layer::engine());
+    fwd_ctx.setWeightsVersion(layer::weights_version());
+
+    kernel_fwd_->compute(fwd_ctx);
+  }
+
+  bool supports_channel_blocking(bool input) const override {
+    return (layer::engine() == core::backend_t::internal ||
+            layer::engine() == core::backend_t::avx) &&
+           (!input || kernels::channel_blockable(params_.in)) &&
+           kernels::conv2d_blocked_preferred(params_);
+  }
+
+  void set_channel_blocking(bool blocked_input, bool blocked_output) override {
+    if (blocked_input != params_.blocked_input) {
+      // the border of the padded input moves with the layout
+      tensor_t().swap(cws_.prev_out_padded_);
+    }
+    params_.blocked_input  = blocked_input;
+    params_.blocked_output = blocked_output;
+  }
+
   /**
    * return delta of previous layer (delta=\frac{dE}{da}, a=wx in
    *fully-connected layer)
@@ -336,8 +379,10 @@ class convolutional_layer : public layer {
     padding_op_.copy_and_unpad_delta(cws_.prev_delta_padded_, *in_grad[0]);
   }
 
-  void set_sample_count(size_t sample_count) override {
-    layer::set_sample_count(sample_count);
+  void set_buffer_sample_count(size_t sample_count) override {
+    if (inference_only_ || cws_.prev_delta_padded_.size() == sample_count) {
+      return;
+    }
     cws_.prev_delta_padded_.resize(sample_count,
                                    vec_t(params_.in_padded.size(), float_t(0)));
   }
@@ -357,6 +402,8 @@ class convolutional_layer : public layer {
 
   std::string layer_type() const override { return std::string("conv"); }
 
+  bool backward_reads_output() const override { return false; }
+
   // TODO(edgar): check this
   std::string kernel_file() const override {
     return std::string(
@@ -423,7 +470,20 @@ class convolutional_layer : public layer {
 
   friend struct serialization_buddy;
 
+ protected:
+  void release_training_buffers() override {
+    tensor_t().swap(cws_.prev_delta_padded_);
+  }
+
  private:
+  void copy_and_pad_input(const tensor_t &in, tensor_t &padded) {
+    if (params_.blocked_input) {
+      kernels::conv2d_pad_blocked_input(in, params_, padded);
+    } else {
+      padding_op_.copy_and_pad_input(in, padded);
+    }
+  }
+
   tensor_t *in_data_padded(const std::vector<tensor_t *> &in) {
     return (params_.pad_type == padding::valid) ? in[0]
                                                 : &cws_.prev_out_padded_;
@@ -511,7 +571,9 @@ class convolutional_layer : public layer {
 
     if (backend_type == core::backend_t::internal ||
         backend_type == core::backend_t::nnpack ||
-        backend_type == core::backend_t::avx) {
+        backend_type == core::backend_t::avx ||
+        backend_type == core::backend_t::gemm ||
+        backend_type == core::backend_t::fft) {
       kernel_fwd_.reset(new Conv2dOp(ctx));
       kernel_back_.reset(new Conv2dGradOp(ctx));
       return;
@@ -93,8 +93,19 @@ class dropout_layer : public layer {
 
     const size_t sample_count = in.size();
 
+    // the masks are only needed by training
+    if (phase_ == net_phase::test) {
+      for_i(sample_count, [&](size_t sample) {
+        const vec_t &in_vec = in[sample];
+        vec_t &out_vec      = out[sample];
+        for (size_t i = 0, end = in_vec.size(); i < end; i++)
+          out_vec[i] = in_vec[i];
+      });
+      return;
+    }
+
     if (mask_.size() < sample_count) {
-      mask_.resize(sample_count, mask_[0]);
+      mask_.resize(sample_count, std::vector<uint8_t>(in_size_));
     }
 
     for_i(sample_count, [&](size_t sample) {
@@ -103,16 +114,11 @@ class dropout_layer : public layer {
       const vec_t &in_vec = in[sample];
       vec_t &out_vec      = out[sample];
 
-      if (phase_ == net_phase::train) {
-        for (size_t i = 0; i < in_vec.size(); i++)
-          mask[i]     = bernoulli(dropout_rate_);
+      for (size_t i = 0; i < in_vec.size(); i++)
+        mask[i]     = bernoulli(dropout_rate_);
 
-        for (size_t i = 0; i < in_vec.size(); i++)
-          out_vec[i]  = mask[i] * scale_ * in_vec[i];
-      } else {
-        for (size_t i = 0, end = in_vec.size(); i < end; i++)
-          out_vec[i] = in_vec[i];
-      }
+      for (size_t i = 0; i < in_vec.size(); i++)
+        out_vec[i]  = mask[i] * scale_ * in_vec[i];
     });
   }
 
@@ -121,6 +127,9 @@ class dropout_layer : public layer {
    **/
   void set_context(net_phase ctx) override { phase_ = ctx; }
 
+  // a new mask is drawn on every forward pass
+  bool recomputable() const override { return false; }
+
   std::string layer_type() const override { return "dropout"; }
 
   // currently used by tests only
@@ -136,6 +145,11 @@ class dropout_layer : public layer {
 
   friend struct serialization_buddy;
 
+ protected:
+  void release_training_buffers() override {
+    std::vector<std::vector<uint8_t>>().swap(mask_);
+  }
+
  private:
   net_phase phase_;
   float_t dropout_rate_;
@@ -78,6 +78,19 @@ class fully_connected_layer : public layer {
     kernel_fwd_->compute(fwd_ctx_);
   }
 
+  void forward_in_context(const std::vector<tensor_t *> &in_data,
+                          std::vector<tensor_t *> &out_data,
+                          execution_context &ctx) override {
+    CNN_UNREFERENCED_PARAMETER(ctx);
+    // the kernel only reads its params, a local op context is enough
+    core::OpKernelContext fwd_ctx;
+    fwd_ctx.set_in_out(in_data, out_data);
+    fwd_ctx.setParallelize(layer::parallelize());
+    fwd_ctx.setEngine(layer::engine());
+
+    kernel_fwd_->compute(fwd_ctx);
+  }
+
   void back_propagation(const std::vector<tensor_t *> &in_data,
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
@@ -93,6 +106,8 @@ class fully_connected_layer : public layer {
 
   std::string layer_type() const override { return "fully-connected"; }
 
+  bool backward_reads_output() const override { return false; }
+
   friend struct serialization_buddy;
 
  protected:
@@ -108,6 +123,7 @@ class fully_connected_layer : public layer {
 
     if (backend_type == core::backend_t::internal ||
         backend_type == core::backend_t::avx ||
+        backend_type == core::backend_t::gemm ||
         backend_type == core::backend_t::nnpack ||
         backend_type == core::backend_t::cblas) {
       kernel_fwd_.reset(new FullyConnectedOp(ctx));
@@ -27,6 +27,8 @@ class input_layer : public layer {
   std::vector<shape3d> out_shape() const override { return {shape_}; }
   std::string layer_type() const override { return "input"; }
 
+  bool reentrant_forward() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     *out_data[0] = *in_data[0];
@@ -11,6 +11,7 @@
 #include <iomanip>
 #include <limits>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <numeric>
 #include <queue>
 #include <sstream>
@@ -21,7 +22,9 @@
 
 #include "tiny_dnn/core/backend.h"
 #include "tiny_dnn/core/framework/device.fwd.h"
+#include "tiny_dnn/execution_context.h"
 #include "tiny_dnn/node.h"
+#include "tiny_dnn/util/batch_storage.h"
 
 #include "tiny_dnn/util/parallel_for.h"
 #include "tiny_dnn/util/product.h"
@@ -68,7 +71,8 @@ class layer : public node {
       in_channels_(in_type.size()),
       out_channels_(out_type.size()),
       in_type_(in_type),
-      out_type_(out_type) {
+      out_type_(out_type),
+      forward_mutex_(std::make_shared<std::mutex>()) {
     weight_init_ = std::make_shared<weight_init::xavier>();
     bias_init_   = std::make_shared<weight_init::constant>();
     trainable_   = true;
@@ -166,6 +170,10 @@ class layer : public node {
     return v;
   }
 
+  /**
+   * mutable weights. handing them out counts as a change of the weights
+   * (see weights_changed)
+   **/
   std::vector<vec_t *> weights() {
     std::vector<vec_t *> v;
     for (size_t i = 0; i < in_channels_; i++) {
@@ -173,9 +181,34 @@ class layer : public node {
         v.push_back(get_weight_data(i));
       }
     }
+    weights_changed();
     return v;
   }
 
+  /**
+   * count a change of the weights, for the kernels caching a transform of
+   * them. weights(), load(), init_weight() and the weight updates count
+   * theirs; call it after writing again to weights handed out earlier.
+   **/
+  void weights_changed() {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) ith_in_node(i)->bump_version();
+    }
+  }
+
+  /**
+   * changes whenever the weights change (see edge::version)
+   **/
+  size_t weights_version() const {
+    size_t version = 0;
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) {
+        version += const_cast<layer *>(this)->ith_in_node(i)->version();
+      }
+    }
+    return version;
+  }
+
   std::vector<tensor_t *> weights_grads() {
     std::vector<tensor_t *> v;
     for (size_t i = 0; i < in_channels_; i++) {
@@ -219,7 +252,7 @@ class layer : public node {
       assert(n < cnt);
       const auto &src_grad = grad[n++];
       size_t sz            = src_grad.size();
-      dst_grad.resize(sz);
+      resize_batch(&dst_grad, sz, ith_out_node(i)->shape().size());
       for (size_t j = 0; j < sz; ++j) {
         assert(dst_grad[j].size() == src_grad[j]->size());
         dst_grad[j] = *src_grad[j];
@@ -237,16 +270,17 @@ class layer : public node {
       assert(n < cnt);
       const auto &src_data = data[n++];
       size_t sz            = src_data.size();
-      dst_data.resize(sz);
-
-      CNN_UNREFERENCED_PARAMETER(in_size);
 
-      for (size_t j = 0; j < sz; ++j) {
+      // in topology-aware mode each sample is copied by the thread that
+      // processes it, keeping newly allocated samples on its NUMA node
+      bool first_touch = parallelize_ && topology_aware();
+      resize_batch(&dst_data, sz, in_size, first_touch);
+      tiny_dnn::for_i(first_touch, sz, [&](size_t j) {
         assert(
           src_data[j]->size() ==
           in_size);  // checking if training data is consistent with layer shape
         dst_data[j] = *src_data[j];
-      }
+      });
     }
   }
 
@@ -259,6 +293,39 @@ class layer : public node {
     }
   }
 
+  /**
+   * same as set_in_data(data, cnt), but copies into the buffers of ctx
+   **/
+  void set_in_data(execution_context &ctx,
+                   const std::vector<const vec_t *> *data,
+                   size_t cnt) {
+    CNN_UNREFERENCED_PARAMETER(cnt);
+    size_t n = 0;
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (in_type_[i] != vector_type::data) continue;
+      tensor_t &dst_data   = ctx.data(prev_[i].get());
+      const auto &src_data = data[n++];
+      resize_batch(&dst_data, src_data.size(), prev_[i]->shape().size());
+      for (size_t j = 0; j < src_data.size(); j++) {
+        assert(src_data[j]->size() == prev_[i]->shape().size());
+        dst_data[j] = *src_data[j];
+      }
+    }
+  }
+
+  /**
+   * same as output(out), but returns the buffers of ctx
+   **/
+  void output(execution_context &ctx,
+              std::vector<const tensor_t *> &out) const {
+    out.clear();
+    for (size_t i = 0; i < out_channels_; i++) {
+      if (out_type_[i] == vector_type::data) {
+        out.push_back(&ctx.data(next_[i].get()));
+      }
+    }
+  }
+
   std::vector<vector_type> in_types() const { return in_type_; }
 
   std::vector<vector_type> out_types() const { return out_type_; }
@@ -267,6 +334,32 @@ class layer : public node {
 
   bool trainable() const { return trainable_; }
 
+  /**
+   * release the storage only needed for training: the gradients of the
+   * edges and the buffers of the backward pass. forward neither clears nor
+   * resizes the gradients from then on, and backward throws until
+   * set_inference_only(false) allocates them again.
+   **/
+  void set_inference_only(bool inference_only) {
+    inference_only_ = inference_only;
+    auto update = [&](const edgeptr_t &e) {
+      tensor_t *grad = e->get_gradient();
+      if (inference_only) {
+        tensor_t().swap(*grad);
+      } else if (grad->empty()) {
+        grad->assign(1, vec_t(e->shape().size()));
+      }
+    };
+    for (size_t i = 0; i < in_channels_; i++) update(ith_in_node(i));
+    for (size_t i = 0; i < out_channels_; i++) update(ith_out_node(i));
+    if (inference_only) {
+      vec_t().swap(weights_diff_);
+      release_training_buffers();
+    }
+  }
+
+  bool inference_only() const { return inference_only_; }
+
   /**
    * return output value range
    * used only for calculating target value from label-id in final(output)
@@ -382,6 +475,7 @@ class layer : public node {
     for (auto &weight : all_weights) {
       for (auto &w : *weight) is >> w;
     }
+    weights_changed();
     initialized_ = true;
   }
 
@@ -390,6 +484,7 @@ class layer : public node {
     for (auto &weight : all_weights) {
       for (auto &w : *weight) w = src[idx++];
     }
+    weights_changed();
     initialized_ = true;
   }
 
@@ -417,6 +512,83 @@ class layer : public node {
   virtual void forward_propagation(const std::vector<tensor_t *> &in_data,
                                    std::vector<tensor_t *> &out_data) = 0;
 
+  /**
+   * forward_propagation called from forward(ctx), possibly by several
+   * threads at once. in_data/out_data point into ctx.
+   *
+   * The default serializes the layer and resizes its internal buffers
+   * (see set_buffer_sample_count), unless reentrant_forward() is true. It
+   * leaves the edges of the network alone, which other layers and a plain
+   * forward() may be resizing meanwhile. Layers which keep
+   * intermediate results in the layer object may override it to place
+   * them in ctx.scratch(this) instead.
+   **/
+  virtual void forward_in_context(const std::vector<tensor_t *> &in_data,
+                                  std::vector<tensor_t *> &out_data,
+                                  execution_context &ctx) {
+    CNN_UNREFERENCED_PARAMETER(ctx);
+    if (reentrant_forward()) {
+      forward_propagation(in_data, out_data);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(*forward_mutex_);
+    set_buffer_sample_count(in_data[0]->size());
+    forward_propagation(in_data, out_data);
+  }
+
+  /**
+   * true if forward_propagation only writes to out_data, so that it can
+   * run on several contexts at the same time
+   **/
+  virtual bool reentrant_forward() const { return false; }
+
+  /**
+   * true if running forward again on the same inputs gives the same
+   * outputs and changes nothing else, so that checkpointing may discard
+   * the outputs and recompute them during backward
+   **/
+  virtual bool recomputable() const { return true; }
+
+  /**
+   * true if forward_propagation still works when out_data is in_data, and
+   * back_propagation then only needs the outputs: the layer may overwrite
+   * its input (see nodes::set_in_place_activations)
+   **/
+  virtual bool can_run_in_place() const { return false; }
+
+  /**
+   * true if back_propagation reads out_data, which must then not be
+   * overwritten by the next layer running in place
+   **/
+  virtual bool backward_reads_output() const { return true; }
+
+  /**
+   * true if forward computes each output value from the input value at the
+   * same index only, so that it runs unchanged on data in any layout (see
+   * nodes::set_channel_blocking)
+   **/
+  virtual bool elementwise() const { return false; }
+
+  /**
+   * true if forward can read its input (input = true), or write its output
+   * (input = false), in the channel-blocked layout (see
+   * kernels::channel_block) and is faster that way
+   **/
+  virtual bool supports_channel_blocking(bool input) const {
+    CNN_UNREFERENCED_PARAMETER(input);
+    return false;
+  }
+
+  /**
+   * read the input and write the output in the channel-blocked layout
+   * instead of the planar one, as chosen by nodes::set_channel_blocking for
+   * the layers which support it. backward needs the planar layout.
+   **/
+  virtual void set_channel_blocking(bool blocked_input, bool blocked_output) {
+    CNN_UNREFERENCED_PARAMETER(blocked_input);
+    CNN_UNREFERENCED_PARAMETER(blocked_output);
+  }
+
   /**
    * return delta of previous layer (delta=\frac{dE}{da}, a=wx in
    *fully-connected layer)
@@ -443,6 +615,37 @@ class layer : public node {
   // called afrer updating weight
   virtual void post_update() {}
 
+  /**
+   * take over the statistics of the last forward pass of the same layer in
+   * a replica, which ran it on shard_samples samples, as if this layer had
+   * seen those samples after the merged_samples it has already taken over
+   * (none: merged_samples = 0). post_update then folds them into the state
+   * of this layer, as after its own forward pass. the replicated training
+   * modes (see network::set_training_mode) keep the state of the layers
+   * which is not a weight this way.
+   **/
+  virtual void merge_batch_statistics(const layer &replica,
+                                      size_t shard_samples,
+                                      size_t merged_samples) {
+    CNN_UNREFERENCED_PARAMETER(replica);
+    CNN_UNREFERENCED_PARAMETER(shard_samples);
+    CNN_UNREFERENCED_PARAMETER(merged_samples);
+  }
+
+  /**
+   * the state of the layer which is estimated from the training data but
+   * is not a weight (e.g. the moving statistics of batch normalization),
+   * as values whose average over copies of the layer trained on as many
+   * samples each is the estimate for all of them. distributed training
+   * (see network::set_communicator) averages them over the processes and
+   * hands the average back to set_statistics.
+   **/
+  virtual vec_t statistics() const { return vec_t(); }
+
+  virtual void set_statistics(const vec_t &averaged) {
+    CNN_UNREFERENCED_PARAMETER(averaged);
+  }
+
   /**
    * notify changing context (train <=> test)
    **/
@@ -537,6 +740,10 @@ class layer : public node {
       fwd_in_data_[i] = ith_in_node(i)->get_data();
     }
 
+    // the buffers of the layer are shared with forward(ctx)
+    std::unique_lock<std::mutex> lock(*forward_mutex_, std::defer_lock);
+    if (!reentrant_forward()) lock.lock();
+
     // resize outs and stuff to have room for every input sample in
     // the batch
     set_sample_count(fwd_in_data_[0]->size());
@@ -547,14 +754,55 @@ class layer : public node {
     // values.
     for (size_t i = 0; i < out_channels_; i++) {
       fwd_out_data_[i] = ith_out_node(i)->get_data();
-      ith_out_node(i)->clear_grads();
+      if (!inference_only_) ith_out_node(i)->clear_grads();
     }
 
     // call the forward computation kernel/routine
     forward_propagation(fwd_in_data_, fwd_out_data_);
   }
 
+  /* @brief Forward pass reading and writing the activations held by an
+   * execution context instead of the edges of the graph.
+   *
+   * Weights and biases are read from the edges and shared by all contexts.
+   * Every edge must already exist (see nodes::prepare_context). Unlike
+   * forward(), several threads may run it on the same layer at once, each
+   * with its own context: layers which keep state in the layer object
+   * while computing are serialized, the others run concurrently.
+   */
+  void forward(execution_context &ctx) {
+    std::vector<tensor_t *> in_data(in_channels_);
+    std::vector<tensor_t *> out_data(out_channels_);
+
+    for (size_t i = 0; i < in_channels_; i++) {
+      in_data[i] = is_trainable_weight(in_type_[i])
+                     ? prev_[i]->get_data()
+                     : &ctx.data(prev_[i].get());
+    }
+
+    const size_t sample_count = in_data[0]->size();
+
+    // inputs which no layer writes to (e.g. initial recurrent states)
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (!is_trainable_weight(in_type_[i]) &&
+          in_data[i]->size() < sample_count) {
+        resize_batch(in_data[i], sample_count, prev_[i]->shape().size());
+      }
+    }
+
+    for (size_t i = 0; i < out_channels_; i++) {
+      tensor_t &out = ctx.data(next_[i].get());
+      resize_batch(&out, sample_count, next_[i]->shape().size());
+      out_data[i] = &out;
+    }
+
+    forward_in_context(in_data, out_data, ctx);
+  }
+
   void backward() {
+    if (inference_only_) {
+      throw nn_error("backward on a layer set to inference only");
+    }
     bwd_in_data_.resize(in_channels_);
     bwd_in_grad_.resize(in_channels_);
     bwd_out_data_.resize(out_channels_);
@@ -649,6 +897,7 @@ class layer : public node {
         default: break;
       }
     }
+    weights_changed();
     // in case we succeed with data initialization, we mark the
     // layer/node as initialized.
     initialized_ = true;
@@ -661,9 +910,20 @@ class layer : public node {
   }
 
   void update_weight(optimizer *o) {
+    apply_weight_grads(o);
+    clear_grads();
+  }
+
+  /**
+   * update the weights and clear their gradients. unlike update_weight,
+   * the gradients of the data inputs are left untouched, since the
+   * backward pass of the previous layers may still be reading them.
+   **/
+  void apply_weight_grads(optimizer *o) {
     auto &diff = weights_diff_;
     for (size_t i = 0; i < in_type_.size(); i++) {
-      if (trainable() && is_trainable_weight(in_type_[i])) {
+      if (!is_trainable_weight(in_type_[i])) continue;
+      if (trainable()) {
         vec_t &target = *get_weight_data(i);
         ith_in_node(i)->merge_grads(&diff);
         float_t rcp_batch_size =
@@ -675,9 +935,10 @@ class layer : public node {
         // thread spawning overhead.
         bool parallelize = (target.size() >= 512);
         o->update(diff, target, parallelize);
+        ith_in_node(i)->bump_version();
       }
+      ith_in_node(i)->clear_grads();
     }
-    clear_grads();
     post_update();
   }
 
@@ -697,26 +958,57 @@ class layer : public node {
   }
 
   virtual void set_sample_count(size_t sample_count) {
-    // increase the size if necessary - but do not decrease
-    auto resize = [sample_count](tensor_t *tensor) {
-      tensor->resize(sample_count, (*tensor)[0]);
+    // first touch new samples from the thread that processes them, so
+    // that their pages land on that thread's NUMA node
+    auto resize = [sample_count](const edgeptr_t &e, tensor_t *tensor) {
+      resize_batch(tensor, sample_count, e->shape().size(), topology_aware());
     };
 
     for (size_t i = 0; i < in_channels_; i++) {
-      if (!is_trainable_weight(in_type_[i])) {
-        resize(ith_in_node(i)->get_data());
-      }
-      resize(ith_in_node(i)->get_gradient());
+      const edgeptr_t &e = ith_in_node(i);
+      if (!is_trainable_weight(in_type_[i])) resize(e, e->get_data());
+      if (!inference_only_) resize(e, e->get_gradient());
     }
 
     for (size_t i = 0; i < out_channels_; i++) {
-      if (!is_trainable_weight(out_type_[i])) {
-        resize(ith_out_node(i)->get_data());
+      const edgeptr_t &e = ith_out_node(i);
+      if (!is_trainable_weight(out_type_[i])) resize(e, e->get_data());
+      if (!inference_only_) resize(e, e->get_gradient());
+    }
+
+    set_buffer_sample_count(sample_count);
+  }
+
+  /**
+   * resize the buffers of the layer object which hold one entry per sample,
+   * without touching the edges of the network
+   **/
+  virtual void set_buffer_sample_count(size_t sample_count) {
+    CNN_UNREFERENCED_PARAMETER(sample_count);
+  }
+
+  /**
+   * read and update the weights of another layer of the same shape from
+   * now on. the gradients of this layer stay its own.
+   **/
+  void share_weights(layer &owner) {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) {
+        ith_in_node(i)->share_data(owner.ith_in_node(i));
       }
-      resize(ith_out_node(i)->get_gradient());
     }
   }
 
+  /**
+   * replace the edge of the i-th output and return the previous one.
+   * the consumers of the previous edge keep reading from it, which lets
+   * pipelined execution double-buffer the edge between two stages.
+   **/
+  edgeptr_t exchange_out_edge(size_t i, edgeptr_t e) {
+    std::swap(next_[i], e);
+    return e;
+  }
+
   /**
    * generate layer from cereal's Archive
    **/
@@ -752,6 +1044,14 @@ class layer : public node {
    * frequent
    * memory allocation */
   vec_t weights_diff_;
+  /** Flag indicating whether the storage of training has been released */
+  bool inference_only_ = false;
+
+  /**
+   * release the buffers used by back_propagation only. called by
+   * set_inference_only(true)
+   **/
+  virtual void release_training_buffers() {}
 
   template <typename T, typename Func>
   inline void for_i(T size, Func f, size_t grainsize = 100) {
@@ -774,6 +1074,8 @@ class layer : public node {
   std::vector<tensor_t *> bwd_in_grad_;
   std::vector<tensor_t *> bwd_out_data_;
   std::vector<tensor_t *> bwd_out_grad_;
+  /** Serializes the forward passes of layers which are not reentrant */
+  std::shared_ptr<std::mutex> forward_mutex_;
 
   /* @brief Allocates the necessary edge memory in a specific
    * incoming connection.
@@ -43,6 +43,8 @@ class linear_layer : public layer {
 
   std::string layer_type() const override { return "linear"; }
 
+  bool reentrant_forward() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &in = *in_data[0];
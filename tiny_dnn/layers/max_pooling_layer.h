@@ -139,6 +139,18 @@ class max_pooling_layer : public layer {
     kernel_back_->compute(bwd_ctx_);
   }
 
+  bool supports_channel_blocking(bool input) const override {
+    CNN_UNREFERENCED_PARAMETER(input);
+    return (layer::engine() == core::backend_t::internal ||
+            layer::engine() == core::backend_t::avx) &&
+           kernels::maxpool_blocked_eligible(params_);
+  }
+
+  void set_channel_blocking(bool blocked_input, bool blocked_output) override {
+    params_.blocked_input  = blocked_input;
+    params_.blocked_output = blocked_output;
+  }
+
   std::vector<index3d<size_t>> in_shape() const override {
     return {params_.in};
   }
@@ -157,8 +169,7 @@ class max_pooling_layer : public layer {
     return std::make_pair(params_.pool_size_x, params_.pool_size_y);
   }
 
-  void set_sample_count(size_t sample_count) override {
-    layer::set_sample_count(sample_count);
+  void set_buffer_sample_count(size_t sample_count) override {
     params_.out2inmax.resize(sample_count,
                              std::vector<size_t>(params_.out.size()));
   }
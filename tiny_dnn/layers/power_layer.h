@@ -56,6 +56,8 @@ class power_layer : public layer {
 
   std::vector<shape3d> out_shape() const override { return {in_shape_}; }
 
+  bool reentrant_forward() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &x = *in_data[0];
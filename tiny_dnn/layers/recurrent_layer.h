@@ -294,6 +294,9 @@ class recurrent_layer : public layer {
 
   std::string layer_type() const override { return "recurrent-layer"; }
 
+  // the state is carried over from one forward pass to the next
+  bool recomputable() const override { return false; }
+
   /**
    * Zeroes the hidden state.
    */
@@ -173,7 +173,7 @@ class slice_layer : public layer {
     }
   }
 
-  void set_sample_count(size_t sample_count) override {
+  void set_buffer_sample_count(size_t sample_count) override {
     if (slice_type_ == slice_type::slice_samples) {
       if (num_outputs_ == 0)
         throw nn_error("num_outputs must be positive integer");
@@ -183,7 +183,6 @@ class slice_layer : public layer {
       slice_size_.resize(num_outputs_, sample_per_out);
       slice_size_.back() = sample_count - (sample_per_out * (num_outputs_ - 1));
     }
-    Base::set_sample_count(sample_count);
   }
 
   void set_shape() {
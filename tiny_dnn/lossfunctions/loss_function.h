@@ -9,6 +9,7 @@
 
 #include <vector>
 
+#include "tiny_dnn/util/sample_view.h"
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
@@ -27,7 +28,7 @@ class mse {
 
   static vec_t df(const vec_t &y, const vec_t &t) {
     assert(y.size() == t.size());
-    vec_t d(t.size());
+    vec_t d(t.size(), float_t(0), scratch_allocator<float_t>());
     float_t factor = float_t(2) / static_cast<float_t>(t.size());
 
     for (size_t i = 0; i < y.size(); ++i) d[i] = factor * (y[i] - t[i]);
@@ -50,7 +51,7 @@ class absolute {
 
   static vec_t df(const vec_t &y, const vec_t &t) {
     assert(y.size() == t.size());
-    vec_t d(t.size());
+    vec_t d(t.size(), float_t(0), scratch_allocator<float_t>());
     float_t factor = float_t(1) / static_cast<float_t>(t.size());
 
     for (size_t i = 0; i < y.size(); ++i) {
@@ -86,7 +87,7 @@ class absolute_eps {
 
   static vec_t df(const vec_t &y, const vec_t &t) {
     assert(y.size() == t.size());
-    vec_t d(t.size());
+    vec_t d(t.size(), float_t(0), scratch_allocator<float_t>());
     const float_t factor = float_t(1) / static_cast<float_t>(t.size());
     const float_t eps    = float_t(1) / fraction;
 
@@ -119,7 +120,7 @@ class cross_entropy {
 
   static vec_t df(const vec_t &y, const vec_t &t) {
     assert(y.size() == t.size());
-    vec_t d(t.size());
+    vec_t d(t.size(), float_t(0), scratch_allocator<float_t>());
 
     for (size_t i = 0; i < y.size(); ++i)
       d[i]        = (y[i] - t[i]) / (y[i] * (float_t(1) - y[i]));
@@ -142,7 +143,7 @@ class cross_entropy_multiclass {
 
   static vec_t df(const vec_t &y, const vec_t &t) {
     assert(y.size() == t.size());
-    vec_t d(t.size());
+    vec_t d(t.size(), float_t(0), scratch_allocator<float_t>());
 
     for (size_t i = 0; i < y.size(); ++i) d[i] = -t[i] / y[i];
 
@@ -186,35 +187,54 @@ inline void apply_cost_if_defined(std::vector<vec_t> &sample_gradient,
   }
 }
 
-// gradient for a minibatch
+// gradient for a minibatch, reading the targets (and the costs, if not
+// empty) in place
 template <typename E>
 std::vector<tensor_t> gradient(const std::vector<tensor_t> &y,
-                               const std::vector<tensor_t> &t,
-                               const std::vector<tensor_t> &t_cost) {
+                               const sample_view &t,
+                               const sample_view &t_cost) {
   const size_t sample_count  = y.size();
   const size_t channel_count = y[0].size();
 
   std::vector<tensor_t> gradients(sample_count);
 
-  CNN_UNREFERENCED_PARAMETER(channel_count);
   assert(y.size() == t.size());
   assert(t_cost.empty() || t_cost.size() == t.size());
 
   // @todo add parallelism
   for (size_t sample = 0; sample < sample_count; ++sample) {
     assert(y[sample].size() == channel_count);
-    assert(t[sample].size() == channel_count);
-    assert(t_cost.empty() || t_cost[sample].empty() ||
-           t_cost[sample].size() == channel_count);
+    assert(t.channels(sample) == channel_count);
 
-    gradients[sample] = gradient<E>(y[sample], t[sample]);
+    // moved in, keeping the memory of df (from the scratch arena during a
+    // training step)
+    tensor_t &g = gradients[sample];
+    g.reserve(channel_count);
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      g.push_back(gradient<E>(y[sample][channel], t.at(sample, channel)));
+    }
 
-    if (sample < t_cost.size()) {
-      apply_cost_if_defined(gradients[sample], t_cost[sample]);
+    // costs are applied only if defined for every channel of the sample
+    if (sample < t_cost.size() && t_cost.channels(sample) == channel_count) {
+      for (size_t channel = 0; channel < channel_count; ++channel) {
+        vec_t &grad        = g[channel];
+        const vec_t &costs = t_cost.at(sample, channel);
+        if (grad.size() != costs.size()) continue;
+        for (size_t element = 0; element < grad.size(); ++element) {
+          grad[element] *= costs[element];
+        }
+      }
     }
   }
 
   return gradients;
 }
 
+template <typename E>
+std::vector<tensor_t> gradient(const std::vector<tensor_t> &y,
+                               const std::vector<tensor_t> &t,
+                               const std::vector<tensor_t> &t_cost) {
+  return gradient<E>(y, sample_view(t), sample_view(t_cost));
+}
+
 }  // namespace tiny_dnn
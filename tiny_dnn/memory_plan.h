@@ -0,0 +1,209 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/batch_storage.h"
+
+namespace tiny_dnn {
+
+/**
+ * activation memory of a network, in bytes
+ **/
+struct memory_usage {
+  size_t naive_bytes;    // every activation in a buffer of its own
+  size_t planned_bytes;  // activations sharing the buffers of the plan
+  size_t arenas;         // number of shared buffers
+};
+
+/**
+ * assignment of the activations of a network to a few shared buffers
+ * (arenas), for inference.
+ *
+ * The layers run one after the other in a fixed order, so the activations
+ * flowing through an edge are only needed from the step producing them to
+ * the last step reading them. Edges whose lifetimes do not overlap are put
+ * in the same arena, like colors of an interval graph: a chain of layers
+ * needs two arenas whatever its depth. The outputs of the network and the
+ * edges read from outside of it keep their own buffers.
+ *
+ * Each edge still has its own tensor, of its own shape, whose samples are
+ * placed in the memory of its arena (see contiguous_block). Edges running
+ * in place use the tensor of the edge they overwrite.
+ **/
+class memory_plan {
+ public:
+  memory_plan() : built_(false), sample_count_(0), naive_(0), fixed_(0) {}
+
+  /**
+   * @param order   layers in the order they run
+   * @param outputs layers whose outputs are read after the forward pass
+   **/
+  void build(const std::vector<layer *> &order,
+             const std::vector<layer *> &outputs) {
+    clear();
+
+    std::unordered_map<const node *, size_t> step;
+    for (size_t i = 0; i < order.size(); i++) step[order[i]] = i;
+
+    // the lifetime of the data of each edge, which edges running in place
+    // (see nodes::set_in_place_activations) extend with their own readers
+    std::unordered_map<const edge *, std::pair<size_t, bool>> lifetime;
+    for (size_t i = 0; i < order.size(); i++) {
+      const bool is_output =
+        std::find(outputs.begin(), outputs.end(), order[i]) != outputs.end();
+
+      for (auto &e : order[i]->outputs()) {
+        naive_ += batch_stride(e->shape().size());
+
+        size_t end    = i;
+        bool internal = !is_output && !e->next().empty();
+        for (auto n : e->next()) {
+          auto it = step.find(n);
+          if (it == step.end()) {
+            internal = false;
+            break;
+          }
+          end = std::max(end, it->second);
+        }
+
+        const edge *owner = e.get();
+        while (owner->data_owner()) owner = owner->data_owner().get();
+        auto it = lifetime.emplace(owner, std::make_pair(end, internal)).first;
+        it->second.first  = std::max(it->second.first, end);
+        it->second.second = it->second.second && internal;
+      }
+    }
+
+    std::vector<size_t> arena_end;  // last step reading each arena
+    for (size_t i = 0; i < order.size(); i++) {
+      for (auto &e : order[i]->outputs()) {
+        if (e->data_owner()) continue;
+
+        const size_t features = e->shape().size();
+        const size_t stride   = batch_stride(features);
+        const size_t end      = lifetime[e.get()].first;
+        if (!lifetime[e.get()].second) {
+          fixed_ += stride;
+          continue;
+        }
+
+        // best fit among the arenas nobody reads from step i on, or the
+        // largest of them, grown to fit
+        size_t best = arena_end.size();
+        for (size_t k = 0; k < arena_end.size(); k++) {
+          if (arena_end[k] >= i) continue;
+          if (best == arena_end.size()) {
+            best = k;
+            continue;
+          }
+          const bool fits      = arena_stride_[k] >= stride;
+          const bool best_fits = arena_stride_[best] >= stride;
+          if (fits ? !best_fits || arena_stride_[k] < arena_stride_[best]
+                   : !best_fits && arena_stride_[k] > arena_stride_[best]) {
+            best = k;
+          }
+        }
+        if (best == arena_end.size()) {
+          arena_end.push_back(end);
+          arena_stride_.push_back(stride);
+        } else {
+          arena_end[best]     = end;
+          arena_stride_[best] = std::max(arena_stride_[best], stride);
+        }
+        edges_.push_back(planned_edge{e, best, features});
+      }
+    }
+    built_ = true;
+  }
+
+  /**
+   * place the activations in the arenas, sized for the given number of
+   * samples. does nothing if they already are.
+   **/
+  void apply(size_t sample_count) {
+    if (sample_count == 0 || sample_count == sample_count_) return;
+
+    std::vector<std::shared_ptr<contiguous_block>> arenas;
+    for (size_t stride : arena_stride_) {
+      arenas.push_back(std::make_shared<contiguous_block>(
+        stride * sizeof(float_t) * sample_count, 64));
+    }
+    for (auto &pe : edges_) {
+      auto &arena = arenas[pe.arena];
+      arena->reset();
+      aligned_allocator<float_t, 64> alloc(arena);
+
+      tensor_t planned;
+      planned.reserve(sample_count);
+      for (size_t i = 0; i < sample_count; i++) {
+        planned.emplace_back(pe.features, float_t(0), alloc);
+      }
+      planned.swap(*pe.e->get_data());
+    }
+    // a sample growing later on gets memory of its own
+    for (auto &arena : arenas) arena->seal();
+    sample_count_ = sample_count;
+  }
+
+  /**
+   * give every edge a buffer of its own again
+   **/
+  void release() {
+    if (sample_count_ == 0) return;
+    for (auto &pe : edges_) {
+      tensor_t{vec_t(pe.features)}.swap(*pe.e->get_data());
+    }
+    sample_count_ = 0;
+  }
+
+  void clear() {
+    release();
+    edges_.clear();
+    arena_stride_.clear();
+    built_ = false;
+    naive_ = fixed_ = 0;
+  }
+
+  bool built() const { return built_; }
+
+  /**
+   * true while the activations are placed in the arenas
+   **/
+  bool applied() const { return sample_count_ != 0; }
+
+  memory_usage usage(size_t sample_count) const {
+    size_t planned = fixed_;
+    for (size_t stride : arena_stride_) planned += stride;
+    return memory_usage{naive_ * sizeof(float_t) * sample_count,
+                        planned * sizeof(float_t) * sample_count,
+                        arena_stride_.size()};
+  }
+
+ private:
+  struct planned_edge {
+    edgeptr_t e;
+    size_t arena;
+    size_t features;
+  };
+
+  bool built_;
+  size_t sample_count_;  // samples the arenas are sized for, 0 if released
+  std::vector<planned_edge> edges_;
+  std::vector<size_t> arena_stride_;  // elements per sample of each arena
+  size_t naive_;                      // elements per sample of every edge
+  size_t fixed_;  // elements per sample of the edges left out of the plan
+};
+
+}  // namespace tiny_dnn
@@ -11,12 +11,18 @@
 #include <fstream>
 #endif
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>  // NOLINT
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -25,6 +31,9 @@
 
 #include "tiny_dnn/lossfunctions/loss_function.h"
 #include "tiny_dnn/nodes.h"
+#include "tiny_dnn/util/async_executor.h"
+#include "tiny_dnn/util/communicator.h"
+#include "tiny_dnn/util/sample_view.h"
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
@@ -37,6 +46,15 @@ enum class content_type {
 
 enum class file_format { binary, portable_binary, json };
 
+/**
+ * how fit() spreads the training over threads
+ **/
+enum class training_mode {
+  synchronous,    ///< one minibatch at a time, parallelized over its samples
+  hogwild,        ///< several minibatches at once, updating without locks
+  data_parallel  ///< minibatches split over replicas, gradients summed
+};
+
 struct result {
   result() : num_success(0), num_total(0) {}
 
@@ -152,13 +170,128 @@ class network {
   typedef typename std::vector<layer *>::const_iterator const_iterator;
 
   explicit network(const std::string &name = "")
-    : name_(name), stop_training_(false) {}
+    : name_(name),
+      num_threads_(0),
+      pipeline_micro_batch_(0),
+      training_mode_(training_mode::synchronous),
+      training_workers_(0),
+      overlap_updates_(false),
+      stop_training_(false),
+      frozen_(false),
+      unfrozen_in_place_activations_(false),
+      unfrozen_memory_planning_(false) {}
 
   /**
    * name of the network
    **/
   std::string name() const { return name_; }
 
+  /**
+   * limit the number of threads used by forward/backward propagation and
+   * weight updates of this network (0: no limit).
+   * the process-wide limit set by tiny_dnn::set_num_threads still applies.
+   **/
+  void set_num_threads(size_t num_threads) { num_threads_ = num_threads; }
+
+  /**
+   * thread budget of this network (0: no limit)
+   **/
+  size_t num_threads() const { return num_threads_; }
+
+  /**
+   * let predict() stream batches through the layers in micro-batches of
+   * the given size, running groups of consecutive layers on different
+   * threads at the same time (0: disabled, the default).
+   * only sequential networks are pipelined; training is not affected.
+   * the layers run out of place meanwhile (see set_in_place_activations).
+   **/
+  void set_pipeline_micro_batch(size_t micro_batch_size) {
+    pipeline_micro_batch_ = micro_batch_size;
+  }
+
+  size_t pipeline_micro_batch() const { return pipeline_micro_batch_; }
+
+  /**
+   * select how fit() parallelizes the training.
+   *
+   * training_mode::hogwild trains a replica of the network on each worker
+   * thread, every worker taking the next minibatch as soon as it is done
+   * with the previous one. The replicas share the weights of this network
+   * and the optimizer, and apply their updates without any locking
+   * (Niu et al., "Hogwild!", 2011). This scales where the synchronous mode
+   * is bound by small minibatches, at the price of updates computed from
+   * slightly stale weights and of results that are not reproducible.
+   * Layer state other than the weights (e.g. the moving statistics of
+   * batch normalization) is updated on this network after each minibatch
+   * of a replica, one minibatch at a time.
+   *
+   * training_mode::data_parallel splits every minibatch into one shard per
+   * worker. Each worker runs the forward and backward passes of its shard
+   * on a replica of the network, which needs no synchronization inside the
+   * layers. The gradients of the replicas are then summed by a tree
+   * reduction, and this network is updated once per minibatch, as in the
+   * synchronous mode. The updates are the same as the synchronous ones up to
+   * rounding, except for layers whose forward pass depends on the whole
+   * minibatch (batch normalization only sees the samples of its shard).
+   * The moving statistics of batch normalization are those of the whole
+   * minibatch, merged from the shards.
+   *
+   * Both replicated modes require serialization support.
+   *
+   * @param mode        training mode
+   * @param num_workers number of replicas (0: one per thread)
+   **/
+  void set_training_mode(training_mode mode, size_t num_workers = 0) {
+    training_mode_    = mode;
+    training_workers_ = num_workers;
+  }
+
+  training_mode get_training_mode() const { return training_mode_; }
+
+  size_t training_workers() const { return training_workers_; }
+
+  /**
+   * let fit() update the weights of each layer on a separate thread as
+   * soon as its gradients are known, while the backward pass continues
+   * into the previous layers (see nodes::backward_and_update). this hides
+   * most of the cost of optimizers with a large state, such as adam on big
+   * fully connected layers. applies to the synchronous training mode.
+   **/
+  void set_overlap_updates(bool overlap) { overlap_updates_ = overlap; }
+
+  bool overlap_updates() const { return overlap_updates_; }
+
+  /**
+   * train together with the other processes of the communicator.
+   *
+   * Each process holds a replica of the network and calls fit() with its
+   * own part of the training data, the same number of minibatches and the
+   * same hyperparameters. fit() starts from the weights of rank 0. After
+   * the backward pass of every minibatch the weight gradients are summed
+   * over all processes (ring all-reduce) and each process updates its
+   * replica with its own optimizer, so the weights stay bit-identical. A
+   * step therefore trains on size() * batch_size samples. The moving
+   * statistics of the layers (see layer::statistics) are averaged over the
+   * processes at the end of each epoch.
+   *
+   * stop_ongoing_training() on any process stops all of them after the
+   * next minibatch.
+   *
+   *     auto comm = std::make_shared<tcp_communicator>(rank, addresses);
+   *     net.set_communicator(comm);
+   *     net.fit<mse>(opt, my_inputs, my_targets, batch_size, epochs);
+   *
+   * @param comm communicator connecting the processes (nullptr: train
+   *             locally)
+   **/
+  void set_communicator(std::shared_ptr<communicator> comm) {
+    communicator_ = comm;
+  }
+
+  std::shared_ptr<communicator> get_communicator() const {
+    return communicator_;
+  }
+
   /**
    * explicitly initialize weights of all layers
    **/
@@ -177,21 +310,24 @@ class network {
   void bprop(const std::vector<tensor_t> &out,
              const std::vector<tensor_t> &t,
              const std::vector<tensor_t> &t_cost) {
+    bprop<E>(out, sample_view(t), sample_view(t_cost));
+  }
+
+  /**
+   * same as above, reading the targets and costs in place
+   **/
+  template <typename E>
+  void bprop(const std::vector<tensor_t> &out,
+             const sample_view &t,
+             const sample_view &t_cost) {
+    thread_budget_scope budget(num_threads_);
     std::vector<tensor_t> delta = gradient<E>(out, t, t_cost);
     net_.backward(delta);
   }
 
   vec_t fprop(const vec_t &in) {
     if (in.size() != (size_t)in_data_size()) data_mismatch(**net_.begin(), in);
-#if 0
-    return fprop(std::vector<vec_t>{ in })[0];
-#else
-    // a workaround to reduce memory consumption by skipping wrapper
-    // function
-    std::vector<tensor_t> a(1);
-    a[0].emplace_back(in);
-    return fprop(a)[0][0];
-#endif
+    return fprop(sample_view(&in, 1))[0][0];
   }
 
   // convenience wrapper for the function below
@@ -200,13 +336,25 @@ class network {
   }
 
   std::vector<tensor_t> fprop(const std::vector<tensor_t> &in) {
-    return net_.forward(in);
+    return fprop(sample_view(in));
+  }
+
+  /**
+   * same as above, reading the samples in place
+   **/
+  std::vector<tensor_t> fprop(const sample_view &in) {
+    thread_budget_scope budget(num_threads_);
+    // within a training step, the outputs stay in its scratch arena
+    if (scratch_arena::local().active()) return net_.forward(in);
+    scratch_scope scratch;
+    return outside_scratch(net_.forward(in));
   }
 
   /**
    * update weights and clear all gradients
    * */
   void update_weights(optimizer *opt) {
+    thread_budget_scope budget(num_threads_);
     for (auto l : net_) {
       l->update_weight(opt);
     }
@@ -226,7 +374,68 @@ class network {
    * executes forward-propagation and returns output
    **/
   std::vector<tensor_t> predict(const std::vector<tensor_t> &in) {
-    return fprop(in);
+    if (pipeline_micro_batch_ == 0) return fprop(in);
+    thread_budget_scope budget(num_threads_);
+    scratch_scope scratch;
+    return outside_scratch(net_.forward_pipelined(in, pipeline_micro_batch_));
+  }
+
+  /**
+   * executes forward-propagation keeping the activations in ctx, and
+   * returns output. unlike predict(in), several threads may run it on the
+   * same network at the same time, each with its own execution_context.
+   **/
+  vec_t predict(execution_context &ctx, const vec_t &in) {
+    if (in.size() != (size_t)in_data_size()) data_mismatch(**net_.begin(), in);
+    std::vector<tensor_t> a(1);
+    a[0].emplace_back(in);
+    return predict(ctx, a)[0][0];
+  }
+
+  /**
+   * executes forward-propagation keeping the activations in ctx, and
+   * returns output
+   **/
+  tensor_t predict(execution_context &ctx, const tensor_t &in) {
+    return predict(ctx, std::vector<tensor_t>{in})[0];
+  }
+
+  /**
+   * executes forward-propagation keeping the activations in ctx, and
+   * returns output
+   **/
+  std::vector<tensor_t> predict(execution_context &ctx,
+                                const std::vector<tensor_t> &in) {
+    thread_budget_scope budget(num_threads_);
+    scratch_scope scratch;
+    return outside_scratch(net_.forward(ctx, in));
+  }
+
+  /**
+   * executes forward-propagation on async_executor::instance() and returns
+   * the future output. every call has its own activation buffers, so any
+   * number of calls may be in flight; submitting blocks while the queue of
+   * the executor is full. the network must outlive the pending calls.
+   *
+   * @param on_done optional callback run on the worker once the output is
+   *                computed, with the output or the error that occurred
+   **/
+  std::future<vec_t> predict_async(
+    const vec_t &in,
+    std::function<void(const vec_t &, std::exception_ptr)> on_done = nullptr) {
+    if (in.size() != (size_t)in_data_size()) data_mismatch(**net_.begin(), in);
+    return predict_async_impl(in, on_done);
+  }
+
+  /**
+   * executes forward-propagation of a multi-input sample on
+   * async_executor::instance() and returns the future output
+   **/
+  std::future<tensor_t> predict_async(
+    const tensor_t &in,
+    std::function<void(const tensor_t &, std::exception_ptr)> on_done =
+      nullptr) {
+    return predict_async_impl(in, on_done);
   }
 
   /**
@@ -272,7 +481,8 @@ class network {
    * @param on_batch_enumerate callback for each mini-batch enumerate
    * @param on_epoch_enumerate callback for each epoch
    * @param reset_weights      set true if reset current network weights
-   * @param n_threads          number of tasks
+   * @param n_threads          maximum number of threads used for training
+   *                           (0: no limit)
    * @param t_cost             target costs (leave to nullptr in order to
    * assume
    * equal cost for every target)
@@ -289,7 +499,7 @@ class network {
              OnBatchEnumerate on_batch_enumerate,
              OnEpochEnumerate on_epoch_enumerate,
              const bool reset_weights         = false,
-             const int n_threads              = CNN_TASK_SIZE,
+             const int n_threads              = 0,
              const std::vector<vec_t> &t_cost = std::vector<vec_t>()) {
     if (inputs.size() != class_labels.size()) {
       return false;
@@ -297,14 +507,14 @@ class network {
     if (inputs.size() < batch_size || class_labels.size() < batch_size) {
       return false;
     }
-    std::vector<tensor_t> input_tensor, output_tensor, t_cost_tensor;
-    normalize_tensor(inputs, input_tensor);
+    // the data set is read in place, only the labels are converted
+    std::vector<tensor_t> output_tensor;
     normalize_tensor(class_labels, output_tensor);
-    if (!t_cost.empty()) normalize_tensor(t_cost, t_cost_tensor);
 
-    return fit<Error>(optimizer, input_tensor, output_tensor, batch_size, epoch,
+    return fit<Error>(optimizer, sample_view(inputs),
+                      sample_view(output_tensor), batch_size, epoch,
                       on_batch_enumerate, on_epoch_enumerate, reset_weights,
-                      n_threads, t_cost_tensor);
+                      n_threads, sample_view(t_cost));
   }
 
   /**
@@ -354,7 +564,8 @@ class network {
    * @param on_batch_enumerate callback for each mini-batch enumerate
    * @param on_epoch_enumerate callback for each epoch
    * @param reset_weights      set true if reset current network weights
-   * @param n_threads          number of tasks
+   * @param n_threads          maximum number of threads used for training
+   *                           (0: no limit)
    * @param t_cost             target costs (leave to nullptr in order to
    * assume
    * equal cost for every target)
@@ -373,16 +584,15 @@ class network {
            OnBatchEnumerate on_batch_enumerate,
            OnEpochEnumerate on_epoch_enumerate,
            const bool reset_weights     = false,
-           const int n_threads          = CNN_TASK_SIZE,
+           const int n_threads          = 0,
            const std::vector<U> &t_cost = std::vector<U>()) {
-    std::vector<tensor_t> input_tensor, output_tensor, t_cost_tensor;
-    normalize_tensor(inputs, input_tensor);
-    normalize_tensor(desired_outputs, output_tensor);
-    if (!t_cost.empty()) normalize_tensor(t_cost, t_cost_tensor);
-
-    return fit<Error>(optimizer, input_tensor, output_tensor, batch_size, epoch,
-                      on_batch_enumerate, on_epoch_enumerate, reset_weights,
-                      n_threads, t_cost_tensor);
+    // the data set is read in place, only labels are converted
+    std::vector<tensor_t> label_tensor, label_cost_tensor;
+    return fit<Error>(optimizer, sample_view(inputs),
+                      target_view(desired_outputs, label_tensor), batch_size,
+                      epoch, on_batch_enumerate, on_epoch_enumerate,
+                      reset_weights, n_threads,
+                      target_view(t_cost, label_cost_tensor));
   }
 
   /**
@@ -435,12 +645,140 @@ class network {
    * set the netphase to train or test
    * @param phase phase of network, could be train or test
    */
-  void set_netphase(net_phase phase) {
-    for (auto n : net_) {
-      n->set_context(phase);
+  void set_netphase(net_phase phase) { net_.set_phase(phase); }
+
+  /**
+   * share the buffers of activations which are never needed at the same
+   * time during inference (test phase). peak activation memory then
+   * covers a few layers instead of the whole network:
+   *
+   *     net.set_memory_planning(true);
+   *     net.set_netphase(net_phase::test);
+   *     auto y = net.predict(x);
+   *
+   * the outputs of the intermediate layers are overwritten by the
+   * following layers, and bprop throws until the train phase is set.
+   * graph networks run their layers one at a time meanwhile.
+   **/
+  void set_memory_planning(bool enabled) {
+    net_.set_memory_planning(enabled);
+  }
+
+  bool memory_planning() const { return net_.memory_planning(); }
+
+  /**
+   * activation memory with and without the memory plan, for the given
+   * batch size
+   **/
+  memory_usage activation_memory(size_t batch_size = 1) {
+    return net_.activation_memory(batch_size);
+  }
+
+  /**
+   * trade computation for memory while training (gradient checkpointing):
+   * only the outputs of a few checkpoint layers, about every sqrt(N)
+   * layers, are kept between fprop and bprop. the others are released
+   * during fprop and recomputed by bprop, one segment at a time:
+   *
+   *     net.set_checkpointing(true);
+   *     net.set_checkpoint(3, true);  // always keep the outputs of net[3]
+   *     net.fit<mse>(opt, x, y, 256, 10);
+   *
+   * the gradients are the same. layers which can not run twice (dropout,
+   * batch normalization, recurrent) always keep their outputs, and graph
+   * networks run their layers one at a time meanwhile.
+   **/
+  void set_checkpointing(bool enabled) { net_.set_checkpointing(enabled); }
+
+  bool checkpointing() const { return net_.checkpointing(); }
+
+  /**
+   * keep (true) or recompute (false) the outputs of the index-th layer
+   * when checkpointing, instead of the automatic choice
+   **/
+  void set_checkpoint(size_t index, bool keep) {
+    net_.set_checkpoint(index, keep);
+  }
+
+  bool is_checkpoint(size_t index) { return net_.is_checkpoint(index); }
+
+  /**
+   * let activation layers overwrite their input instead of writing to a
+   * buffer of their own, when no other layer reads it. relu, sigmoid, tanh
+   * and the other activations whose gradient is computed from their output
+   * support it:
+   *
+   *     net << fc(100, 200) << relu() << fc(200, 10);
+   *     net.set_in_place_activations(true);  // relu writes over fc's output
+   *
+   * this saves one activation buffer, and one pass over it, per
+   * activation. the outputs of the layers before these activations then
+   * hold the activated values after fprop.
+   **/
+  void set_in_place_activations(bool enabled) {
+    net_.set_in_place_activations(enabled);
+  }
+
+  bool in_place_activations() const { return net_.in_place_activations(); }
+
+  /**
+   * pass the activations of a frozen network between convolutions, max
+   * poolings and the activation layers between them in the channel-blocked
+   * layout (NCHW8c with AVX, NCHW4c with SSE), where one SIMD register
+   * holds the same pixel of consecutive channels:
+   *
+   *     net.freeze();
+   *     net.set_channel_blocking(true);
+   *
+   * the layers only change layout where they run faster that way, and
+   * never while they can run backward: the setting waits for freeze().
+   * the inputs and outputs of the network stay planar, the outputs of the
+   * layers in between are blocked.
+   **/
+  void set_channel_blocking(bool enabled) {
+    net_.set_channel_blocking(enabled);
+  }
+
+  bool channel_blocking() const { return net_.channel_blocking(); }
+
+  /**
+   * convert the network for inference only: release every gradient, the
+   * buffers of the backward passes and the dropout masks, stop clearing
+   * gradients in forward, and share the activations (see
+   * set_memory_planning and set_in_place_activations). roughly halves the
+   * memory of a deployed model. layers added to a frozen network are
+   * frozen too.
+   *
+   * @param opt optimizer used for training, whose state is released too
+   **/
+  void freeze(optimizer *opt = nullptr) {
+    if (!frozen_) {
+      unfrozen_in_place_activations_ = net_.in_place_activations();
+      unfrozen_memory_planning_      = net_.memory_planning();
+      frozen_                        = true;
     }
+    freeze_layers();
+    net_.set_in_place_activations(true);
+    net_.set_memory_planning(true);
+    if (opt) opt->reset();
+  }
+
+  /**
+   * allocate the gradients again, so that the network can be trained.
+   * memory planning and in-place activations go back to their settings
+   * before freeze().
+   **/
+  void unfreeze() {
+    if (frozen_) net_.set_memory_planning(unfrozen_memory_planning_);
+    for (auto l : net_) l->set_inference_only(false);
+    if (frozen_) net_.set_in_place_activations(unfrozen_in_place_activations_);
+    frozen_ = false;
+    // and go back to the planar layout for backward
+    net_.set_channel_blocking(net_.channel_blocking());
   }
 
+  bool frozen() const { return frozen_; }
+
   /**
    * request to finish an ongoing training
    *
@@ -803,6 +1141,7 @@ class network {
     if (what == content_type::model ||
         what == content_type::weights_and_model) {
       net_.load_model(ar);
+      if (frozen_) freeze_layers();
     }
     if (what == content_type::weights ||
         what == content_type::weights_and_model) {
@@ -811,6 +1150,30 @@ class network {
   }
 
  protected:
+  void freeze_layers() {
+    set_netphase(net_phase::test);
+    for (auto l : net_) l->set_inference_only(true);
+    // the layers may change layout now that they never run backward
+    net_.set_channel_blocking(net_.channel_blocking());
+  }
+
+  template <typename T>
+  std::future<T> predict_async_impl(
+    const T &in, std::function<void(const T &, std::exception_ptr)> on_done) {
+    return async_executor::instance().submit([this, in, on_done]() {
+      execution_context ctx;
+      T out;
+      try {
+        out = predict(ctx, in);
+      } catch (...) {
+        if (on_done) on_done(T(), std::current_exception());
+        throw;
+      }
+      if (on_done) on_done(out, nullptr);
+      return out;
+    });
+  }
+
   float_t fprop_max(const vec_t &in) {
     const vec_t &prediction = fprop(in);
     return *std::max_element(std::begin(prediction), std::end(prediction));
@@ -821,6 +1184,13 @@ class network {
   }
 
  private:
+  // a copy of outputs allocated from the scratch arena, taking its memory
+  // from the heap (copies of vectors do), to be returned once the scope ends
+  static std::vector<tensor_t> outside_scratch(
+    const std::vector<tensor_t> &out) {
+    return out;
+  }
+
   template <typename Layer>
   friend network<sequential> &operator<<(network<sequential> &n, Layer &&l);
 
@@ -838,32 +1208,64 @@ class network {
             typename OnBatchEnumerate,
             typename OnEpochEnumerate>
   bool fit(Optimizer &optimizer,
-           const std::vector<tensor_t> &inputs,
-           const std::vector<tensor_t> &desired_outputs,
+           const sample_view &inputs,
+           const sample_view &desired_outputs,
            size_t batch_size,
            int epoch,
            OnBatchEnumerate on_batch_enumerate,
            OnEpochEnumerate on_epoch_enumerate,
-           const bool reset_weights            = false,
-           const int n_threads                 = CNN_TASK_SIZE,
-           const std::vector<tensor_t> &t_cost = std::vector<tensor_t>()) {
+           const bool reset_weights,
+           const int n_threads,
+           const sample_view &t_cost) {
     // check_training_data(in, t);
+    if (frozen()) {
+      throw nn_error("the network is frozen, call unfreeze() to train it");
+    }
     check_target_cost_matrix(desired_outputs, t_cost);
+    thread_budget_scope budget(n_threads > 0 ? static_cast<size_t>(n_threads)
+                                             : 0);
     set_netphase(net_phase::train);
     net_.setup(reset_weights);
 
     for (auto n : net_) n->set_parallelize(true);
     optimizer.reset();
     stop_training_ = false;
-    in_batch_.resize(batch_size);
-    t_batch_.resize(batch_size);
+    if (communicator_ && communicator_->size() > 1) {
+      fit_distributed<Error>(optimizer, inputs, desired_outputs, batch_size,
+                             epoch, on_batch_enumerate, on_epoch_enumerate,
+                             t_cost);
+      set_netphase(net_phase::test);
+      return true;
+    }
+    if (training_mode_ == training_mode::hogwild) {
+      fit_hogwild<Error>(optimizer, inputs, desired_outputs, batch_size, epoch,
+                         on_batch_enumerate, on_epoch_enumerate, t_cost);
+      set_netphase(net_phase::test);
+      return true;
+    }
+    std::vector<std::unique_ptr<network>> replicas;
+    if (training_mode_ == training_mode::data_parallel) {
+      size_t num_workers =
+        training_workers_ != 0 ? training_workers_ : get_num_threads();
+      num_workers = std::min(num_workers, batch_size);
+      for (size_t i = 0; i < num_workers; i++) {
+        replicas.push_back(replicate());
+      }
+    }
     for (int iter = 0; iter < epoch && !stop_training_; iter++) {
       for (size_t i = 0; i < inputs.size() && !stop_training_;
            i += batch_size) {
-        train_once<Error>(
-          optimizer, &inputs[i], &desired_outputs[i],
-          static_cast<int>(std::min(batch_size, (size_t)inputs.size() - i)),
-          n_threads, get_target_cost_sample_pointer(t_cost, i));
+        const size_t size = std::min(batch_size, inputs.size() - i);
+        if (replicas.size() > 1) {
+          train_data_parallel<Error>(optimizer, replicas,
+                                     inputs.slice(i, size),
+                                     desired_outputs.slice(i, size),
+                                     cost_slice(t_cost, i, size));
+        } else {
+          train_once<Error>(optimizer, inputs.slice(i, size),
+                            desired_outputs.slice(i, size),
+                            cost_slice(t_cost, i, size));
+        }
         on_batch_enumerate();
 
         /* if (i % 100 == 0 && layers_.is_exploded()) {
@@ -878,24 +1280,305 @@ class network {
     return true;
   }
 
+  template <typename Error,
+            typename Optimizer,
+            typename OnBatchEnumerate,
+            typename OnEpochEnumerate>
+  void fit_hogwild(Optimizer &optimizer,
+                   const sample_view &inputs,
+                   const sample_view &desired_outputs,
+                   size_t batch_size,
+                   int epoch,
+                   OnBatchEnumerate &on_batch_enumerate,
+                   OnEpochEnumerate &on_epoch_enumerate,
+                   const sample_view &t_cost) {
+    const size_t num_batches = (inputs.size() + batch_size - 1) / batch_size;
+    size_t num_workers =
+      training_workers_ != 0 ? training_workers_ : get_num_threads();
+    num_workers = std::max<size_t>(1, std::min(num_workers, num_batches));
+
+    std::vector<std::unique_ptr<network>> replicas;
+    for (size_t i = 0; i < num_workers; i++) replicas.push_back(replicate());
+
+    // the state of the layers besides the weights (e.g. the moving
+    // statistics of batch normalization) is kept by this network, which
+    // takes over the statistics of every minibatch of a replica
+    std::mutex state_mutex;
+    auto train_batch = [&](network &net, size_t batch) {
+      const size_t first = batch * batch_size;
+      const size_t size  = std::min(batch_size, inputs.size() - first);
+      scratch_scope scratch;
+      net.template bprop<Error>(net.fprop(inputs.slice(first, size)),
+                                desired_outputs.slice(first, size),
+                                cost_slice(t_cost, first, size));
+      net.net_.update_weights(&optimizer);
+      if (&net == this) return;
+
+      std::lock_guard<std::mutex> lock(state_mutex);
+      for (size_t i = 0; i < net_.size(); i++) {
+        net_[i]->merge_batch_statistics(*net.net_[i], size, 0);
+        net_[i]->post_update();
+      }
+    };
+
+    std::mutex callback_mutex;
+    for (int iter = 0; iter < epoch && !stop_training_; iter++) {
+      size_t first_batch = 0;
+      if (iter == 0 && num_batches > 0) {
+        // stateful optimizers create their per-weight state on the first
+        // update, which must not happen concurrently
+        train_batch(*this, 0);
+        on_batch_enumerate();
+        first_batch = 1;
+      }
+
+      std::atomic<size_t> next_batch(first_batch);
+      std::atomic<bool> stop(stop_training_);
+      for_i(true, num_workers,
+            [&](size_t worker) {
+              network &replica = *replicas[worker];
+              for (size_t b = next_batch++; b < num_batches && !stop;
+                   b = next_batch++) {
+                train_batch(replica, b);
+
+                std::lock_guard<std::mutex> lock(callback_mutex);
+                on_batch_enumerate();
+                if (stop_training_) stop = true;
+              }
+            },
+            1);
+      on_epoch_enumerate();
+    }
+  }
+
+  template <typename Error,
+            typename Optimizer,
+            typename OnBatchEnumerate,
+            typename OnEpochEnumerate>
+  void fit_distributed(Optimizer &optimizer,
+                       const sample_view &inputs,
+                       const sample_view &desired_outputs,
+                       size_t batch_size,
+                       int epoch,
+                       OnBatchEnumerate &on_batch_enumerate,
+                       OnEpochEnumerate &on_epoch_enumerate,
+                       const sample_view &t_cost) {
+    communicator &comm       = *communicator_;
+    const size_t num_batches = (inputs.size() + batch_size - 1) / batch_size;
+
+    // a process running fewer steps would leave the others waiting
+    std::vector<uint64_t> steps(comm.size(), 0);
+    steps[comm.rank()] = static_cast<uint64_t>(num_batches) * epoch;
+    comm.allreduce_sum(&steps[0], steps.size());
+    for (auto n : steps) {
+      if (n != steps[comm.rank()]) {
+        throw nn_error(
+          "every process must train on the same number of minibatches");
+      }
+    }
+
+    // start from the weights of rank 0
+    std::vector<float_t> buffer;
+    for (auto l : net_) {
+      for (auto w : l->weights()) {
+        buffer.insert(buffer.end(), w->begin(), w->end());
+      }
+    }
+    comm.broadcast(buffer.data(), buffer.size(), 0);
+    auto src = buffer.begin();
+    for (auto l : net_) {
+      for (auto w : l->weights()) {
+        std::copy(src, src + w->size(), w->begin());
+        src += w->size();
+      }
+    }
+
+    bool stop = false;
+    for (int iter = 0; iter < epoch && !stop; iter++) {
+      for (size_t b = 0; b < num_batches && !stop; b++) {
+        const size_t first = b * batch_size;
+        const size_t size  = std::min(batch_size, inputs.size() - first);
+        {
+          scratch_scope scratch;
+          bprop<Error>(fprop(inputs.slice(first, size)),
+                       desired_outputs.slice(first, size),
+                       cost_slice(t_cost, first, size));
+        }
+        merge_weight_grads();
+
+        // the gradients, followed by the number of stop requests
+        buffer.clear();
+        for (auto l : net_) {
+          for (tensor_t *grad : l->weights_grads()) {
+            buffer.insert(buffer.end(), (*grad)[0].begin(), (*grad)[0].end());
+          }
+        }
+        buffer.push_back(stop_training_ ? float_t(1) : float_t(0));
+        comm.allreduce_sum(buffer.data(), buffer.size());
+
+        src = buffer.begin();
+        for (auto l : net_) {
+          for (tensor_t *grad : l->weights_grads()) {
+            grad->resize(1);
+            std::copy(src, src + (*grad)[0].size(), (*grad)[0].begin());
+            src += (*grad)[0].size();
+          }
+        }
+        stop = buffer.back() > float_t(0);
+
+        net_.update_weights(&optimizer);
+        on_batch_enumerate();
+      }
+
+      // the moving statistics (batch normalization) have seen the data of
+      // this process only
+      buffer.clear();
+      for (auto l : net_) {
+        vec_t statistics = l->statistics();
+        buffer.insert(buffer.end(), statistics.begin(), statistics.end());
+      }
+      comm.allreduce_sum(buffer.data(), buffer.size());
+      src = buffer.begin();
+      for (auto l : net_) {
+        vec_t statistics = l->statistics();
+        if (statistics.empty()) continue;
+        for (auto &v : statistics) v = *src++ / float_t(comm.size());
+        l->set_statistics(statistics);
+      }
+      on_epoch_enumerate();
+    }
+    stop_training_ = stop;
+  }
+
   /**
-   * train on one minibatch
-   *
-   * @param size is the number of data points to use in this batch
+   * sum the weight gradients of every layer over the samples of the
+   * minibatch, into the gradient of the first sample
+   **/
+  void merge_weight_grads() {
+    for (auto l : net_) {
+      for (tensor_t *grad : l->weights_grads()) {
+        vec_t &sum = (*grad)[0];
+        for (size_t s = 1; s < grad->size(); s++) {
+          vectorize::reduce<float_t>(&(*grad)[s][0], sum.size(), &sum[0]);
+        }
+      }
+    }
+  }
+
+  /**
+   * trains on one minibatch, split over the given replicas. the gradients
+   * of the shards are summed into the weight gradients of this network,
+   * which is then updated once.
    */
   template <typename E, typename Optimizer>
-  void train_once(Optimizer &optimizer,
-                  const tensor_t *in,
-                  const tensor_t *t,
-                  int size,
-                  const int nbThreads,
-                  const tensor_t *t_cost) {
-    if (size == 1) {
-      bprop<E>(fprop(in[0]), t[0], t_cost ? t_cost[0] : tensor_t());
-      net_.update_weights(&optimizer);
-    } else {
-      train_onebatch<E>(optimizer, in, t, size, nbThreads, t_cost);
+  void train_data_parallel(Optimizer &optimizer,
+                           std::vector<std::unique_ptr<network>> &replicas,
+                           const sample_view &in,
+                           const sample_view &t,
+                           const sample_view &t_cost) {
+    const size_t batch_size = in.size();
+    const size_t num_shards = std::min(replicas.size(), batch_size);
+
+    // forward/backward, then sum the gradients of each shard over its
+    // samples
+    for_i(true, num_shards,
+          [&](size_t shard) {
+            const size_t first = batch_size * shard / num_shards;
+            const size_t last  = batch_size * (shard + 1) / num_shards;
+            network &replica   = *replicas[shard];
+            scratch_scope scratch;
+            replica.template bprop<E>(
+              replica.fprop(in.slice(first, last - first)),
+              t.slice(first, last - first),
+              cost_slice(t_cost, first, last - first));
+            replica.merge_weight_grads();
+          },
+          1);
+
+    // tree reduction: after the round of the given stride, shard i holds
+    // the sum of shards [i, i + 2 * stride)
+    for (size_t stride = 1; stride < num_shards; stride *= 2) {
+      const size_t num_pairs = (num_shards + stride - 1) / (2 * stride);
+      for_i(true, num_pairs,
+            [&](size_t pair) {
+              const size_t dst = pair * 2 * stride;
+              auto src_layer   = replicas[dst + stride]->net_.begin();
+              for (auto l : replicas[dst]->net_) {
+                auto dst_grads = l->weights_grads();
+                auto src_grads = (*src_layer++)->weights_grads();
+                for (size_t i = 0; i < dst_grads.size(); i++) {
+                  vec_t &sum = (*dst_grads[i])[0];
+                  vectorize::reduce<float_t>(&(*src_grads[i])[0][0],
+                                             sum.size(), &sum[0]);
+                }
+              }
+            },
+            1);
     }
+
+    auto src_layer = replicas[0]->net_.begin();
+    for (auto l : net_) {
+      auto dst_grads = l->weights_grads();
+      auto src_grads = (*src_layer++)->weights_grads();
+      for (size_t i = 0; i < dst_grads.size(); i++) {
+        dst_grads[i]->resize(1);
+        (*dst_grads[i])[0] = (*src_grads[i])[0];
+      }
+    }
+    for (size_t shard = 0; shard < num_shards; shard++) {
+      for (auto l : replicas[shard]->net_) l->clear_grads();
+    }
+
+    // the layers of this network did not run forward: their statistics
+    // are those of the whole minibatch, over the shards
+    size_t merged = 0;
+    for (size_t shard = 0; shard < num_shards; shard++) {
+      const size_t first = batch_size * shard / num_shards;
+      const size_t last  = batch_size * (shard + 1) / num_shards;
+      for (size_t i = 0; i < net_.size(); i++) {
+        net_[i]->merge_batch_statistics(*replicas[shard]->net_[i],
+                                        last - first, merged);
+      }
+      merged += last - first;
+    }
+    net_.update_weights(&optimizer);
+  }
+
+  /**
+   * a copy of the architecture of this network, training the weights of
+   * this network
+   **/
+  std::unique_ptr<network> replicate() const {
+#ifndef CNN_NO_SERIALIZATION
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive oa(ss);
+      to_archive(oa, content_type::model);
+    }
+    std::unique_ptr<network> replica(new network(name_));
+    {
+      cereal::BinaryInputArchive ia(ss);
+      replica->from_archive(ia, content_type::model);
+    }
+    replica->net_.setup(false);
+
+    auto src = net_.begin();
+    for (auto dst : replica->net_) {
+      dst->share_weights(**src);
+      dst->set_trainable((*src)->trainable());
+      dst->set_parallelize((*src)->parallelize());
+      ++src;
+    }
+    replica->set_netphase(net_phase::train);
+    replica->net_.set_checkpointing(net_.checkpointing());
+    replica->net_.set_in_place_activations(net_.in_place_activations());
+    for (auto &o : net_.checkpoint_overrides()) {
+      replica->net_.set_checkpoint(o.first, o.second);
+    }
+    return replica;
+#else
+    throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
   }
 
   /**
@@ -903,26 +1586,37 @@ class network {
    * calculate
    * the gradient of the loss function with respect to the network parameters
    * (weights),
-   * then calls the optimizer algorithm to update the weights
-   *
-   * @param batch_size the number of data points to use in this batch
+   * then calls the optimizer algorithm to update the weights. the samples
+   * are read in place.
    */
   template <typename E, typename Optimizer>
-  void train_onebatch(Optimizer &optimizer,
-                      const tensor_t *in,
-                      const tensor_t *t,
-                      int batch_size,
-                      const int num_tasks,
-                      const tensor_t *t_cost) {
-    CNN_UNREFERENCED_PARAMETER(num_tasks);
-    std::copy(&in[0], &in[0] + batch_size, &in_batch_[0]);
-    std::copy(&t[0], &t[0] + batch_size, &t_batch_[0]);
-    std::vector<tensor_t> t_cost_batch =
-      t_cost ? std::vector<tensor_t>(&t_cost[0], &t_cost[0] + batch_size)
-             : std::vector<tensor_t>();
-
-    bprop<E>(fprop(in_batch_), t_batch_, t_cost_batch);
-    net_.update_weights(&optimizer);
+  void train_once(Optimizer &optimizer,
+                  const sample_view &in,
+                  const sample_view &t,
+                  const sample_view &t_cost) {
+    // the temporaries of the step, outputs and loss gradients included,
+    // come from the scratch arena (see scratch_scope)
+    scratch_scope scratch;
+    bprop_and_update<E>(optimizer, fprop(in), t, t_cost);
+  }
+
+  /**
+   * backward propagation followed by the update of the weights, the two
+   * overlapping if set_overlap_updates(true) was called
+   */
+  template <typename E, typename Optimizer>
+  void bprop_and_update(Optimizer &optimizer,
+                        const std::vector<tensor_t> &out,
+                        const sample_view &t,
+                        const sample_view &t_cost) {
+    if (!overlap_updates_) {
+      bprop<E>(out, t, t_cost);
+      net_.update_weights(&optimizer);
+      return;
+    }
+    thread_budget_scope budget(num_threads_);
+    std::vector<tensor_t> delta = gradient<E>(out, t, t_cost);
+    net_.backward_and_update(delta, &optimizer);
   }
 
   //    template <typename E>
@@ -1033,8 +1727,8 @@ class network {
     }
   }
 
-  void check_target_cost_matrix(const std::vector<tensor_t> &t,
-                                const std::vector<tensor_t> &t_cost) {
+  void check_target_cost_matrix(const sample_view &t,
+                                const sample_view &t_cost) {
     if (!t_cost.empty()) {
       if (t.size() != t_cost.size()) {
         throw nn_error(
@@ -1043,7 +1737,14 @@ class network {
       }
 
       for (size_t i = 0, end = t.size(); i < end; i++) {
-        check_target_cost_element(t[i], t_cost[i]);
+        if (t.channels(i) != t_cost.channels(i)) {
+          throw nn_error(
+            "if target cost is supplied for a regression task, "
+            "its shape must be identical to the target data");
+        }
+        for (size_t c = 0; c < t.channels(i); c++) {
+          check_target_cost_element(t.at(i, c), t_cost.at(i, c));
+        }
       }
     }
   }
@@ -1057,24 +1758,27 @@ class network {
     }
   }
 
-  void check_target_cost_element(const tensor_t &t, const tensor_t &t_cost) {
-    if (t.size() != t_cost.size()) {
-      throw nn_error(
-        "if target cost is supplied for a regression task, "
-        "its shape must be identical to the target data");
-    }
-    for (size_t i = 0; i < t.size(); i++)
-      check_target_cost_element(t[i], t_cost[i]);
+  // the costs of a minibatch, if any
+  static sample_view cost_slice(const sample_view &t_cost,
+                                size_t first,
+                                size_t count) {
+    return t_cost.empty() ? sample_view() : t_cost.slice(first, count);
   }
 
-  const tensor_t *get_target_cost_sample_pointer(
-    const std::vector<tensor_t> &t_cost, size_t i) {
-    if (!t_cost.empty()) {
-      assert(i < t_cost.size());
-      return &(t_cost[i]);
-    } else {
-      return nullptr;
-    }
+  sample_view target_view(const std::vector<tensor_t> &t,
+                          std::vector<tensor_t> &) {
+    return sample_view(t);
+  }
+
+  sample_view target_view(const std::vector<vec_t> &t,
+                          std::vector<tensor_t> &) {
+    return sample_view(t);
+  }
+
+  sample_view target_view(const std::vector<label_t> &t,
+                          std::vector<tensor_t> &converted) {
+    normalize_tensor(t, converted);
+    return sample_view(converted);
   }
 
   void normalize_tensor(const std::vector<tensor_t> &inputs,
@@ -1099,9 +1803,16 @@ class network {
 
   std::string name_;
   NetType net_;
+  size_t num_threads_;
+  size_t pipeline_micro_batch_;
+  training_mode training_mode_;
+  size_t training_workers_;
+  bool overlap_updates_;
+  std::shared_ptr<communicator> communicator_;
   bool stop_training_;
-  std::vector<tensor_t> in_batch_;
-  std::vector<tensor_t> t_batch_;
+  bool frozen_;
+  bool unfrozen_in_place_activations_;
+  bool unfrozen_memory_planning_;
 };
 
 /**
@@ -1148,6 +1859,7 @@ inline std::vector<vec_t> image2vec(const float_t *data,
 template <typename Layer>
 network<sequential> &operator<<(network<sequential> &n, Layer &&l) {
   n.net_.add(std::forward<Layer>(l));
+  if (n.frozen_) n.freeze_layers();
   return n;
 }
 
@@ -1169,6 +1881,7 @@ inline void construct_graph(network<graph> &graph,
                             const std::vector<layer *> &inputs,
                             const std::vector<layer *> &outputs) {
   graph.net_.construct(inputs, outputs);
+  if (graph.frozen_) graph.freeze_layers();
 }
 
 inline void construct_graph(
@@ -1184,6 +1897,7 @@ inline void construct_graph(
                  shared2ptr);
 
   graph.net_.construct(in_ptr, out_ptr);
+  if (graph.frozen_) graph.freeze_layers();
 }
 
 }  // namespace tiny_dnn
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <iomanip>
 #include <memory>
 #include <numeric>
@@ -18,6 +19,7 @@
 #include <vector>
 
 #include "tiny_dnn/optimizers/optimizer.h"
+#include "tiny_dnn/util/batch_storage.h"
 #include "tiny_dnn/util/product.h"
 #include "tiny_dnn/util/util.h"
 #include "tiny_dnn/util/weight_init.h"
@@ -92,6 +94,25 @@ class edge {
     size_t sz             = grad_head.size();
     dst->resize(sz);
     float_t *pdst = &(*dst)[0];
+
+    batch_matrix m;
+    if (grad_.size() > 1 && as_matrix(grad_, &m)) {
+      // sum the rows of the batch a block of columns at a time, which
+      // stays in L1 while every sample is added, the blocks in parallel
+      const size_t block  = 2048;
+      const size_t blocks = (sz + block - 1) / block;
+      for_i(blocks >= 4, blocks, [&](size_t b) {
+        const size_t first = b * block;
+        const size_t n     = std::min(block, sz - first);
+        const float_t *src = m.data + first;
+        std::copy(src, src + n, pdst + first);
+        for (size_t sample = 1; sample < m.rows; sample++) {
+          vectorize::reduce<float_t>(src + sample * m.stride, n, pdst + first);
+        }
+      });
+      return;
+    }
+
     // dst = grad_[0]
     std::copy(grad_head.begin(), grad_head.end(), pdst);
     // @todo consider adding parallelism
@@ -110,9 +131,53 @@ class edge {
     }
   }
 
-  tensor_t *get_data() { return &data_; }
+  tensor_t *get_data() {
+    return data_owner_ ? data_owner_->get_data() : &data_;
+  }
+
+  const tensor_t *get_data() const {
+    return data_owner_ ? data_owner_->get_data() : &data_;
+  }
+
+  /**
+   * use the data of another edge from now on, keeping the gradients of
+   * this one. lets replicas of a network train the same weights.
+   **/
+  void share_data(const edgeptr_t &owner) {
+    data_owner_ = owner;
+    tensor_t().swap(data_);
+  }
+
+  /**
+   * stop using the data of another edge, starting again from one sample
+   **/
+  void unshare_data() {
+    if (!data_owner_) return;
+    data_owner_.reset();
+    data_ = tensor_t{vec_t(shape_.size())};
+  }
 
-  const tensor_t *get_data() const { return &data_; }
+  /**
+   * edge whose data this one uses, or nullptr
+   **/
+  const edgeptr_t &data_owner() const { return data_owner_; }
+
+  /**
+   * number of changes made to the data, counted by the layers whenever
+   * they update or hand out their weights. kernels caching a transform of
+   * the weights compare it instead of the weights themselves.
+   **/
+  size_t version() const {
+    return data_owner_ ? data_owner_->version() : version_.load();
+  }
+
+  void bump_version() {
+    if (data_owner_) {
+      data_owner_->bump_version();
+    } else {
+      version_++;
+    }
+  }
 
   tensor_t *get_gradient() { return &grad_; }
 
@@ -131,8 +196,10 @@ class edge {
   vector_type vtype_;
   tensor_t data_;
   tensor_t grad_;
-  node *prev_;                // previous node, "producer" of this tensor
-  std::vector<node *> next_;  // next nodes, "consumers" of this tensor
+  edgeptr_t data_owner_;            // edge whose data is used instead of data_
+  std::atomic<size_t> version_{0};  // see version()
+  node *prev_;                      // previous node, "producer" of this tensor
+  std::vector<node *> next_;        // next nodes, "consumers" of this tensor
 };
 
 inline std::vector<node *> node::prev_nodes() const {
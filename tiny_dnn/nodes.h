@@ -7,9 +7,18 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>  // NOLINT
 #include <memory>
+#include <mutex>   // NOLINT
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -18,8 +27,12 @@
 #include <cereal/types/utility.hpp>
 #endif
 
+#include "tiny_dnn/checkpoint_plan.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/memory_plan.h"
 #include "tiny_dnn/optimizers/optimizer.h"
+#include "tiny_dnn/util/async_executor.h"
+#include "tiny_dnn/util/sample_view.h"
 #include "tiny_dnn/util/util.h"
 
 namespace cereal {
@@ -86,9 +99,73 @@ class nodes {
   /**
    * propagate gradient
    * @param first        : gradient of cost function(dE/dy)
-   * @param worker_index : id of worker-task
+   * @param on_backward  : called with every layer once its backward pass is
+   *                       done, possibly from several threads at once
    **/
-  virtual void backward(const std::vector<tensor_t> &first) = 0;
+  virtual void backward(
+    const std::vector<tensor_t> &first,
+    const std::function<void(layer *)> &on_backward = nullptr) = 0;
+
+  /**
+   * propagate gradient, and update the weights of every layer on another
+   * thread (see weight_updater) as soon as its backward pass is done, while
+   * the previous layers are still propagating. this hides the cost of the
+   * optimizer behind the backward pass. the layers are updated one at a
+   * time, from the last one to the first one.
+   **/
+  void backward_and_update(const std::vector<tensor_t> &first,
+                           optimizer *opt) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<layer *> pending;
+    bool done = false;
+    std::exception_ptr error;
+
+    std::future<void> updater = weight_updater().submit([&] {
+      // leave the worker pool to the backward pass
+      thread_budget_scope budget(1);
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;) {
+        cv.wait(lock, [&] { return done || !pending.empty(); });
+        if (pending.empty()) return;
+        layer *l = pending.front();
+        pending.pop_front();
+        lock.unlock();
+        try {
+          if (!error) l->apply_weight_grads(opt);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+      }
+    });
+    auto finish = [&] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+      }
+      cv.notify_one();
+      updater.wait();
+    };
+
+    try {
+      backward(first, [&](layer *l) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          pending.push_back(l);
+        }
+        cv.notify_one();
+      });
+    } catch (...) {
+      finish();
+      throw;
+    }
+    finish();
+    if (error) std::rethrow_exception(error);
+
+    // the gradients of the data inputs, which nobody reads any more
+    for (auto l : nodes_) l->clear_grads();
+  }
 
   /**
    * @param first input  : data vectors
@@ -97,6 +174,37 @@ class nodes {
   virtual std::vector<tensor_t> forward(
     const std::vector<tensor_t> &first) = 0;  // NOLINT
 
+  /**
+   * same as forward(first), reading the samples in place
+   **/
+  virtual std::vector<tensor_t> forward(const sample_view &first) = 0;
+
+  /**
+   * forward propagation keeping every activation in ctx instead of the
+   * network. several threads may call it at the same time, each with its
+   * own context.
+   *
+   * @param ctx   buffers of this inference
+   * @param first input data vectors
+   **/
+  virtual std::vector<tensor_t> forward(
+    execution_context &ctx, const std::vector<tensor_t> &first) = 0;
+
+  /**
+   * forward propagation streaming the samples through the network in
+   * micro-batches, with consecutive layers (stages) working on different
+   * micro-batches at the same time. falls back to forward() for network
+   * types which do not support it.
+   *
+   * @param first            input data vectors
+   * @param micro_batch_size number of samples per micro-batch
+   **/
+  virtual std::vector<tensor_t> forward_pipelined(
+    const std::vector<tensor_t> &first, size_t micro_batch_size) {
+    CNN_UNREFERENCED_PARAMETER(micro_batch_size);
+    return forward(first);
+  }
+
   /**
    * update weights and clear all gradients
    **/
@@ -113,6 +221,114 @@ class nodes {
     for (auto l : nodes_) {
       l->setup(reset_weight);
     }
+    share_in_place();
+    block_channels();
+    if (!nodes_.empty()) plan_.build(nodes_, output_layers());
+  }
+
+  /**
+   * phase the layers run in. in the test phase, the activations may be
+   * shared as planned by the memory plan (see set_memory_planning).
+   **/
+  void set_phase(net_phase phase) {
+    phase_ = phase;
+    for (auto l : nodes_) {
+      l->set_context(phase);
+    }
+    if (!memory_planned()) plan_.release();
+  }
+
+  /**
+   * in the test phase, let activations which are never needed at the same
+   * time share their buffers. the outputs of the intermediate layers are
+   * then overwritten during forward, and backward can not run until the
+   * phase goes back to train.
+   **/
+  void set_memory_planning(bool enabled) {
+    memory_planning_ = enabled;
+    if (!memory_planned()) plan_.release();
+  }
+
+  bool memory_planning() const { return memory_planning_; }
+
+  /**
+   * in the train phase, keep the outputs of a few checkpoint layers only
+   * and recompute the others during backward (see checkpoint_plan), for
+   * about one more forward pass per training step. the checkpoints are
+   * chosen every sqrt(size()) layers, unless set_checkpoint says otherwise.
+   **/
+  void set_checkpointing(bool enabled) {
+    checkpointing_ = enabled;
+    checkpoints_.clear();
+  }
+
+  bool checkpointing() const { return checkpointing_; }
+
+  /**
+   * let the layers which can_run_in_place() (most activations) overwrite
+   * their input instead of writing to a buffer of their own, when no other
+   * layer reads it and the layer producing it does not need it for its
+   * own backward pass (or never runs backward, see
+   * layer::set_inference_only). the outputs of the layers before them are
+   * then overwritten during forward. the last layer of each pipeline stage
+   * (see sequential::forward_pipelined) keeps a buffer of its own.
+   **/
+  void set_in_place_activations(bool enabled) {
+    in_place_activations_ = enabled;
+    share_in_place();
+  }
+
+  bool in_place_activations() const { return in_place_activations_; }
+
+  /**
+   * let the layers with kernels for the channel-blocked layout (see
+   * kernels::channel_block), convolutions and max poolings, pass their
+   * activations to each other in that layout, through the elementwise
+   * layers between them. only the layers which never run backward (see
+   * layer::set_inference_only) change layout, and the inputs and outputs
+   * of the network stay planar. the layers at the border of a blocked
+   * part read or write the planar layout themselves, without reorders.
+   * the execution contexts prepared before must be cleared.
+   **/
+  void set_channel_blocking(bool enabled) {
+    channel_blocking_ = enabled;
+    block_channels();
+  }
+
+  bool channel_blocking() const { return channel_blocking_; }
+
+  /**
+   * make the layer at the given index a checkpoint (keep = true) or have
+   * its outputs recomputed (keep = false), instead of the automatic choice.
+   * some layers are checkpoints anyway (see checkpoint_plan).
+   **/
+  void set_checkpoint(size_t index, bool keep) {
+    if (index >= nodes_.size()) throw nn_error("layer index out of range");
+    checkpoint_overrides_[index] = keep;
+    checkpoints_.clear();
+  }
+
+  /**
+   * true if the outputs of the layer at the given index are kept during
+   * training with checkpointing
+   **/
+  bool is_checkpoint(size_t index) {
+    if (index >= nodes_.size()) throw nn_error("layer index out of range");
+    build_checkpoints();
+    return checkpoints_.is_checkpoint(index);
+  }
+
+  const std::unordered_map<size_t, bool> &checkpoint_overrides() const {
+    return checkpoint_overrides_;
+  }
+
+  /**
+   * activation memory needed with and without the memory plan for the
+   * given number of samples
+   **/
+  memory_usage activation_memory(size_t sample_count) {
+    if (!plan_.built() && !nodes_.empty()) plan_.build(nodes_, output_layers());
+    return plan_.usage(sample_count);
   }
 
   void clear_grads() {
@@ -214,6 +430,17 @@ class nodes {
   }
 
  protected:
+  /**
+   * threads running the weight updates of backward_and_update, kept for
+   * the whole process rather than started for every minibatch. separate
+   * from async_executor::instance(), whose workers may be the ones
+   * training.
+   **/
+  static async_executor &weight_updater() {
+    static async_executor executor;
+    return executor;
+  }
+
   template <typename T>
   void push_back(T &&node) {
     push_back_impl(
@@ -231,10 +458,10 @@ class nodes {
   // input:  [sample][channel][feature]
   // output: [channel][sample][feature]
   void reorder_for_layerwise_processing(
-    const std::vector<tensor_t> &input,
+    const sample_view &input,
     std::vector<std::vector<const vec_t *>> &output) {
     size_t sample_count  = input.size();
-    size_t channel_count = input[0].size();
+    size_t channel_count = input.channels();
 
     output.resize(channel_count);
     for (size_t i = 0; i < channel_count; ++i) {
@@ -242,13 +469,34 @@ class nodes {
     }
 
     for (size_t sample = 0; sample < sample_count; ++sample) {
-      assert(input[sample].size() == channel_count);
+      assert(input.channels(sample) == channel_count);
       for (size_t channel = 0; channel < channel_count; ++channel) {
-        output[channel][sample] = &input[sample][channel];
+        output[channel][sample] = &input.at(sample, channel);
       }
     }
   }
 
+  void reorder_for_layerwise_processing(
+    const std::vector<tensor_t> &input,
+    std::vector<std::vector<const vec_t *>> &output) {
+    reorder_for_layerwise_processing(sample_view(input), output);
+  }
+
+  // create every missing edge once per context, so that the concurrent
+  // forward(ctx, ...) calls never modify the graph
+  void prepare_context(execution_context &ctx) {
+    if (ctx.owner() == this) return;
+
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto l : nodes_) {
+      l->inputs();
+      l->outputs();
+    }
+    ctx.clear();
+    ctx.set_owner(this);
+  }
+
   template <typename T>
   void push_back_impl(T &&node, std::true_type) {  // is_rvalue_reference
     own_nodes_.push_back(
@@ -262,10 +510,184 @@ class nodes {
     nodes_.push_back(&node);
   }
 
+  /**
+   * layers whose outputs are read after the forward pass
+   **/
+  virtual std::vector<layer *> output_layers() const {
+    return std::vector<layer *>(1, nodes_.back());
+  }
+
+  bool memory_planned() const {
+    return memory_planning_ && phase_ == net_phase::test;
+  }
+
+  // share the activations as planned before a forward pass
+  void prepare_memory(size_t sample_count) {
+    if (!memory_planned()) return;
+    if (!plan_.built()) plan_.build(nodes_, output_layers());
+    plan_.apply(sample_count);
+  }
+
+  // make the outputs of the layers running in place use the data of their
+  // inputs, or give them buffers of their own again
+  void share_in_place() {
+    plan_.clear();
+    checkpoints_.clear();
+    const std::vector<layer *> outputs =
+      nodes_.empty() ? std::vector<layer *>() : output_layers();
+    for (auto l : nodes_) {
+      // a layer not connected yet gets its shape from its input later on
+      edgeptr_t in = l->prev()[0];
+      if (!in || !l->can_run_in_place()) continue;
+      edgeptr_t out = l->outputs()[0];
+      out->unshare_data();
+      if (!in_place_activations_ || in->next().size() != 1) continue;
+      if (std::find(stage_ends_.begin(), stage_ends_.end(), l) !=
+          stage_ends_.end()) {
+        continue;
+      }
+
+      layer *producer = dynamic_cast<layer *>(in->prev());
+      if (producer) {
+        if (std::find(nodes_.begin(), nodes_.end(), producer) ==
+              nodes_.end() ||
+            std::find(outputs.begin(), outputs.end(), producer) !=
+              outputs.end()) {
+          continue;
+        }
+        if (!producer->inference_only() && producer->backward_reads_output()) {
+          continue;
+        }
+      }
+      out->share_data(in);
+    }
+  }
+
+  // keep the activations between layers supporting it in the blocked
+  // layout: the edges read and written by such layers only, or by
+  // elementwise layers keeping the layout of their input
+  void block_channels() {
+    std::unordered_set<const edge *> blocked;
+    const std::vector<layer *> outputs =
+      nodes_.empty() ? std::vector<layer *>() : output_layers();
+    auto forward_only = [&](const node *n) {
+      const layer *l = dynamic_cast<const layer *>(n);
+      return l && l->inference_only() &&
+             std::find(nodes_.begin(), nodes_.end(), l) != nodes_.end();
+    };
+
+    for (auto l : nodes_) {
+      if (!channel_blocking_ || !forward_only(l) ||
+          std::find(outputs.begin(), outputs.end(), l) != outputs.end()) {
+        continue;
+      }
+      for (auto &e : l->next()) {
+        if (!e || e->next().empty()) continue;
+        if (std::all_of(e->next().begin(), e->next().end(), forward_only)) {
+          blocked.insert(e.get());
+        }
+      }
+    }
+
+    // drop the edges whose layers can not keep them blocked until none is
+    // left, elementwise layers following their neighbours
+    auto is_blocked = [&](const std::vector<edgeptr_t> &edges) {
+      return !edges.empty() && blocked.count(edges[0].get()) > 0;
+    };
+    auto writes_blocked = [&](const layer *l) {
+      return l->elementwise() ? is_blocked(l->prev())
+                              : l->supports_channel_blocking(false);
+    };
+    auto reads_blocked = [&](const node *n) {
+      const layer *l = static_cast<const layer *>(n);
+      return l->elementwise() ? is_blocked(l->next())
+                              : l->supports_channel_blocking(true);
+    };
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (auto e = blocked.begin(); e != blocked.end();) {
+        const auto &readers = (*e)->next();
+        if (writes_blocked(static_cast<const layer *>((*e)->prev())) &&
+            std::all_of(readers.begin(), readers.end(), reads_blocked)) {
+          ++e;
+        } else {
+          e       = blocked.erase(e);
+          changed = true;
+        }
+      }
+    }
+
+    for (auto l : nodes_) {
+      if (l->elementwise()) continue;
+      l->set_channel_blocking(is_blocked(l->prev()), is_blocked(l->next()));
+    }
+  }
+
+  bool checkpointed() const {
+    return checkpointing_ && phase_ == net_phase::train && !nodes_.empty();
+  }
+
+  void build_checkpoints() {
+    if (!checkpoints_.built()) {
+      checkpoints_.build(nodes_, output_layers(), checkpoint_overrides_);
+    }
+  }
+
+  // run the layers in topological order, releasing the activations which
+  // are recomputed during backward
+  void forward_layers() {
+    if (!checkpointed()) {
+      for (auto l : nodes_) l->forward();
+      return;
+    }
+    build_checkpoints();
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      nodes_[i]->forward();
+      checkpoints_.forwarded(i);
+    }
+  }
+
+  // run the backward pass of the layers in reverse topological order,
+  // recomputing the released activations
+  void backward_layers(const std::function<void(layer *)> &on_backward) {
+    if (checkpointed()) {
+      build_checkpoints();
+      checkpoints_.backward(on_backward);
+      return;
+    }
+    for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
+      (*l)->backward();
+      if (on_backward) on_backward(*l);
+    }
+  }
+
+  void check_backward() const {
+    if (plan_.applied()) {
+      throw nn_error(
+        "the activations are shared by the memory plan, set the train "
+        "phase before the backward pass");
+    }
+  }
+
   /* Nodes which this class has ownership */
   std::vector<std::shared_ptr<layer>> own_nodes_;
   /* List of all nodes which includes own_nodes */
   std::vector<layer *> nodes_;
+
+  memory_plan plan_;
+  net_phase phase_       = net_phase::train;
+  bool memory_planning_ = false;
+
+  checkpoint_plan checkpoints_;
+  std::unordered_map<size_t, bool> checkpoint_overrides_;
+  bool checkpointing_ = false;
+
+  bool in_place_activations_ = false;
+  bool channel_blocking_     = false;
+
+  // last layers of the pipeline stages, whose outputs are handed over to
+  // the next stage while they compute the next micro-batch
+  std::vector<layer *> stage_ends_;
 };
 
 /**
@@ -273,38 +695,95 @@ class nodes {
  **/
 class sequential : public nodes {
  public:
-  void backward(const std::vector<tensor_t> &first) override {
+  void backward(
+    const std::vector<tensor_t> &first,
+    const std::function<void(layer *)> &on_backward = nullptr) override {
+    check_backward();
+
     std::vector<std::vector<const vec_t *>> reordered_grad;
     reorder_for_layerwise_processing(first, reordered_grad);
     assert(reordered_grad.size() == 1);
 
     nodes_.back()->set_out_grads(&reordered_grad[0], 1);
 
-    for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-      (*l)->backward();
-    }
+    backward_layers(on_backward);
   }
 
   std::vector<tensor_t> forward(const std::vector<tensor_t> &first) override {
+    return forward(sample_view(first));
+  }
+
+  std::vector<tensor_t> forward(const sample_view &first) override {
+    prepare_memory(first.size());
+
     std::vector<std::vector<const vec_t *>> reordered_data;
     reorder_for_layerwise_processing(first, reordered_data);
     assert(reordered_data.size() == 1);
 
     nodes_.front()->set_in_data(&reordered_data[0], 1);
 
+    forward_layers();
+
+    std::vector<const tensor_t *> out;
+    nodes_.back()->output(out);
+
+    return normalize_out(out);
+  }
+
+  std::vector<tensor_t> forward(execution_context &ctx,
+                                const std::vector<tensor_t> &first) override {
+    prepare_context(ctx);
+
+    std::vector<std::vector<const vec_t *>> reordered_data;
+    reorder_for_layerwise_processing(first, reordered_data);
+    assert(reordered_data.size() == 1);
+
+    nodes_.front()->set_in_data(ctx, &reordered_data[0], 1);
+
     for (auto l : nodes_) {
-      l->forward();
+      l->forward(ctx);
     }
 
     std::vector<const tensor_t *> out;
-    nodes_.back()->output(out);
+    nodes_.back()->output(ctx, out);
 
     return normalize_out(out);
   }
 
+  /**
+   * pipelined forward propagation (inference only).
+   *
+   * The layers are split into at most get_num_threads() stages of similar
+   * cost, measured while the first micro-batch goes through the network
+   * the first time (and again when the number of threads changes). The
+   * last layer of each stage then stops running in place, if it did.
+   * The remaining micro-batches then advance in lock-step: at each step
+   * stage s processes micro-batch k while stage s-1 processes k+1. The edge
+   * between two stages is double-buffered and swapped after every step.
+   *
+   * Intra-layer for_i calls inside a stage run on the stage's thread, so
+   * this pays off for deep networks made of small layers.
+   **/
+  std::vector<tensor_t> forward_pipelined(const std::vector<tensor_t> &first,
+                                          size_t micro_batch_size) override {
+    const size_t sample_count = first.size();
+    const size_t max_stages   = std::min(get_num_threads(), nodes_.size());
+    if (micro_batch_size == 0 || max_stages < 2 ||
+        sample_count <= micro_batch_size) {
+      return forward(first);
+    }
+
+    // the stages swap the activations of their edges, which the memory plan
+    // must not share with each other then
+    plan_.release();
+    return forward_stages(first, micro_batch_size, max_stages);
+  }
+
   template <typename T>
   void add(T &&layer) {
     push_back(std::forward<T>(layer));
+    stage_bounds_.clear();
+    stage_ends_.clear();
 
     if (nodes_.size() != 1) {
       auto head = nodes_[nodes_.size() - 2];
@@ -314,6 +793,7 @@ class sequential : public nodes {
       auto in  = tail->inputs();
     }
     check_connectivity();
+    share_in_place();
   }
 
   void check_connectivity() {
@@ -343,20 +823,156 @@ class sequential : public nodes {
  private:
   friend class nodes;
 
+  // runs forward_pipelined once the edges of the stages can be swapped
+  std::vector<tensor_t> forward_stages(const std::vector<tensor_t> &first,
+                                       size_t micro_batch_size,
+                                       size_t max_stages) {
+    const size_t sample_count = first.size();
+
+    std::vector<std::vector<const vec_t *>> reordered_data;
+    reorder_for_layerwise_processing(first, reordered_data);
+    assert(reordered_data.size() == 1);
+
+    const size_t micro_batch_count =
+      (sample_count + micro_batch_size - 1) / micro_batch_size;
+    std::vector<tensor_t> output(sample_count, tensor_t(1));
+
+    auto feed = [&](size_t k) {
+      size_t begin = k * micro_batch_size;
+      size_t end   = std::min(begin + micro_batch_size, sample_count);
+      std::vector<const vec_t *> batch(&reordered_data[0][begin],
+                                       &reordered_data[0][0] + end);
+      nodes_.front()->set_in_data(&batch, 1);
+    };
+    auto collect = [&](size_t k) {
+      std::vector<const tensor_t *> out;
+      nodes_.back()->output(out);
+      size_t begin = k * micro_batch_size;
+      for (size_t i = 0; i < out[0]->size(); i++) {
+        output[begin + i][0] = (*out[0])[i];
+      }
+    };
+
+    // micro-batch 0 runs through every layer, timing each of them. the
+    // stages are balanced on these timings the first time
+    std::vector<double> cost(nodes_.size());
+    feed(0);
+    for (size_t l = 0; l < nodes_.size(); l++) {
+      auto t0 = std::chrono::steady_clock::now();
+      nodes_[l]->forward();
+      cost[l] = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              t0)
+                  .count();
+    }
+    collect(0);
+
+    if (stage_bounds_.empty() || stage_limit_ != max_stages) {
+      stage_bounds_ = balance_stages(cost, max_stages);
+      stage_limit_  = max_stages;
+      stage_ends_.clear();
+      for (size_t s = 1; s + 1 < stage_bounds_.size(); s++) {
+        stage_ends_.push_back(nodes_[stage_bounds_[s] - 1]);
+      }
+      if (in_place_activations_) share_in_place();
+    }
+
+    // stage s owns layers [bounds[s], bounds[s + 1])
+    const std::vector<size_t> &bounds = stage_bounds_;
+    const size_t stage_count          = bounds.size() - 1;
+
+    // the last layer of stage s-1 writes into a detached edge, whose data is
+    // handed over to the original edge (read by stage s) after each step
+    std::vector<edgeptr_t> staged(stage_count);
+    auto restore = [&]() {
+      for (size_t s = 1; s < stage_count; s++) {
+        if (staged[s]) nodes_[bounds[s] - 1]->exchange_out_edge(0, staged[s]);
+      }
+    };
+    for (size_t s = 1; s < stage_count; s++) {
+      layer *producer = nodes_[bounds[s] - 1];
+      edgeptr_t e     = producer->outputs()[0];
+      staged[s]       = producer->exchange_out_edge(
+        0, std::make_shared<edge>(producer, e->shape(), e->vtype()));
+    }
+
+    try {
+      const size_t steps = (micro_batch_count - 1) + stage_count - 1;
+      for (size_t step = 0; step < steps; step++) {
+        // stage s works on micro-batch 1 + step - s
+        size_t first_stage = step + 1 >= micro_batch_count
+                               ? step + 2 - micro_batch_count
+                               : 0;
+        size_t last_stage = std::min(step, stage_count - 1);
+
+        for_i(true, last_stage - first_stage + 1,
+              [&](size_t i) {
+                size_t s = first_stage + i;
+                size_t k = 1 + step - s;
+                if (s == 0) feed(k);
+                for (size_t l = bounds[s]; l < bounds[s + 1]; l++) {
+                  nodes_[l]->forward();
+                }
+                if (s == stage_count - 1) collect(k);
+              },
+              1);
+
+        for (size_t s = first_stage + 1; s <= last_stage + 1 && s < stage_count;
+             s++) {
+          edgeptr_t produced = nodes_[bounds[s] - 1]->outputs()[0];
+          std::swap(*produced->get_data(), *staged[s]->get_data());
+        }
+      }
+    } catch (...) {
+      restore();
+      throw;
+    }
+    restore();
+
+    return output;
+  }
+
+  // split layers into at most max_stages contiguous stages of similar cost.
+  // returns the index of the first layer of each stage, plus nodes_.size()
+  std::vector<size_t> balance_stages(const std::vector<double> &cost,
+                                     size_t max_stages) const {
+    double total = 0;
+    for (double c : cost) total += c;
+
+    std::vector<size_t> bounds{0};
+    double acc = 0;
+    for (size_t l = 0; l < cost.size(); l++) {
+      acc += cost[l];
+      size_t stage = bounds.size();
+      if (stage < max_stages && l + 1 < cost.size() &&
+          acc >= total * stage / max_stages) {
+        bounds.push_back(l + 1);
+      }
+    }
+    bounds.push_back(cost.size());
+    return bounds;
+  }
+
   std::vector<tensor_t> normalize_out(
     const std::vector<const tensor_t *> &out) {
     // normalize indexing back to [sample][layer][feature]
     std::vector<tensor_t> normalized_output;
 
     const size_t sample_count = out[0]->size();
-    normalized_output.resize(sample_count, tensor_t(1));
+    normalized_output.resize(sample_count);
 
+    // from the scratch arena during a training step
     for (size_t sample = 0; sample < sample_count; ++sample) {
-      normalized_output[sample][0] = (*out[0])[sample];
+      normalized_output[sample].emplace_back((*out[0])[sample],
+                                             scratch_allocator<float_t>());
     }
 
     return normalized_output;
   }
+
+  // first layer of each pipeline stage, plus nodes_.size(), and the number
+  // of stages they were balanced for
+  std::vector<size_t> stage_bounds_;
+  size_t stage_limit_ = 0;
 };
 
 /**
@@ -365,7 +981,10 @@ class sequential : public nodes {
  **/
 class graph : public nodes {
  public:
-  void backward(const std::vector<tensor_t> &out_grad) override {
+  void backward(
+    const std::vector<tensor_t> &out_grad,
+    const std::function<void(layer *)> &on_backward = nullptr) override {
+    check_backward();
     size_t output_channel_count = out_grad[0].size();
 
     if (output_channel_count != output_layers_.size()) {
@@ -380,18 +999,29 @@ class graph : public nodes {
       output_layers_[i]->set_out_grads(&reordered_grad[i], 1);
     }
 
-    for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-      (*l)->backward();
+    // checkpointing recomputes the segments in topological order
+    size_t nworkers = checkpointed() ? 1 : concurrency(out_grad.size());
+    if (nworkers > 1) {
+      run_by_dependency(true, nworkers, on_backward);
+      return;
     }
+
+    backward_layers(on_backward);
   }
 
   std::vector<tensor_t> forward(const std::vector<tensor_t> &in_data) override {
-    size_t input_data_channel_count = in_data[0].size();
+    return forward(sample_view(in_data));
+  }
+
+  std::vector<tensor_t> forward(const sample_view &in_data) override {
+    size_t input_data_channel_count = in_data.channels();
 
     if (input_data_channel_count != input_layers_.size()) {
       throw nn_error("input size mismatch");
     }
 
+    prepare_memory(in_data.size());
+
     std::vector<std::vector<const vec_t *>> reordered_data;
     reorder_for_layerwise_processing(in_data, reordered_data);
     assert(reordered_data.size() == input_data_channel_count);
@@ -402,12 +1032,42 @@ class graph : public nodes {
                                                 1);
     }
 
-    for (auto l : nodes_) {
-      l->forward();
+    // the memory plan and checkpointing rely on the layers running in
+    // topological order
+    size_t nworkers = plan_.applied() || checkpointed()
+                        ? 1
+                        : concurrency(in_data.size());
+    if (nworkers > 1) {
+      run_by_dependency(false, nworkers);
+      return merge_outs();
     }
+
+    forward_layers();
     return merge_outs();
   }
 
+  std::vector<tensor_t> forward(execution_context &ctx,
+                                const std::vector<tensor_t> &in_data) override {
+    if (in_data[0].size() != input_layers_.size()) {
+      throw nn_error("input size mismatch");
+    }
+    prepare_context(ctx);
+
+    std::vector<std::vector<const vec_t *>> reordered_data;
+    reorder_for_layerwise_processing(in_data, reordered_data);
+
+    for (size_t channel_index = 0; channel_index < input_layers_.size();
+         channel_index++) {
+      input_layers_[channel_index]->set_in_data(
+        ctx, &reordered_data[channel_index], 1);
+    }
+
+    for (auto l : nodes_) {
+      l->forward(ctx);
+    }
+    return merge_outs(&ctx);
+  }
+
   void construct(const std::vector<layer *> &input,
                  const std::vector<layer *> &output) {
     std::vector<layer *> sorted;
@@ -453,6 +1113,134 @@ class graph : public nodes {
  private:
   friend class nodes;
 
+  /**
+   * number of threads running independent layers at the same time, or 1 to
+   * walk the layers in topological order.
+   *
+   * Layers mostly parallelize over samples, so branches are only run
+   * concurrently when the batch is too small to keep every thread busy
+   * (e.g. batch size 1) and the graph actually has parallel branches.
+   **/
+  size_t concurrency(size_t sample_count) const {
+    size_t nthreads = get_num_threads();
+    if (nthreads < 2 || sample_count >= nthreads) return 1;
+
+    // width = largest number of layers at the same depth
+    std::unordered_map<const node *, size_t> depth;
+    std::vector<size_t> count;
+    for (auto l : nodes_) {
+      size_t d = 0;
+      for (auto p : l->prev_nodes()) {
+        auto it = depth.find(p);
+        if (it != depth.end()) d = std::max(d, it->second + 1);
+      }
+      depth[l] = d;
+      if (count.size() <= d) count.resize(d + 1, 0);
+      count[d]++;
+    }
+    size_t width = *std::max_element(count.begin(), count.end());
+    return std::min(width, nthreads);
+  }
+
+  /**
+   * dependency-driven execution: a layer runs as soon as every layer it
+   * depends on is done (its producers when going forward, its consumers when
+   * going backward). up to nworkers ready layers run at the same time, as
+   * tasks of one for_i, so they share the threads of intra-layer for_i.
+   * on_done is called with every layer once it has run.
+   **/
+  void run_by_dependency(
+    bool backward,
+    size_t nworkers,
+    const std::function<void(layer *)> &on_done = nullptr) {
+    const size_t n = nodes_.size();
+    std::unordered_map<const node *, size_t> index;
+    for (size_t i = 0; i < n; i++) index[nodes_[i]] = i;
+
+    // edges consumed by several layers get one lock, since every consumer
+    // writes the gradient of its input during backward
+    std::unordered_map<const edge *, size_t> edge_lock;
+    std::vector<std::vector<size_t>> locks(n);
+    std::vector<std::vector<size_t>> dependents(n);
+    std::vector<size_t> waiting(n, 0);
+
+    for (size_t i = 0; i < n; i++) {
+      std::vector<node *> before =
+        backward ? nodes_[i]->next_nodes() : nodes_[i]->prev_nodes();
+      std::sort(before.begin(), before.end());
+      before.erase(std::unique(before.begin(), before.end()), before.end());
+      for (auto p : before) {
+        auto it = index.find(p);
+        if (it == index.end()) continue;
+        dependents[it->second].push_back(i);
+        waiting[i]++;
+      }
+      if (!backward) continue;
+      for (auto &e : nodes_[i]->prev()) {
+        if (!e || e->next().size() < 2) continue;
+        auto it = edge_lock.emplace(e.get(), edge_lock.size()).first;
+        locks[i].push_back(it->second);
+      }
+      std::sort(locks[i].begin(), locks[i].end());
+    }
+    std::vector<std::mutex> edge_mutex(edge_lock.size());
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::vector<size_t> ready;
+    size_t remaining = n;
+    std::exception_ptr error;
+
+    for (size_t i = 0; i < n; i++) {
+      if (waiting[i] == 0) ready.push_back(i);
+    }
+    // reverse topological order for backward, so pop the right end
+    if (!backward) std::reverse(ready.begin(), ready.end());
+
+    for_i(true, nworkers,
+          [&](size_t) {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+              ready_cv.wait(lock, [&] {
+                return !ready.empty() || remaining == 0 || error;
+              });
+              if (remaining == 0 || error) return;
+
+              size_t i = ready.back();
+              ready.pop_back();
+              lock.unlock();
+
+              try {
+                if (backward) {
+                  // ascending lock order keeps concurrent consumers from
+                  // deadlocking
+                  std::vector<std::unique_lock<std::mutex>> held;
+                  for (size_t m : locks[i]) held.emplace_back(edge_mutex[m]);
+                  nodes_[i]->backward();
+                } else {
+                  nodes_[i]->forward();
+                }
+                if (on_done) on_done(nodes_[i]);
+              } catch (...) {
+                lock.lock();
+                if (!error) error = std::current_exception();
+                ready_cv.notify_all();
+                return;
+              }
+
+              lock.lock();
+              remaining--;
+              for (size_t d : dependents[i]) {
+                if (--waiting[d] == 0) ready.push_back(d);
+              }
+              ready_cv.notify_all();
+            }
+          },
+          1);
+
+    if (error) std::rethrow_exception(error);
+  }
+
   struct _graph_connection {
     void add_connection(size_t head,
                         size_t tail,
@@ -545,29 +1333,40 @@ class graph : public nodes {
   }
 
   // normalize indexing back to [sample][layer][feature]
-  std::vector<tensor_t> merge_outs() {
+  std::vector<tensor_t> merge_outs(execution_context *ctx = nullptr) {
     std::vector<tensor_t> merged;
     std::vector<const tensor_t *> out;
     size_t output_channel_count = output_layers_.size();
     for (size_t output_channel = 0; output_channel < output_channel_count;
          ++output_channel) {
-      output_layers_[output_channel]->output(out);
+      if (ctx) {
+        output_layers_[output_channel]->output(*ctx, out);
+      } else {
+        output_layers_[output_channel]->output(out);
+      }
 
       size_t sample_count = out[0]->size();
       if (output_channel == 0) {
         assert(merged.empty());
-        merged.resize(sample_count, tensor_t(output_channel_count));
+        merged.resize(sample_count);
+        for (auto &sample : merged) sample.reserve(output_channel_count);
       }
 
       assert(merged.size() == sample_count);
 
+      // from the scratch arena during a training step
       for (size_t sample = 0; sample < sample_count; ++sample) {
-        merged[sample][output_channel] = (*out[0])[sample];
+        merged[sample].emplace_back((*out[0])[sample],
+                                    scratch_allocator<float_t>());
       }
     }
     return merged;
   }
 
+  std::vector<layer *> output_layers() const override {
+    return output_layers_;
+  }
+
   size_t find_index(const std::vector<node *> &nodes, layer *target) {
     for (size_t i = 0; i < nodes.size(); i++) {
       if (nodes[i] == static_cast<node *>(&*target)) return i;
@@ -598,6 +1397,7 @@ void nodes::load_model(InputArchive &ia) {
 #ifndef CNN_NO_SERIALIZATION
   own_nodes_.clear();
   nodes_.clear();
+  checkpoints_.clear();
 
   ia(cereal::make_nvp("nodes", own_nodes_));
 
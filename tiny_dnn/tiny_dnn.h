@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include "tiny_dnn/batching_predictor.h"
 #include "tiny_dnn/config.h"
 #include "tiny_dnn/network.h"
 #include "tiny_dnn/nodes.h"
@@ -8,7 +8,10 @@
 #pragma once
 
 #include <stdlib.h>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 #ifdef _WIN32
@@ -23,6 +26,117 @@
 
 namespace tiny_dnn {
 
+namespace detail {
+
+inline std::atomic<std::size_t> &aligned_allocation_counter() {
+  static std::atomic<std::size_t> count(0);
+  return count;
+}
+
+inline void *aligned_malloc(std::size_t align, std::size_t size) {
+  aligned_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+#if defined(_MSC_VER)
+  return ::_aligned_malloc(size, align);
+#elif defined(__ANDROID__)
+  return ::memalign(align, size);
+#elif defined(__MINGW32__)
+  return ::_mm_malloc(size, align);
+#else  // posix assumed
+  void *p;
+  if (::posix_memalign(&p, align, size) != 0) {
+    p = 0;
+  }
+  return p;
+#endif
+}
+
+inline void aligned_free(void *ptr) {
+#if defined(_MSC_VER)
+  ::_aligned_free(ptr);
+#elif defined(__MINGW32__)
+  ::_mm_free(ptr);
+#else
+  ::free(ptr);
+#endif
+}
+
+}  // namespace detail
+
+/**
+ * number of aligned heap allocations (the memory of every vec_t not placed
+ * in a contiguous_block) made so far by the process
+ **/
+inline std::size_t aligned_allocation_count() {
+  return detail::aligned_allocation_counter().load(std::memory_order_relaxed);
+}
+
+/**
+ * one block of memory handing out consecutive, aligned pieces. vectors
+ * whose aligned_allocator refers to the same block are laid out back to
+ * back, so the samples of a batch can be addressed as one matrix (see
+ * resize_batch). the memory is released with the last vector using it.
+ **/
+class contiguous_block {
+ public:
+  contiguous_block(std::size_t bytes, std::size_t alignment)
+    : base_(static_cast<char *>(detail::aligned_malloc(alignment, bytes))),
+      size_(bytes),
+      alignment_(alignment),
+      used_(0) {
+    if (!base_ && bytes > 0) throw nn_error("failed to allocate");
+  }
+
+  ~contiguous_block() { detail::aligned_free(base_); }
+
+  contiguous_block(const contiguous_block &) = delete;
+  contiguous_block &operator=(const contiguous_block &) = delete;
+
+  /**
+   * next free piece of the block, or nullptr if the block is full
+   **/
+  void *allocate(std::size_t bytes) {
+    std::size_t padded = (bytes + alignment_ - 1) / alignment_ * alignment_;
+    std::size_t offset = used_.fetch_add(padded);
+    if (offset + padded > size_) return nullptr;
+    return base_ + offset;
+  }
+
+  bool owns(const void *p) const {
+    return p >= base_ && p < base_ + size_;
+  }
+
+  std::size_t capacity() const { return size_; }
+
+  /**
+   * bytes handed out since the last reset, plus those asked for once the
+   * block was full
+   **/
+  std::size_t used() const { return used_; }
+
+  /**
+   * hand the block out again from the given offset (its start by default).
+   * the pieces handed out after it are reused by the next allocations, so
+   * their previous owners must be done with them.
+   **/
+  void reset(std::size_t offset = 0) { used_ = offset; }
+
+  /**
+   * hand out no more pieces, the next allocations come from the heap
+   **/
+  void seal() { used_ = size_; }
+
+ private:
+  char *base_;
+  std::size_t size_;
+  std::size_t alignment_;
+  std::atomic<std::size_t> used_;
+};
+
+/**
+ * allocator of aligned memory. by default each allocation comes from the
+ * heap; an allocator constructed from a contiguous_block takes its memory
+ * from the block as long as there is room left.
+ **/
 template <typename T, std::size_t alignment>
 class aligned_allocator {
  public:
@@ -39,10 +153,30 @@ class aligned_allocator {
     typedef aligned_allocator<U, alignment> other;
   };
 
+  // vectors swap their allocators along with their memory, but keep their
+  // own on copy and move assignment (the memory stays in its block)
+  typedef std::true_type propagate_on_container_swap;
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::false_type propagate_on_container_move_assignment;
+  typedef std::false_type is_always_equal;
+
   aligned_allocator() {}
 
+  explicit aligned_allocator(std::shared_ptr<contiguous_block> block)
+    : block_(std::move(block)) {}
+
   template <typename U>
-  aligned_allocator(const aligned_allocator<U, alignment> &) {}
+  aligned_allocator(const aligned_allocator<U, alignment> &other)
+    : block_(other.block()) {}
+
+  /**
+   * copies of a vector are allocated from the heap
+   **/
+  aligned_allocator select_on_container_copy_construction() const {
+    return aligned_allocator();
+  }
+
+  const std::shared_ptr<contiguous_block> &block() const { return block_; }
 
   const_pointer address(const_reference value) const {
     return std::addressof(value);
@@ -51,7 +185,11 @@ class aligned_allocator {
   pointer address(reference value) const { return std::addressof(value); }
 
   pointer allocate(size_type size, const void * = nullptr) {
-    void *p = aligned_alloc(alignment, sizeof(T) * size);
+    if (block_) {
+      void *p = block_->allocate(sizeof(T) * size);
+      if (p) return static_cast<pointer>(p);
+    }
+    void *p = detail::aligned_malloc(alignment, sizeof(T) * size);
     if (!p && size > 0) throw nn_error("failed to allocate");
     return static_cast<pointer>(p);
   }
@@ -60,7 +198,10 @@ class aligned_allocator {
     return ~static_cast<std::size_t>(0) / sizeof(T);
   }
 
-  void deallocate(pointer ptr, size_type) { aligned_free(ptr); }
+  void deallocate(pointer ptr, size_type) {
+    if (block_ && block_->owns(ptr)) return;
+    detail::aligned_free(ptr);
+  }
 
   template <class U, class V>
   void construct(U *ptr, const V &value) {
@@ -86,43 +227,19 @@ class aligned_allocator {
   }
 
  private:
-  void *aligned_alloc(size_type align, size_type size) const {
-#if defined(_MSC_VER)
-    return ::_aligned_malloc(size, align);
-#elif defined(__ANDROID__)
-    return ::memalign(align, size);
-#elif defined(__MINGW32__)
-    return ::_mm_malloc(size, align);
-#else  // posix assumed
-    void *p;
-    if (::posix_memalign(&p, align, size) != 0) {
-      p = 0;
-    }
-    return p;
-#endif
-  }
-
-  void aligned_free(pointer ptr) {
-#if defined(_MSC_VER)
-    ::_aligned_free(ptr);
-#elif defined(__MINGW32__)
-    ::_mm_free(ptr);
-#else
-    ::free(ptr);
-#endif
-  }
+  std::shared_ptr<contiguous_block> block_;
 };
 
 template <typename T1, typename T2, std::size_t alignment>
-inline bool operator==(const aligned_allocator<T1, alignment> &,
-                       const aligned_allocator<T2, alignment> &) {
-  return true;
+inline bool operator==(const aligned_allocator<T1, alignment> &a,
+                       const aligned_allocator<T2, alignment> &b) {
+  return a.block() == b.block();
 }
 
 template <typename T1, typename T2, std::size_t alignment>
-inline bool operator!=(const aligned_allocator<T1, alignment> &,
-                       const aligned_allocator<T2, alignment> &) {
-  return false;
+inline bool operator!=(const aligned_allocator<T1, alignment> &a,
+                       const aligned_allocator<T2, alignment> &b) {
+  return !(a == b);
 }
 
 }  // namespace tiny_dnn
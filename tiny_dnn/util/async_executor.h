@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <future>  // NOLINT
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/util/thread_budget.h"
+
+namespace tiny_dnn {
+
+/**
+ * fixed set of threads running independent tasks, such as the calls of
+ * network::predict_async.
+ *
+ * thread_pool runs one fork/join job at a time and can not hold on to
+ * tasks, so asynchronous calls are queued here instead. Their for_i loops
+ * still use the thread_pool (or the parallel backend in use), within the
+ * thread budget of the submitter (or all the threads of the executor)
+ * divided by the number of tasks running: while the pool computes the
+ * loops of one task, the others run theirs on their own thread, and the
+ * running tasks keep about as many cores busy as the budget allows. The
+ * executor has as many threads as the process-wide budget by default.
+ *
+ * The queue may be bounded: submit() then blocks until there is room,
+ * which pushes back on producers faster than the workers. A task
+ * submitted from a worker thread while the queue is full runs inline
+ * instead, so that tasks spawning tasks can not deadlock.
+ *
+ *     auto f = async_executor::instance().submit([] { return 42; });
+ *     f.get();
+ **/
+class async_executor {
+ public:
+  /**
+   * @param num_threads     number of worker threads
+   * @param max_queue_depth largest number of pending tasks (0: unbounded)
+   **/
+  explicit async_executor(size_t num_threads     = default_num_threads(),
+                          size_t max_queue_depth = 0)
+    : max_queue_depth_(max_queue_depth), running_(0), stop_(false) {
+    if (num_threads == 0) num_threads = 1;
+    for (size_t i = 0; i < num_threads; i++) {
+      workers_.emplace_back([this] { worker_loop(); });
+    }
+  }
+
+  /**
+   * pending tasks are executed before the executor is destroyed
+   **/
+  ~async_executor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+    for (auto &w : workers_) w.join();
+  }
+
+  async_executor(const async_executor &) = delete;
+  async_executor &operator=(const async_executor &) = delete;
+
+  /**
+   * process-wide executor used by network::predict_async
+   **/
+  static async_executor &instance() {
+    static async_executor executor;
+    return executor;
+  }
+
+  static size_t default_num_threads() {
+    size_t n = thread_budget();
+    if (n == 0) n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+  }
+
+  size_t num_threads() const { return workers_.size(); }
+
+  /**
+   * bound the number of pending tasks (0: unbounded)
+   **/
+  void set_max_queue_depth(size_t max_queue_depth) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      max_queue_depth_ = max_queue_depth;
+    }
+    not_full_.notify_all();
+  }
+
+  size_t max_queue_depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_queue_depth_;
+  }
+
+  /**
+   * number of tasks waiting for a worker
+   **/
+  size_t pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+  /**
+   * queue f() and return its future result. blocks while the queue is
+   * full. an exception thrown by f is stored in the future.
+   **/
+  template <typename Func>
+  auto submit(Func f) -> std::future<decltype(f())> {
+    typedef decltype(f()) result_t;
+    auto task = std::make_shared<std::packaged_task<result_t()>>(std::move(f));
+    std::future<result_t> result = task->get_future();
+    const size_t budget = thread_budget();
+    push([this, task, budget] {
+      const size_t threads = budget != 0 ? budget : num_threads();
+      const size_t running = ++running_;
+      {
+        thread_budget_scope scope(std::max<size_t>(1, threads / running));
+        (*task)();
+      }
+      --running_;
+    });
+    return result;
+  }
+
+ private:
+  static bool &on_worker() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  bool full() const {
+    return max_queue_depth_ != 0 && queue_.size() >= max_queue_depth_;
+  }
+
+  void push(std::function<void()> task) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (on_worker() && full()) {
+        lock.unlock();
+        task();
+        return;
+      }
+      not_full_.wait(lock, [this] { return stop_ || !full(); });
+      queue_.push_back(std::move(task));
+    }
+    not_empty_.notify_one();
+  }
+
+  void worker_loop() {
+    on_worker() = true;
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        task = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      not_full_.notify_one();
+      task();
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<std::function<void()>> queue_;
+  size_t max_queue_depth_;
+  std::atomic<size_t> running_;  // tasks being executed
+  bool stop_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "tiny_dnn/util/parallel_for.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+namespace detail {
+
+inline std::atomic<bool> &contiguous_batches_flag() {
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+}  // namespace detail
+
+/**
+ * keep the samples of the activations and gradients of each edge in one
+ * contiguous [batch x features] block (the default), instead of one heap
+ * allocation per sample. the tensors keep their std::vector<vec_t>
+ * interface, each sample being a vec_t placed in the block.
+ **/
+inline void set_contiguous_batches(bool enabled) {
+  detail::contiguous_batches_flag() = enabled;
+}
+
+inline bool contiguous_batches() { return detail::contiguous_batches_flag(); }
+
+/**
+ * distance in elements between consecutive samples of the given size in a
+ * contiguous block
+ **/
+inline size_t batch_stride(size_t features) {
+  const size_t align = 64 / sizeof(float_t);
+  return (features + align - 1) / align * align;
+}
+
+/**
+ * resize a tensor to hold the given number of samples. new samples are
+ * copies of the first one (zeros of the given size if there is none).
+ *
+ * with contiguous_batches() the samples are laid out back to back in one
+ * block whenever the tensor grows. with first_touch each sample is written
+ * by the thread of parallel_for processing it, so that its pages land on
+ * the NUMA node of that thread.
+ **/
+inline void resize_batch(tensor_t *t,
+                         size_t sample_count,
+                         size_t features,
+                         bool first_touch = false) {
+  const size_t old_count = t->size();
+  if (sample_count == old_count) return;
+  if (t->empty()) t->push_back(vec_t(features));
+
+  if (sample_count < old_count || !contiguous_batches()) {
+    if (sample_count <= old_count || !first_touch) {
+      t->resize(sample_count, (*t)[0]);
+      return;
+    }
+    t->resize(sample_count);
+    for_i(sample_count, [&](size_t i) {
+      if (i >= old_count) (*t)[i] = (*t)[0];
+    });
+    return;
+  }
+
+  const size_t size   = (*t)[0].size();
+  const size_t stride = batch_stride(size);
+  auto block          = std::make_shared<contiguous_block>(
+    stride * sizeof(float_t) * sample_count, 64);
+  aligned_allocator<float_t, 64> alloc(block);
+
+  tensor_t grown;
+  grown.reserve(sample_count);
+  for (size_t i = 0; i < sample_count; i++) {
+    grown.emplace_back(alloc);
+    grown.back().reserve(size);
+  }
+  for_i(first_touch, sample_count, [&](size_t i) {
+    const vec_t &src = i < old_count ? (*t)[i] : (*t)[0];
+    grown[i].assign(src.begin(), src.end());
+  });
+  t->swap(grown);
+}
+
+/**
+ * a batch addressed as one row-major matrix: sample i starts at
+ * data + i * stride
+ **/
+struct batch_matrix {
+  float_t *data;
+  size_t rows;
+  size_t cols;
+  size_t stride;
+};
+
+/**
+ * view the samples of a tensor as one matrix. returns false if they are
+ * not evenly laid out in memory (e.g. separately allocated), in which case
+ * they must be processed one by one.
+ **/
+inline bool as_matrix(tensor_t &t, batch_matrix *m) {
+  if (t.empty() || t[0].empty()) return false;
+  auto address = [&](size_t i) {
+    return reinterpret_cast<std::uintptr_t>(&t[i][0]);
+  };
+  const size_t cols = t[0].size();
+  size_t stride     = cols;
+  if (t.size() > 1) {
+    if (t[1].size() != cols || address(1) < address(0)) return false;
+    stride = (address(1) - address(0)) / sizeof(float_t);
+    if (stride < cols) return false;
+  }
+  for (size_t i = 1; i < t.size(); i++) {
+    if (t[i].size() != cols ||
+        address(i) != address(0) + i * stride * sizeof(float_t)) {
+      return false;
+    }
+  }
+  *m = batch_matrix{&t[0][0], t.size(), cols, stride};
+  return true;
+}
+
+}  // namespace tiny_dnn
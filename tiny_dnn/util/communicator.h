@@ -0,0 +1,360 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "tiny_dnn/config.h"
+#include "tiny_dnn/util/macro.h"
+#include "tiny_dnn/util/nn_error.h"
+
+namespace tiny_dnn {
+
+/**
+ * processes training one network together, connected in a ring.
+ *
+ * Every process (rank) sends to the next rank and receives from the
+ * previous one. Collective operations are built on these two links:
+ * allreduce_sum uses the ring all-reduce (a reduce-scatter followed by an
+ * all-gather), which moves 2 * (size - 1) / size of the buffer over each
+ * link whatever the number of ranks. Every element of the result is summed
+ * on a single rank and then copied to the others, so all ranks end up with
+ * bit-identical values.
+ *
+ * All ranks must call the collective operations in the same order, with
+ * buffers of the same size.
+ **/
+class communicator {
+ public:
+  virtual ~communicator() {}
+
+  /**
+   * index of this process, in [0, size())
+   **/
+  virtual size_t rank() const = 0;
+
+  /**
+   * number of processes
+   **/
+  virtual size_t size() const = 0;
+
+  /**
+   * sum data over every rank, in place. T is float_t, or an integer type
+   * for counts which must stay exact.
+   **/
+  template <typename T>
+  void allreduce_sum(T *data, size_t n) {
+    const size_t ranks = size();
+    if (ranks < 2 || n == 0) return;
+
+    auto first = [&](size_t chunk) { return n * (chunk % ranks) / ranks; };
+    auto count = [&](size_t chunk) {
+      return n * (chunk % ranks + 1) / ranks - first(chunk);
+    };
+    std::vector<T> received(n / ranks + 1);
+
+    // reduce-scatter: afterwards rank r holds the sum of chunk r + 1
+    for (size_t step = 0; step + 1 < ranks; step++) {
+      size_t send_chunk = rank() + ranks - step;
+      size_t recv_chunk = rank() + ranks - step - 1;
+      exchange(data + first(send_chunk), count(send_chunk) * sizeof(T),
+               &received[0], count(recv_chunk) * sizeof(T));
+      T *dst = data + first(recv_chunk);
+      for (size_t i = 0; i < count(recv_chunk); i++) dst[i] += received[i];
+    }
+
+    // all-gather: pass the summed chunks around the ring
+    for (size_t step = 0; step + 1 < ranks; step++) {
+      size_t send_chunk = rank() + ranks + 1 - step;
+      size_t recv_chunk = rank() + ranks - step;
+      exchange(data + first(send_chunk), count(send_chunk) * sizeof(T),
+               data + first(recv_chunk), count(recv_chunk) * sizeof(T));
+    }
+  }
+
+  /**
+   * copy data of the given rank to every other rank
+   **/
+  void broadcast(float_t *data, size_t n, size_t root = 0) {
+    const size_t ranks = size();
+    if (ranks < 2 || n == 0) return;
+    if (rank() != root) recv_prev(data, n * sizeof(float_t));
+    if ((rank() + 1) % ranks != root) send_next(data, n * sizeof(float_t));
+  }
+
+ protected:
+  /**
+   * send bytes to the next rank
+   **/
+  virtual void send_next(const void *data, size_t bytes) = 0;
+
+  /**
+   * receive bytes from the previous rank
+   **/
+  virtual void recv_prev(void *data, size_t bytes) = 0;
+
+  /**
+   * send to the next rank and receive from the previous one at the same
+   * time. every rank does so at once, so the transfers must not wait for
+   * each other.
+   **/
+  virtual void exchange(const void *send,
+                        size_t send_bytes,
+                        void *recv,
+                        size_t recv_bytes) = 0;
+};
+
+/**
+ * communicator over TCP, for processes on one host (loopback) or on several
+ * hosts.
+ *
+ *     // rank 0 of 2, the other process passes 1
+ *     tcp_communicator comm(0, {"127.0.0.1:5000", "127.0.0.1:5001"});
+ *
+ * Each rank listens on the port of its own address, connects to the
+ * address of the next rank and accepts the connection of the previous one.
+ * The constructor returns once the ring is connected, and throws nn_error
+ * if that does not happen within the timeout.
+ **/
+class tcp_communicator : public communicator {
+ public:
+  /**
+   * @param rank      index of this process
+   * @param addresses "host:port" of every rank
+   * @param timeout   longest time to wait for the other ranks
+   **/
+  tcp_communicator(
+    size_t rank,
+    const std::vector<std::string> &addresses,
+    std::chrono::milliseconds timeout = std::chrono::seconds(30))
+    : rank_(rank), size_(addresses.size()), next_(-1), prev_(-1) {
+    if (rank >= addresses.size()) {
+      throw nn_error("rank out of range of the addresses");
+    }
+    if (size_ < 2) return;
+#if defined(_WIN32)
+    CNN_UNREFERENCED_PARAMETER(timeout);
+    throw nn_error("tcp_communicator is not supported on this platform");
+#else
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    int listener  = listen_on(port_of(addresses[rank]));
+    try {
+      next_ = connect_to(addresses[(rank + 1) % size_], deadline);
+      prev_ = accept_from(listener, deadline);
+    } catch (...) {
+      ::close(listener);
+      close_all();
+      throw;
+    }
+    ::close(listener);
+#endif
+  }
+
+  ~tcp_communicator() { close_all(); }
+
+  tcp_communicator(const tcp_communicator &) = delete;
+  tcp_communicator &operator=(const tcp_communicator &) = delete;
+
+  size_t rank() const override { return rank_; }
+
+  size_t size() const override { return size_; }
+
+ protected:
+#if defined(_WIN32)
+  void send_next(const void *, size_t) override {}
+  void recv_prev(void *, size_t) override {}
+  void exchange(const void *, size_t, void *, size_t) override {}
+  void close_all() {}
+#else
+  void send_next(const void *data, size_t bytes) override {
+    exchange(data, bytes, nullptr, 0);
+  }
+
+  void recv_prev(void *data, size_t bytes) override {
+    exchange(nullptr, 0, data, bytes);
+  }
+
+  void exchange(const void *send,
+                size_t send_bytes,
+                void *recv,
+                size_t recv_bytes) override {
+    const char *out = static_cast<const char *>(send);
+    char *in        = static_cast<char *>(recv);
+    while (send_bytes > 0 || recv_bytes > 0) {
+      pollfd fds[2];
+      nfds_t nfds = 0;
+      if (send_bytes > 0) fds[nfds++] = pollfd{next_, POLLOUT, 0};
+      if (recv_bytes > 0) fds[nfds++] = pollfd{prev_, POLLIN, 0};
+      if (::poll(fds, nfds, -1) < 0) {
+        if (errno == EINTR) continue;
+        throw nn_error("tcp_communicator: poll failed");
+      }
+      for (nfds_t i = 0; i < nfds; i++) {
+        if (fds[i].revents == 0) continue;
+        if (fds[i].fd == next_ && send_bytes > 0) {
+          ssize_t sent =
+            ::send(next_, out, send_bytes, MSG_DONTWAIT | nosig());
+          if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+              errno != EINTR) {
+            throw nn_error(
+              "tcp_communicator: connection to the next rank lost");
+          }
+          if (sent > 0) {
+            out += sent;
+            send_bytes -= static_cast<size_t>(sent);
+          }
+        } else if (fds[i].fd == prev_ && recv_bytes > 0) {
+          ssize_t got = ::recv(prev_, in, recv_bytes, MSG_DONTWAIT);
+          if (got == 0 || (got < 0 && errno != EAGAIN &&
+                           errno != EWOULDBLOCK && errno != EINTR)) {
+            throw nn_error(
+              "tcp_communicator: connection to the previous rank lost");
+          }
+          if (got > 0) {
+            in += got;
+            recv_bytes -= static_cast<size_t>(got);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  static int nosig() {
+#ifdef MSG_NOSIGNAL
+    return MSG_NOSIGNAL;
+#else
+    return 0;
+#endif
+  }
+
+  static void split(const std::string &address,
+                    std::string *host,
+                    std::string *port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+      throw nn_error("address must be host:port, got " + address);
+    }
+    *host = address.substr(0, colon);
+    *port = address.substr(colon + 1);
+  }
+
+  static int port_of(const std::string &address) {
+    std::string host, port;
+    split(address, &host, &port);
+    return std::atoi(port.c_str());
+  }
+
+  static void set_nodelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  static int listen_on(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) throw nn_error("tcp_communicator: socket failed");
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(static_cast<uint16_t>(port));
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd, 1) < 0) {
+      ::close(fd);
+      throw nn_error("tcp_communicator: can not listen on port " +
+                     std::to_string(port));
+    }
+    return fd;
+  }
+
+  static int connect_to(const std::string &address,
+                        std::chrono::steady_clock::time_point deadline) {
+    std::string host, port;
+    split(address, &host, &port);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // the next rank may not be listening yet
+    for (;;) {
+      addrinfo *info = nullptr;
+      if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &info) == 0) {
+        int fd = ::socket(info->ai_family, info->ai_socktype,
+                          info->ai_protocol);
+        if (fd >= 0 && ::connect(fd, info->ai_addr, info->ai_addrlen) == 0) {
+          ::freeaddrinfo(info);
+          set_nodelay(fd);
+          return fd;
+        }
+        if (fd >= 0) ::close(fd);
+        ::freeaddrinfo(info);
+      }
+      if (std::chrono::steady_clock::now() > deadline) {
+        throw nn_error("tcp_communicator: can not connect to " + address);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  static int accept_from(int listener,
+                         std::chrono::steady_clock::time_point deadline) {
+    for (;;) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+      pollfd fd{listener, POLLIN, 0};
+      int ready = ::poll(&fd, 1, static_cast<int>(std::max<long long>(
+                                   0, static_cast<long long>(left.count()))));
+      if (ready > 0) {
+        int conn = ::accept(listener, nullptr, nullptr);
+        if (conn >= 0) {
+          set_nodelay(conn);
+          return conn;
+        }
+      }
+      if (ready == 0 || std::chrono::steady_clock::now() > deadline) {
+        throw nn_error("tcp_communicator: the previous rank did not connect");
+      }
+    }
+  }
+
+  void close_all() {
+    if (next_ >= 0) ::close(next_);
+    if (prev_ >= 0) ::close(prev_);
+    next_ = prev_ = -1;
+  }
+#endif
+
+  size_t rank_;
+  size_t size_;
+  int next_;  // socket to the next rank
+  int prev_;  // socket from the previous rank
+};
+
+}  // namespace tiny_dnn
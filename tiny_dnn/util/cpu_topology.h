@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace tiny_dnn {
+
+/**
+ * NUMA nodes of the machine and the cpus belonging to each of them.
+ *
+ * On linux the layout is read from /sys/devices/system/node and restricted to
+ * the cpus the process may run on. Elsewhere, or if sysfs is not available,
+ * the machine is reported as a single node holding every hardware thread.
+ **/
+class cpu_topology {
+ public:
+  static const cpu_topology &instance() {
+    static cpu_topology topology = detect();
+    return topology;
+  }
+
+  size_t num_nodes() const { return nodes_.size(); }
+
+  /**
+   * cpus of the given node
+   **/
+  const std::vector<int> &cpus(size_t node) const { return nodes_[node]; }
+
+  /**
+   * every cpu, grouped by node: all cpus of node 0 first, then node 1, ...
+   **/
+  std::vector<int> cpus_by_node() const {
+    std::vector<int> all;
+    for (const auto &n : nodes_) all.insert(all.end(), n.begin(), n.end());
+    return all;
+  }
+
+  /**
+   * parse a sysfs cpu list such as "0-3,8,10-11"
+   **/
+  static std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      item.erase(std::remove_if(item.begin(), item.end(), ::isspace),
+                 item.end());
+      if (item.empty()) continue;
+      size_t dash = item.find('-');
+      int first   = std::atoi(item.substr(0, dash).c_str());
+      int last    = dash == std::string::npos
+                   ? first
+                   : std::atoi(item.substr(dash + 1).c_str());
+      for (int c = first; c <= last; c++) cpus.push_back(c);
+    }
+    return cpus;
+  }
+
+  /**
+   * bind the calling thread to one cpu. returns false if not supported.
+   **/
+  static bool pin_current_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+  }
+
+ private:
+  explicit cpu_topology(std::vector<std::vector<int>> nodes)
+    : nodes_(std::move(nodes)) {}
+
+  static cpu_topology detect() {
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (online && std::getline(online, list)) {
+      for (int node : parse_cpu_list(list)) {
+        std::ifstream ifs("/sys/devices/system/node/node" +
+                          std::to_string(node) + "/cpulist");
+        std::string cpulist;
+        if (!ifs || !std::getline(ifs, cpulist)) continue;
+
+        std::vector<int> cpus;
+        for (int c : parse_cpu_list(cpulist)) {
+          if (!have_mask || CPU_ISSET(c, &allowed)) cpus.push_back(c);
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+      }
+    }
+#endif
+    if (nodes.empty()) {
+      int n = static_cast<int>(std::thread::hardware_concurrency());
+      std::vector<int> cpus;
+      for (int c = 0; c < std::max(n, 1); c++) cpus.push_back(c);
+      nodes.push_back(cpus);
+    }
+    return cpu_topology(nodes);
+  }
+
+  std::vector<std::vector<int>> nodes_;
+};
+
+}  // namespace tiny_dnn
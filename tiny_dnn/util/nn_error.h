@@ -8,6 +8,7 @@
 #pragma once
 
 #include <exception>
+#include <iostream>
 #include <string>
 #include "tiny_dnn/util/colored_print.h"
 
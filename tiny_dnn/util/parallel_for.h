@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <limits>
@@ -18,6 +19,7 @@
 #include "tiny_dnn/config.h"
 #include "tiny_dnn/util/aligned_allocator.h"
 #include "tiny_dnn/util/nn_error.h"
+#include "tiny_dnn/util/thread_budget.h"
 
 #ifdef CNN_USE_TBB
 #ifndef NOMINMAX
@@ -28,12 +30,20 @@
 #endif
 
 #if !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
-#include <future>  // NOLINT
-#include <thread>  // NOLINT
+#include "tiny_dnn/util/thread_pool.h"
+#endif
+
+#ifdef CNN_USE_OMP
+#include <omp.h>
 #endif
 
 #if defined(CNN_USE_GCD) && !defined(CNN_SINGLE_THREAD)
 #include <dispatch/dispatch.h>
+#include <thread>  // NOLINT
+#endif
+
+#if defined(CNN_USE_WORK_STEALING) && !defined(CNN_SINGLE_THREAD)
+#include "tiny_dnn/util/work_stealing_scheduler.h"
 #endif
 
 namespace tiny_dnn {
@@ -48,8 +58,18 @@ typedef tbb::blocked_range<size_t> blocked_range;
 template <typename Func>
 void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
   assert(end >= begin);
-  tbb::parallel_for(
-    blocked_range(begin, end, end - begin > grainsize ? grainsize : 1), f);
+  blocked_range range(begin, end, end - begin > grainsize ? grainsize : 1);
+  size_t budget = thread_budget();
+  if (budget == 0 || budget >= static_cast<size_t>(
+                                 tbb::this_task_arena::max_concurrency())) {
+    tbb::parallel_for(range, f);
+  } else if (budget == 1) {
+    f(blocked_range(begin, end, end - begin));
+  } else {
+    // nested parallel_for calls run in the same (smaller) arena
+    tbb::task_arena arena(static_cast<int>(budget));
+    arena.execute([&] { tbb::parallel_for(range, f); });
+  }
 }
 
 template <typename Func>
@@ -87,8 +107,13 @@ void parallel_for(size_t begin,
                   const Func &f,
                   size_t /*grainsize*/) {
   assert(end >= begin);
+  int nthreads = omp_get_max_threads();
+  size_t budget = thread_budget();
+  if (budget != 0 && budget < static_cast<size_t>(nthreads)) {
+    nthreads = static_cast<int>(budget);
+  }
 // unsigned index isn't allowed in OpenMP 2.0
-#pragma omp parallel for
+#pragma omp parallel for num_threads(nthreads) if (nthreads > 1)
   for (int i = static_cast<int>(begin); i < static_cast<int>(end); ++i)
     f(blocked_range(i, i + 1));
 }
@@ -106,19 +131,43 @@ void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
   size_t blockCount = (count + blockSize - 1) / blockSize;
   assert(blockCount > 0);
 
-  dispatch_apply(blockCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0),
-                 ^(size_t block) {
-                   size_t blockStart = block * blockSize;
-                   size_t blockEnd   = blockStart + blockSize;
-                   if (blockEnd > end) {
-                     blockEnd = end;
+  // with a thread budget, each of at most `budget` stripes runs every
+  // stripeCount-th block
+  size_t budget      = thread_budget();
+  size_t stripeCount = budget != 0 && budget < blockCount ? budget : blockCount;
+
+  dispatch_apply(stripeCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0),
+                 ^(size_t stripe) {
+                   for (size_t block = stripe; block < blockCount;
+                        block += stripeCount) {
+                     size_t blockStart = begin + block * blockSize;
+                     size_t blockEnd   = blockStart + blockSize;
+                     if (blockEnd > end) {
+                       blockEnd = end;
+                     }
+                     assert(blockStart < blockEnd);
+
+                     f(blocked_range(blockStart, blockEnd));
                    }
-                   assert(blockStart < blockEnd);
-
-                   f(blocked_range(blockStart, blockEnd));
                  });
 }
 
+#elif defined(CNN_USE_WORK_STEALING) && !defined(CNN_SINGLE_THREAD)
+
+template <typename Func>
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
+  assert(end >= begin);
+  // same rule as the TBB backend: ranges not larger than grainsize are
+  // split down to single iterations
+  size_t grain = end - begin > grainsize ? grainsize : 1;
+  work_stealing_scheduler::instance().parallel_for(
+    begin, end, grain,
+    [&f](size_t blockBegin, size_t blockEnd) {
+      f(blocked_range(blockBegin, blockEnd));
+    },
+    thread_budget());
+}
+
 #elif defined(CNN_SINGLE_THREAD)
 
 template <typename Func>
@@ -137,34 +186,76 @@ void parallel_for(size_t begin,
                   const Func &f,
                   size_t /*grainsize*/) {
   assert(end >= begin);
-  size_t nthreads  = std::thread::hardware_concurrency();
-  size_t blockSize = (end - begin) / nthreads;
-  if (blockSize * nthreads < end - begin) blockSize++;
+  if (begin == end) return;
+
+  thread_pool &pool = thread_pool::instance();
+  size_t nthreads   = pool.num_threads();
+  size_t budget     = thread_budget();
+  if (budget != 0 && budget < nthreads) nthreads = budget;
+  if (nthreads == 1) {
+    f(blocked_range(begin, end));
+    return;
+  }
 
-  std::vector<std::future<void> > futures;
+  // at most nthreads blocks, so at most nthreads threads find work
+  size_t blockSize  = (end - begin) / nthreads;
+  if (blockSize * nthreads < end - begin) blockSize++;
+  size_t blockCount = (end - begin + blockSize - 1) / blockSize;
 
-  size_t blockBegin            = begin;
-  size_t blockEnd              = blockBegin + blockSize;
-  if (blockEnd > end) blockEnd = end;
+  pool.run(blockCount, [begin, end, blockSize, &f](size_t block) {
+    size_t blockBegin = begin + block * blockSize;
+    size_t blockEnd   = std::min(blockBegin + blockSize, end);
+    f(blocked_range(blockBegin, blockEnd));
+  });
+}
 
-  for (size_t i = 0; i < nthreads; i++) {
-    futures.push_back(
-      std::move(std::async(std::launch::async, [blockBegin, blockEnd, &f] {
-        f(blocked_range(blockBegin, blockEnd));
-      })));
+#endif
 
-    blockBegin += blockSize;
-    blockEnd = blockBegin + blockSize;
-    if (blockBegin >= end) break;
-    if (blockEnd > end) blockEnd = end;
-  }
+#endif  // CNN_USE_TBB
 
-  for (auto &future : futures) future.wait();
+/**
+ * number of threads a parallel_for/for_i issued from the calling thread may
+ * use, taking the thread budget and the enclosing parallel region into
+ * account
+ **/
+inline size_t get_num_threads() {
+#if defined(CNN_SINGLE_THREAD)
+  size_t available = 1;
+#elif defined(CNN_USE_TBB)
+  size_t available =
+    static_cast<size_t>(tbb::this_task_arena::max_concurrency());
+#elif defined(CNN_USE_OMP)
+  size_t available =
+    omp_in_parallel() ? 1 : static_cast<size_t>(omp_get_max_threads());
+#elif defined(CNN_USE_GCD)
+  size_t available = std::max(1u, std::thread::hardware_concurrency());
+#elif defined(CNN_USE_WORK_STEALING)
+  size_t available = work_stealing_scheduler::instance().num_threads_available();
+#else
+  // nested jobs of the default pool run serially
+  size_t available = thread_pool::in_parallel_region()
+                       ? 1
+                       : thread_pool::instance().num_threads();
+#endif
+  size_t budget = thread_budget();
+  return budget != 0 && budget < available ? budget : available;
 }
 
+/**
+ * true if parallel_for keeps contiguous ranges on the same pinned threads
+ * from one call to the next (see thread_pool::set_affinity). per-sample
+ * buffers are then allocated inside for_i, so that first touch places each
+ * of them on the NUMA node of the thread processing it.
+ **/
+inline bool topology_aware() {
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP) && \
+  !defined(CNN_USE_GCD) && !defined(CNN_USE_WORK_STEALING) && \
+  !defined(CNN_SINGLE_THREAD)
+  return thread_pool::instance().affinity();
+#else
+  return false;
 #endif
-
-#endif  // CNN_USE_TBB
+}
 
 template <typename T, typename U>
 bool value_representation(U const &value) {
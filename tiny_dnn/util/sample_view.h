@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cassert>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * samples read in place, without copying them: a range of a
+ * std::vector<vec_t> (one channel per sample) or of a
+ * std::vector<tensor_t> (one vec_t per channel).
+ *
+ *     sample_view data(inputs);               // the whole data set
+ *     sample_view batch = data.slice(i, 32);  // samples [i, i + 32)
+ *
+ * The view does not own the samples, which must outlive it.
+ **/
+class sample_view {
+ public:
+  sample_view() : tensors_(nullptr), vecs_(nullptr), size_(0) {}
+
+  explicit sample_view(const std::vector<tensor_t> &samples)
+    : tensors_(samples.data()), vecs_(nullptr), size_(samples.size()) {}
+
+  explicit sample_view(const std::vector<vec_t> &samples)
+    : tensors_(nullptr), vecs_(samples.data()), size_(samples.size()) {}
+
+  sample_view(const tensor_t *samples, size_t count)
+    : tensors_(samples), vecs_(nullptr), size_(count) {}
+
+  sample_view(const vec_t *samples, size_t count)
+    : tensors_(nullptr), vecs_(samples), size_(count) {}
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  /**
+   * number of channels of the given sample
+   **/
+  size_t channels(size_t sample = 0) const {
+    assert(sample < size_);
+    return tensors_ ? tensors_[sample].size() : 1;
+  }
+
+  const vec_t &at(size_t sample, size_t channel = 0) const {
+    assert(sample < size_ && channel < channels(sample));
+    return tensors_ ? tensors_[sample][channel] : vecs_[sample];
+  }
+
+  /**
+   * the samples [first, first + count)
+   **/
+  sample_view slice(size_t first, size_t count) const {
+    assert(first + count <= size_);
+    return tensors_ ? sample_view(tensors_ + first, count)
+                    : sample_view(vecs_ + first, count);
+  }
+
+ private:
+  const tensor_t *tensors_;
+  const vec_t *vecs_;
+  size_t size_;
+};
+
+}  // namespace tiny_dnn
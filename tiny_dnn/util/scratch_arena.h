@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tiny_dnn/util/aligned_allocator.h"
+
+namespace tiny_dnn {
+
+/**
+ * per-thread bump allocator for the temporaries of one training or
+ * inference step.
+ *
+ * While a scratch_scope is open on a thread, scratch_allocator() hands out
+ * pieces of the arena of that thread instead of heap memory, one after the
+ * other. Nothing is freed individually: closing a scope hands out again
+ * what was allocated since it was opened. When a step asked for more than
+ * the arena holds, the excess came from the heap and the arena grows to
+ * the peak of that step once the outermost scope closes, so that the
+ * following steps of the same shape draw all their scratch_allocator()
+ * memory from the arena. Containers using std::allocator (e.g. the outer
+ * vector of a tensor_t) still come from the heap.
+ *
+ * Memory from the arena must not outlive the scope it was allocated in:
+ * only use it for local temporaries, and for results consumed before the
+ * scope closes. Copies of such vectors are allocated from the heap (see
+ * aligned_allocator::select_on_container_copy_construction).
+ **/
+class scratch_arena {
+ public:
+  scratch_arena()
+    : block_(std::make_shared<contiguous_block>(0, 64)), peak_(0) {}
+
+  /**
+   * the arena of the calling thread
+   **/
+  static scratch_arena &local() {
+    static thread_local scratch_arena arena;
+    return arena;
+  }
+
+  bool active() const { return !marks_.empty(); }
+
+  const std::shared_ptr<contiguous_block> &block() const { return block_; }
+
+  std::size_t capacity() const { return block_->capacity(); }
+
+  void enter() { marks_.push_back(block_->used()); }
+
+  void leave() {
+    peak_ = std::max(peak_, block_->used());
+    block_->reset(marks_.back());
+    marks_.pop_back();
+    if (active() || peak_ <= block_->capacity()) return;
+
+    // round up to whole pages, the steps often differ by a few bytes
+    const std::size_t page = 4096;
+    block_ = std::make_shared<contiguous_block>(
+      (peak_ + page - 1) / page * page, 64);
+    peak_ = 0;
+  }
+
+ private:
+  std::shared_ptr<contiguous_block> block_;
+  std::vector<std::size_t> marks_;  // offset of the block at each open scope
+  std::size_t peak_;                // largest offset since the last growth
+};
+
+/**
+ * draw the temporaries allocated with scratch_allocator() on this thread
+ * from its scratch_arena until the end of the scope. scopes may be nested,
+ * each one gives back what was allocated within it.
+ **/
+class scratch_scope {
+ public:
+  scratch_scope() { scratch_arena::local().enter(); }
+  ~scratch_scope() { scratch_arena::local().leave(); }
+
+  scratch_scope(const scratch_scope &) = delete;
+  scratch_scope &operator=(const scratch_scope &) = delete;
+};
+
+/**
+ * allocator taking its memory from the scratch_arena of the calling thread
+ * while a scratch_scope is open on it, from the heap otherwise
+ *
+ *     vec_t tmp(n, float_t(0), scratch_allocator<float_t>());
+ **/
+template <typename T>
+aligned_allocator<T, 64> scratch_allocator() {
+  scratch_arena &arena = scratch_arena::local();
+  return arena.active() ? aligned_allocator<T, 64>(arena.block())
+                        : aligned_allocator<T, 64>();
+}
+
+}  // namespace tiny_dnn
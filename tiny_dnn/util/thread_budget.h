@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+namespace tiny_dnn {
+
+/**
+ * runtime limit on the number of threads a parallel_for/for_i may use.
+ *
+ * The effective budget of a thread is the smallest non-zero value among the
+ * process-wide limit (set_num_threads) and every thread_budget_scope alive
+ * on that thread. 0 means "no limit", i.e. every thread of the backend.
+ *
+ *     set_num_threads(8);             // whole process
+ *     {
+ *       thread_budget_scope scope(2); // this thread, until end of scope
+ *       net.predict(in);              // uses at most 2 threads
+ *     }
+ **/
+namespace detail {
+
+inline std::atomic<size_t> &global_thread_budget() {
+  static std::atomic<size_t> budget(0);
+  return budget;
+}
+
+inline size_t &local_thread_budget() {
+  static thread_local size_t budget = 0;
+  return budget;
+}
+
+inline size_t min_thread_budget(size_t a, size_t b) {
+  if (a == 0) return b;
+  if (b == 0) return a;
+  return std::min(a, b);
+}
+
+}  // namespace detail
+
+/**
+ * set the process-wide thread budget (0: no limit)
+ **/
+inline void set_num_threads(size_t num_threads) {
+  detail::global_thread_budget().store(num_threads);
+}
+
+/**
+ * effective thread budget of the calling thread (0: no limit)
+ **/
+inline size_t thread_budget() {
+  return detail::min_thread_budget(detail::global_thread_budget().load(),
+                                   detail::local_thread_budget());
+}
+
+/**
+ * caps the thread budget of the calling thread until destruction. scopes
+ * nest, and an inner scope can only lower the budget of an outer one.
+ **/
+class thread_budget_scope {
+ public:
+  explicit thread_budget_scope(size_t num_threads)
+    : prev_(detail::local_thread_budget()) {
+    detail::local_thread_budget() =
+      detail::min_thread_budget(prev_, num_threads);
+  }
+
+  ~thread_budget_scope() { detail::local_thread_budget() = prev_; }
+
+  thread_budget_scope(const thread_budget_scope &) = delete;
+  thread_budget_scope &operator=(const thread_budget_scope &) = delete;
+
+ private:
+  size_t prev_;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,279 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "tiny_dnn/util/cpu_topology.h"
+
+namespace tiny_dnn {
+
+/**
+ * persistent pool of worker threads backing the default parallel_for.
+ *
+ * Workers are created once and parked between jobs, so a fork/join costs
+ * one wake-up and one barrier instead of spawning and joining a thread per
+ * block. The calling thread always takes part in the job, hence a pool of
+ * N threads owns N-1 workers.
+ *
+ *     thread_pool::instance().resize(4);  // caller + 3 workers
+ *     thread_pool::instance().run(100, [&](size_t task) { ... });
+ *
+ * Only one job runs at a time. A run() issued while another job is in
+ * flight (from a task of that job, or from an unrelated thread) executes
+ * its tasks serially on the calling thread instead of waiting for the pool.
+ *
+ * With set_affinity(true) the workers are pinned to cpus, filling one NUMA
+ * node before the next, and task i of a job always runs on thread
+ * i % num_threads() (the caller being thread 0). Contiguous ranges split by
+ * parallel_for then stay on the same node from one job to the next, which
+ * lets buffers allocated inside a for_i be placed there by first touch.
+ * The calling thread belongs to the application and is not pinned: the
+ * first cpu of the first node is left free for it, and
+ *
+ *     cpu_topology::pin_current_thread(
+ *       cpu_topology::instance().cpus_by_node()[0]);
+ *
+ * puts its share of the tasks on that node too. Memory is not bound to
+ * nodes (that would need libnuma): the placement relies on first touch
+ * only, and buffers touched before set_affinity stay where they are.
+ **/
+class thread_pool {
+ public:
+  explicit thread_pool(size_t num_threads = default_num_threads())
+    : job_fn_(nullptr),
+      job_invoke_(nullptr),
+      job_size_(0),
+      generation_(0),
+      next_task_(0),
+      checked_in_(0),
+      stop_(false),
+      affinity_(false) {
+    start(num_threads);
+  }
+
+  ~thread_pool() { shutdown(); }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  /**
+   * process-wide pool used by parallel_for/for_i
+   **/
+  static thread_pool &instance() {
+    static thread_pool pool;
+    return pool;
+  }
+
+  static size_t default_num_threads() {
+    size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+  }
+
+  /**
+   * number of threads taking part in a job (workers + calling thread)
+   **/
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  /**
+   * change the number of threads. must not be called while a job is running.
+   **/
+  void resize(size_t num_threads) {
+    std::lock_guard<std::mutex> guard(run_mutex_);
+    if (num_threads == 0) num_threads = 1;
+    if (num_threads == this->num_threads()) return;
+    shutdown();
+    start(num_threads);
+  }
+
+  /**
+   * pin workers to cpus and map tasks to threads statically (see above).
+   * must not be called while a job is running.
+   **/
+  void set_affinity(bool enabled) {
+    std::lock_guard<std::mutex> guard(run_mutex_);
+    if (enabled == affinity_) return;
+    size_t n = num_threads();
+    shutdown();
+    affinity_ = enabled;
+    start(n);
+  }
+
+  bool affinity() const { return affinity_; }
+
+  /**
+   * true if the current thread is executing a task of some pool job
+   **/
+  static bool in_parallel_region() { return inside_job(); }
+
+  /**
+   * execute f(task) for every task in [0, ntasks) and return once all of
+   * them have finished. the first exception thrown by a task is rethrown
+   * on the calling thread.
+   **/
+  template <typename Func>
+  void run(size_t ntasks, const Func &f) {
+    if (ntasks == 0) return;
+
+    std::unique_lock<std::mutex> guard(run_mutex_, std::defer_lock);
+    if (ntasks == 1 || workers_.empty() || inside_job() ||
+        !guard.try_lock()) {
+      for (size_t i = 0; i < ntasks; i++) f(i);
+      return;
+    }
+
+    job_fn_     = static_cast<const void *>(&f);
+    job_invoke_ = [](const void *fn, size_t task) {
+      (*static_cast<const Func *>(fn))(task);
+    };
+    job_size_ = ntasks;
+    error_    = nullptr;
+    next_task_.store(0, std::memory_order_relaxed);
+    checked_in_.store(0, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      generation_.fetch_add(1, std::memory_order_release);
+    }
+    wake_.notify_all();
+
+    execute(0);
+    wait_for_workers();
+
+    job_fn_     = nullptr;
+    job_invoke_ = nullptr;
+    if (error_) std::rethrow_exception(error_);
+  }
+
+ private:
+  typedef void (*invoke_t)(const void *, size_t);
+
+  // number of polls before a thread parks on its condition variable
+  static const int spin_count = 4096;
+
+  static bool &inside_job() {
+    static thread_local bool inside = false;
+    return inside;
+  }
+
+  void start(size_t num_threads) {
+    stop_ = false;
+    // workers must not skip a job posted before they got scheduled
+    size_t seen = generation_.load(std::memory_order_acquire);
+    for (size_t i = 1; i < num_threads; i++) {
+      workers_.emplace_back([this, seen, i] { worker_loop(seen, i); });
+    }
+  }
+
+  void shutdown() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w : workers_) w.join();
+    workers_.clear();
+  }
+
+  // id: 0 for the calling thread, 1..n-1 for the workers
+  void execute(size_t id) {
+    bool was_inside = inside_job();
+    inside_job()    = true;
+    if (affinity_) {
+      for (size_t task = id; task < job_size_; task += num_threads()) {
+        invoke(task);
+      }
+    } else {
+      for (;;) {
+        size_t task = next_task_.fetch_add(1, std::memory_order_relaxed);
+        if (task >= job_size_) break;
+        invoke(task);
+      }
+    }
+    inside_job() = was_inside;
+  }
+
+  void invoke(size_t task) {
+    try {
+      job_invoke_(job_fn_, task);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+  }
+
+  void worker_loop(size_t seen, size_t id) {
+    if (affinity_) {
+      // cpu 0 of the first node is left to the calling thread, which is
+      // not pinned here (see above)
+      std::vector<int> cpus = cpu_topology::instance().cpus_by_node();
+      cpu_topology::pin_current_thread(cpus[id % cpus.size()]);
+    }
+    for (;;) {
+      if (!wait_for_job(seen)) return;
+      seen = generation_.load(std::memory_order_acquire);
+      execute(id);
+      if (checked_in_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          workers_.size()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_.notify_one();
+      }
+    }
+  }
+
+  // returns false when the pool is shutting down
+  bool wait_for_job(size_t seen) {
+    for (int i = 0; i < spin_count; i++) {
+      if (generation_.load(std::memory_order_acquire) != seen) return true;
+      if (stop_) return false;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [&] {
+      return stop_ || generation_.load(std::memory_order_acquire) != seen;
+    });
+    return !stop_;
+  }
+
+  void wait_for_workers() {
+    const size_t nworkers = workers_.size();
+    for (int i = 0; i < spin_count; i++) {
+      if (checked_in_.load(std::memory_order_acquire) == nworkers) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [&] {
+      return checked_in_.load(std::memory_order_acquire) == nworkers;
+    });
+  }
+
+  std::vector<std::thread> workers_;
+
+  // current job, published to the workers by bumping generation_
+  const void *job_fn_;
+  invoke_t job_invoke_;
+  size_t job_size_;
+  std::exception_ptr error_;
+
+  std::atomic<size_t> generation_;
+  std::atomic<size_t> next_task_;
+  std::atomic<size_t> checked_in_;
+  std::atomic<bool> stop_;
+  bool affinity_;
+
+  std::mutex run_mutex_;  // serializes jobs
+  std::mutex mutex_;      // guards parking and error_
+  std::condition_variable wake_;
+  std::condition_variable finished_;
+};
+
+}  // namespace tiny_dnn
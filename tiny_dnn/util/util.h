@@ -43,6 +43,7 @@
 #include "tiny_dnn/util/parallel_for.h"
 #include "tiny_dnn/util/product.h"
 #include "tiny_dnn/util/random.h"
+#include "tiny_dnn/util/scratch_arena.h"
 
 #if defined(USE_OPENCL) || defined(USE_CUDA)
 #ifdef USE_OPENCL
@@ -0,0 +1,421 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace tiny_dnn {
+
+/**
+ * work-stealing task scheduler backing parallel_for when CNN_USE_WORK_STEALING
+ * is defined.
+ *
+ * A range is split recursively in halves until a piece is no larger than the
+ * grainsize. The splitting thread keeps the lower half and pushes the upper
+ * half onto the bottom of its own deque; idle threads steal from the top of
+ * other deques, so the biggest pending pieces migrate first and uneven
+ * per-iteration cost is balanced at grain granularity.
+ *
+ * A thread waiting for its range to complete keeps executing queued tasks
+ * instead of blocking, so nested parallel_for calls run on the same set of
+ * threads without oversubscribing the machine.
+ *
+ *     work_stealing_scheduler sched(4);  // caller + 3 workers
+ *     sched.parallel_for(0, 1000, 16, [&](size_t begin, size_t end) { ... });
+ *
+ * Threads that are not workers of the scheduler borrow one of a few external
+ * slots for the duration of a call; when all of them are taken the range is
+ * executed serially on the calling thread.
+ *
+ * A top-level call may limit the number of threads working on it. Nested
+ * calls share that limit: a thread only picks up tasks of a group it does
+ * not belong to yet if the group still has room.
+ **/
+class work_stealing_scheduler {
+ public:
+  explicit work_stealing_scheduler(size_t num_threads = default_num_threads())
+    : num_workers_(num_threads == 0 ? 0 : num_threads - 1),
+      pending_(0),
+      pushes_(0),
+      sleepers_(0),
+      stop_(false) {
+    for (size_t i = 0; i < num_workers_ + max_external_threads; i++) {
+      queues_.emplace_back(new task_queue());
+    }
+    external_used_.reset(new std::atomic<bool>[max_external_threads]);
+    for (size_t i = 0; i < max_external_threads; i++) {
+      external_used_[i] = false;
+    }
+    for (size_t i = 0; i < num_workers_; i++) {
+      workers_.emplace_back([this, i] { worker_loop(i); });
+    }
+  }
+
+  ~work_stealing_scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w : workers_) w.join();
+  }
+
+  work_stealing_scheduler(const work_stealing_scheduler &) = delete;
+  work_stealing_scheduler &operator=(const work_stealing_scheduler &) = delete;
+
+  /**
+   * process-wide scheduler used by parallel_for/for_i
+   **/
+  static work_stealing_scheduler &instance() {
+    static work_stealing_scheduler scheduler;
+    return scheduler;
+  }
+
+  static size_t default_num_threads() {
+    size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+  }
+
+  /**
+   * number of threads executing tasks (workers + calling thread)
+   **/
+  size_t num_threads() const { return num_workers_ + 1; }
+
+  /**
+   * number of threads a parallel_for issued from the calling thread may use
+   **/
+  size_t num_threads_available() const {
+    const thread_group *g = current_group();
+    return g ? std::min(g->limit, num_threads()) : num_threads();
+  }
+
+  /**
+   * call f(b, e) on disjoint sub-ranges covering [begin, end), none of them
+   * larger than grainsize, and return once all of them have finished. the
+   * first exception thrown by f is rethrown on the calling thread.
+   *
+   * @param max_threads upper bound of threads working on the range (0: all).
+   *                    ignored when called from inside another parallel_for,
+   *                    which already decided the limit.
+   **/
+  template <typename Func>
+  void parallel_for(size_t begin,
+                    size_t end,
+                    size_t grainsize,
+                    const Func &f,
+                    size_t max_threads = 0) {
+    if (begin >= end) return;
+    if (grainsize == 0) grainsize = 1;
+
+    thread_group *group = current_group();
+    if (!group && max_threads == 1) {
+      run_serial(begin, end, grainsize, f);
+      return;
+    }
+    if (end - begin <= grainsize || num_workers_ == 0) {
+      run_serial(begin, end, grainsize, f);
+      return;
+    }
+
+    slot_guard slot(this);
+    if (!slot.acquired()) {
+      run_serial(begin, end, grainsize, f);
+      return;
+    }
+
+    thread_group root(max_threads == 0 ? num_threads() : max_threads);
+    group_guard member(group ? group : &root);
+
+    job j(static_cast<const void *>(&f),
+          [](const void *fn, size_t b, size_t e) {
+            (*static_cast<const Func *>(fn))(b, e);
+          },
+          grainsize, end - begin, current_group());
+
+    execute(slot.index(), task{&j, begin, end});
+
+    // help with whatever is queued until every piece of our range is done
+    for (int idle = 0; j.remaining.load(std::memory_order_acquire) != 0;) {
+      task t;
+      bool entered = false;
+      if (pop(slot.index(), &t, &entered) ||
+          steal(slot.index(), &t, &entered)) {
+        run_task(slot.index(), t, entered);
+        idle = 0;
+      } else if (++idle > spin_count) {
+        std::this_thread::yield();
+      }
+    }
+
+    if (j.error) std::rethrow_exception(j.error);
+  }
+
+ private:
+  typedef void (*invoke_t)(const void *, size_t, size_t);
+
+  // external (non-worker) threads that may take part in a job concurrently
+  static const size_t max_external_threads = 8;
+
+  // number of failed polls before a thread yields / parks
+  static const int spin_count = 64;
+
+  // threads working on a top-level parallel_for and the calls nested in it;
+  // lives on the stack of the top-level caller, which is always a member
+  struct thread_group {
+    explicit thread_group(size_t limit) : limit(limit), size(1) {}
+
+    bool try_enter() {
+      size_t n = size.load();
+      while (n < limit) {
+        if (size.compare_exchange_weak(n, n + 1)) return true;
+      }
+      return false;
+    }
+
+    void leave() { size.fetch_sub(1); }
+
+    const size_t limit;
+    std::atomic<size_t> size;
+  };
+
+  // one parallel_for call; lives on the stack of the calling thread
+  struct job {
+    job(const void *fn,
+        invoke_t invoke,
+        size_t grainsize,
+        size_t size,
+        thread_group *group)
+      : fn(fn),
+        invoke(invoke),
+        grainsize(grainsize),
+        group(group),
+        remaining(size) {}
+
+    const void *fn;
+    invoke_t invoke;
+    size_t grainsize;
+    thread_group *group;
+    std::atomic<size_t> remaining;  // iterations not executed yet
+    std::mutex error_mutex;
+    std::exception_ptr error;
+  };
+
+  struct task {
+    job *owner;
+    size_t begin;
+    size_t end;
+  };
+
+  struct task_queue {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  // index of the queue owned by the current thread, per scheduler
+  struct thread_slot {
+    const work_stealing_scheduler *owner;
+    size_t index;
+  };
+
+  static thread_slot &current_slot() {
+    static thread_local thread_slot slot = {nullptr, 0};
+    return slot;
+  }
+
+  // group of the task the calling thread is executing, if any
+  static thread_group *&current_group() {
+    static thread_local thread_group *group = nullptr;
+    return group;
+  }
+
+  class group_guard {
+   public:
+    explicit group_guard(thread_group *g) : prev_(current_group()) {
+      current_group() = g;
+    }
+    ~group_guard() { current_group() = prev_; }
+
+   private:
+    thread_group *prev_;
+  };
+
+  // binds the calling thread to a queue for the duration of a parallel_for
+  class slot_guard {
+   public:
+    explicit slot_guard(work_stealing_scheduler *s)
+      : s_(s), prev_(current_slot()), external_(-1) {
+      if (prev_.owner == s_) {
+        index_ = prev_.index;  // worker, or nested call of an external thread
+        return;
+      }
+      for (size_t i = 0; i < max_external_threads; i++) {
+        bool expected = false;
+        if (s_->external_used_[i].compare_exchange_strong(expected, true)) {
+          external_     = static_cast<int>(i);
+          index_        = s_->num_workers_ + i;
+          current_slot() = thread_slot{s_, index_};
+          return;
+        }
+      }
+    }
+
+    ~slot_guard() {
+      if (external_ >= 0) {
+        current_slot() = prev_;
+        s_->external_used_[external_].store(false, std::memory_order_release);
+      }
+    }
+
+    bool acquired() const { return prev_.owner == s_ || external_ >= 0; }
+    size_t index() const { return index_; }
+
+   private:
+    work_stealing_scheduler *s_;
+    thread_slot prev_;
+    int external_;
+    size_t index_ = 0;
+  };
+
+  template <typename Func>
+  static void run_serial(size_t begin,
+                         size_t end,
+                         size_t grainsize,
+                         const Func &f) {
+    for (size_t b = begin; b < end; b += grainsize) {
+      f(b, std::min(b + grainsize, end));
+    }
+  }
+
+  // run a task taken from a queue; entered is true if the calling thread
+  // joined the task's group to do so
+  void run_task(size_t slot, const task &t, bool entered) {
+    {
+      group_guard member(t.owner->group);
+      execute(slot, t);
+    }
+    if (entered) t.owner->group->leave();
+  }
+
+  // whether the calling thread may run t, joining its group if needed
+  static bool admit(const task &t, bool *entered) {
+    thread_group *g = t.owner->group;
+    if (current_group() == g) return true;
+    return *entered = g->try_enter();
+  }
+
+  // split t down to grainsize, queueing the upper halves, then run the rest
+  void execute(size_t slot, task t) {
+    job *j = t.owner;
+    while (t.end - t.begin > j->grainsize) {
+      size_t mid = t.begin + (t.end - t.begin) / 2;
+      push(slot, task{j, mid, t.end});
+      t.end = mid;
+    }
+    try {
+      j->invoke(j->fn, t.begin, t.end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(j->error_mutex);
+      if (!j->error) j->error = std::current_exception();
+    }
+    // j may be destroyed by its owner as soon as remaining reaches zero
+    j->remaining.fetch_sub(t.end - t.begin, std::memory_order_acq_rel);
+  }
+
+  void push(size_t slot, const task &t) {
+    {
+      std::lock_guard<std::mutex> lock(queues_[slot]->mutex);
+      queues_[slot]->tasks.push_back(t);
+      pending_.fetch_add(1);
+      pushes_.fetch_add(1);
+    }
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_.notify_one();
+    }
+  }
+
+  // newest task of our own queue (depth first, cache friendly)
+  bool pop(size_t slot, task *t, bool *entered) {
+    task_queue &q = *queues_[slot];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty() || !admit(q.tasks.back(), entered)) return false;
+    *t = q.tasks.back();
+    q.tasks.pop_back();
+    pending_.fetch_sub(1);
+    return true;
+  }
+
+  // oldest (largest) task of some other queue
+  bool steal(size_t slot, task *t, bool *entered) {
+    if (pending_.load(std::memory_order_relaxed) == 0) return false;
+    const size_t n = queues_.size();
+    for (size_t k = 1; k < n; k++) {
+      task_queue &q = *queues_[(slot + k) % n];
+      std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+      if (!lock.owns_lock() || q.tasks.empty()) continue;
+      if (!admit(q.tasks.front(), entered)) continue;
+      *t = q.tasks.front();
+      q.tasks.pop_front();
+      pending_.fetch_sub(1);
+      return true;
+    }
+    return false;
+  }
+
+  void worker_loop(size_t slot) {
+    current_slot() = thread_slot{this, slot};
+    int idle       = 0;
+    for (;;) {
+      // pending tasks may belong to groups that are full, so parking waits
+      // for a new push rather than for the queues to become non-empty
+      size_t seen  = pushes_.load();
+      task t;
+      bool entered = false;
+      if (pop(slot, &t, &entered) || steal(slot, &t, &entered)) {
+        run_task(slot, t, entered);
+        idle = 0;
+        continue;
+      }
+      if (++idle < spin_count) {
+        std::this_thread::yield();
+        continue;
+      }
+      // sleepers_ is raised before pushes_ is re-checked, so a concurrent
+      // push either is seen here or notifies.
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleepers_.fetch_add(1);
+      wake_.wait(lock, [&] { return stop_ || pushes_.load() != seen; });
+      sleepers_.fetch_sub(1);
+      if (stop_) return;
+      idle = 0;
+    }
+  }
+
+  size_t num_workers_;
+  std::vector<std::unique_ptr<task_queue>> queues_;  // workers, then external
+  std::unique_ptr<std::atomic<bool>[]> external_used_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<size_t> pending_;  // tasks sitting in any queue
+  std::atomic<size_t> pushes_;   // total number of pushes, for parking
+  std::atomic<size_t> sleepers_;
+  bool stop_;
+
+  std::mutex mutex_;  // guards parking
+  std::condition_variable wake_;
+};
+
+}  // namespace tiny_dnn